@@ -22,11 +22,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <errno.h>
+#include <fnmatch.h>
 #include "access.h"
 #include "sensors.h"
 #include "data.h"
 #include "error.h"
 #include "sysfs.h"
+#include "read.h"
+#include "stats.h"
+#include "valstats.h"
+#include "virtual.h"
+#include "probes.h"
 
 /* We watch the recursion depth for variables only, as an easy way to
    detect cycles. */
@@ -35,14 +42,20 @@
 static int sensors_eval_expr(const sensors_chip_features *chip_features,
 			     const sensors_expr *expr,
 			     double val, int depth, double *result);
+static int __sensors_eval_expr(const sensors_chip_features *chip_features,
+			       const sensors_expr *expr,
+			       double val, int depth, double *result);
 
 /* Compare two chips name descriptions, to see whether they could match.
-   Return 0 if it does not match, return 1 if it does match. */
+   Return 0 if it does not match, return 1 if it does match.
+   Prefixes of detected chips and of configuration file chip names are
+   interned, so they can usually be compared by pointer. */
 static int sensors_match_chip(const sensors_chip_name *chip1,
 		       const sensors_chip_name *chip2)
 {
 	if ((chip1->prefix != SENSORS_CHIP_NAME_PREFIX_ANY) &&
 	    (chip2->prefix != SENSORS_CHIP_NAME_PREFIX_ANY) &&
+	    chip1->prefix != chip2->prefix &&
 	    strcmp(chip1->prefix, chip2->prefix))
 		return 0;
 
@@ -65,42 +78,85 @@ static int sensors_match_chip(const sensors_chip_name *chip1,
 }
 
 /* Returns, one by one, a pointer to all sensor_chip structs of the
-   config file which match with the given chip name. Last should be
-   the value returned by the last call, or NULL if this is the first
-   call. Returns NULL if no more matches are found. Do not modify
-   the struct the return value points to! 
+   config file which match with the given chip. Nr is the position in
+   the list, it should be 0 for the first call. Returns NULL if no more
+   matches are found. Do not modify the struct the return value points
+   to!
    Note that this visits the list of chips from last to first. Usually,
-   you want the match that was latest in the config file. */
+   you want the match that was latest in the config file. The matches
+   were resolved once by sensors_resolve_config(). */
 static sensors_chip *
-sensors_for_all_config_chips(const sensors_chip_name *name,
-			     const sensors_chip *last)
+sensors_for_all_config_chips(const sensors_chip_features *chip_features,
+			     int *nr)
 {
-	int nr, i;
-	sensors_chip_name_list chips;
+	if (!*nr)
+		sensors_stats_add(config_lookups, 1);
+	if (*nr >= chip_features->config_chips_count)
+		return NULL;
+	return sensors_config_chips + chip_features->config_chips[(*nr)++];
+}
 
-	for (nr = last ? last - sensors_config_chips - 1 :
-			 sensors_config_chips_count - 1; nr >= 0; nr--) {
+/* Find the configuration chip blocks which apply to a detected chip,
+   from last to first, and store their indexes in the chip */
+static int sensors_config_chip_matches(const sensors_chip *chip,
+				       const sensors_chip_name *name)
+{
+	int i;
 
-		chips = sensors_config_chips[nr].chips;
-		for (i = 0; i < chips.fits_count; i++) {
-			if (sensors_match_chip(&chips.fits[i], name))
-				return sensors_config_chips + nr;
-		}
+	for (i = 0; i < chip->chips.fits_count; i++)
+		if (sensors_match_chip(&chip->chips.fits[i], name))
+			return 1;
+	return 0;
+}
+
+static void sensors_resolve_features(sensors_chip_features *chip_features,
+				     sensors_arena *arena);
+static void sensors_resolve_alarms(sensors_chip_features *chip_features,
+				   sensors_arena *arena);
+
+void sensors_resolve_config(sensors_chip_features *chip_features)
+{
+	sensors_arena *arena;
+	int nr, count;
+
+	arena = sensors_chip_arena(chip_features);
+
+	count = 0;
+	for (nr = 0; nr < sensors_config_chips_count; nr++)
+		if (sensors_config_chip_matches(&sensors_config_chips[nr],
+						&chip_features->chip))
+			count++;
+
+	chip_features->config_chips_count = count;
+	if (!count) {
+		chip_features->config_chips = NULL;
+	} else {
+		chip_features->config_chips = sensors_arena_alloc(arena,
+							count * sizeof(int));
+		/* Latest first */
+		for (nr = 0; nr < sensors_config_chips_count; nr++)
+			if (sensors_config_chip_matches(
+					&sensors_config_chips[nr],
+					&chip_features->chip))
+				chip_features->config_chips[--count] = nr;
 	}
-	return NULL;
+
+	/* Depend on the ignore statements */
+	sensors_resolve_features(chip_features, arena);
+	sensors_resolve_alarms(chip_features, arena);
 }
 
 /* Look up a chip in the intern chip list, and return a pointer to it.
    Do not modify the struct the return value points to! Returns NULL if
    not found.*/
-static const sensors_chip_features *
+const sensors_chip_features *
 sensors_lookup_chip(const sensors_chip_name *name)
 {
 	int i;
 
 	for (i = 0; i < sensors_proc_chips_count; i++)
-		if (sensors_match_chip(&sensors_proc_chips[i].chip, name))
-			return &sensors_proc_chips[i];
+		if (sensors_match_chip(&sensors_proc_chips[i]->chip, name))
+			return sensors_proc_chips[i];
 
 	return NULL;
 }
@@ -130,7 +186,8 @@ sensors_lookup_feature_nr(const sensors_chip_features *chip, int feat_nr)
 	return chip->feature + feat_nr;
 }
 
-/* Look up a subfeature by name, and return a pointer to it.
+/* Look up a subfeature by name, and return a pointer to it. The name
+   must be interned.
    Do not modify the struct the return value points to! Returns NULL if 
    not found.*/
 static const sensors_subfeature *
@@ -140,7 +197,7 @@ sensors_lookup_subfeature_name(const sensors_chip_features *chip,
 	int j;
 
 	for (j = 0; j < chip->subfeature_count; j++)
-		if (!strcmp(chip->subfeature[j].name, name))
+		if (chip->subfeature[j].name == name)
 			return chip->subfeature + j;
 	return NULL;
 }
@@ -159,6 +216,98 @@ int sensors_chip_name_has_wildcards(const sensors_chip_name *chip)
 		return 0;
 }
 
+int sensors_config_chip_detected(const sensors_chip_name_list *chips)
+{
+	sensors_chip_name name, virt;
+	int i, j;
+
+	/* The virtual chip is only added once parsing is done, and the
+	   virtual statements may come last */
+	virt.prefix = sensors_intern_name("virtual");
+	virt.bus.type = SENSORS_BUS_TYPE_VIRTUAL;
+	virt.bus.nr = 0;
+	virt.addr = 0;
+
+	for (i = 0; i < chips->fits_count; i++) {
+		/* Bus numbers are only substituted after parsing, so they
+		   can't be compared yet */
+		name = chips->fits[i];
+		name.bus.nr = SENSORS_BUS_NR_ANY;
+		if (sensors_match_chip(&virt, &name))
+			return 1;
+
+		for (j = 0; j < sensors_proc_chips_count; j++)
+			if (sensors_match_chip(&sensors_proc_chips[j]->chip,
+					       &name))
+				return 1;
+	}
+	return 0;
+}
+
+void sensors_dump_config(FILE *out, const sensors_chip_name *match)
+{
+	const sensors_chip_features *chip_features;
+	const sensors_chip *chip;
+	const sensors_virtual *virt;
+	const sensors_group *group;
+	char name[NAME_MAX];
+	int i, nr;
+
+	sensors_read_begin();
+	for (i = 0; i < sensors_proc_chips_count; i++) {
+		chip_features = sensors_proc_chips[i];
+		if (match && !sensors_match_chip(&chip_features->chip, match))
+			continue;
+		if (sensors_snprintf_chip_name(name, sizeof(name),
+					       &chip_features->chip) < 0)
+			continue;
+
+		fprintf(out, "%s\n", name);
+		for (nr = 0; chip_features->virt &&
+			     nr < sensors_config_virtuals_count; nr++) {
+			virt = &sensors_config_virtuals[nr];
+			if (virt->line.filename)
+				fprintf(out, "  %s, line %d: ",
+					virt->line.filename, virt->line.lineno);
+			else
+				fprintf(out, "  Line %d: ", virt->line.lineno);
+			fprintf(out, "virtual %s\n", virt->name);
+		}
+		if (!chip_features->config_chips_count)
+			fprintf(out, "  No configuration\n");
+		for (nr = 0; (chip = sensors_for_all_config_chips(chip_features,
+								  &nr));) {
+			if (chip->line.filename)
+				fprintf(out, "  %s, line %d: ",
+					chip->line.filename, chip->line.lineno);
+			else
+				fprintf(out, "  Line %d: ", chip->line.lineno);
+			fprintf(out, "labels: %d, sets: %d, computes: %d, "
+				"ignores: %d", chip->labels_count,
+				chip->sets_count, chip->computes_count,
+				chip->ignores_count);
+			if (chip->suspended >= 0)
+				fprintf(out, ", suspended: %s",
+					chip->suspended == SENSORS_SUSPENDED_SKIP ?
+					"skip" : "wake");
+			fprintf(out, "\n");
+		}
+	}
+
+	for (i = 0; !match && i < sensors_config_groups_count; i++) {
+		group = &sensors_config_groups[i];
+		if (group->line.filename)
+			fprintf(out, "%s, line %d: ", group->line.filename,
+				group->line.lineno);
+		else
+			fprintf(out, "Line %d: ", group->line.lineno);
+		fprintf(out, "group %s\n", group->name);
+		for (nr = 0; nr < group->specs_count; nr++)
+			fprintf(out, "  %s\n", group->specs[nr]);
+	}
+	sensors_read_end();
+}
+
 /* Look up the label for a given feature. Note that chip should not
    contain wildcard values! The returned string is newly allocated (free it
    yourself). On failure, NULL is returned.
@@ -167,22 +316,32 @@ char *sensors_get_label(const sensors_chip_name *name,
 			const sensors_feature *feature)
 {
 	char *label;
+	const sensors_chip_features *chip_features;
 	const sensors_chip *chip;
 	char buf[PATH_MAX];
 	FILE *f;
-	int i;
+	int i, nr;
 
 	if (sensors_chip_name_has_wildcards(name))
 		return NULL;
 
-	for (chip = NULL; (chip = sensors_for_all_config_chips(name, chip));)
+	sensors_read_begin();
+	chip_features = sensors_lookup_chip(name);
+	nr = 0;
+	while (chip_features &&
+	       (chip = sensors_for_all_config_chips(chip_features, &nr)))
 		for (i = 0; i < chip->labels_count; i++)
-			if (!strcmp(feature->name, chip->labels[i].name)) {
+			if (feature->name == chip->labels[i].name) {
 				label = chip->labels[i].value;
 				goto sensors_get_label_exit;
 			}
 
-	/* No user specified label, check for a _label sysfs file */
+	/* No user specified label, check for a _label sysfs file, unless we
+	   know there is none */
+	if (chip_features &&
+	    (chip_features->virt ||
+	     sensors_read_label_absent(chip_features, feature)))
+		goto sensors_get_label_name;
 	snprintf(buf, PATH_MAX, "%s/%s_label", name->path, feature->name);
 	
 	if ((f = fopen(buf, "r"))) {
@@ -194,8 +353,10 @@ char *sensors_get_label(const sensors_chip_name *name,
 			label = buf;
 			goto sensors_get_label_exit;
 		}
-	}
+	} else if (errno == ENOENT && chip_features)
+		sensors_read_set_label_absent(chip_features, feature);
 
+sensors_get_label_name:
 	/* No label, return the feature name instead */
 	label = feature->name;
 	
@@ -203,45 +364,178 @@ sensors_get_label_exit:
 	label = strdup(label);
 	if (!label)
 		sensors_fatal_error(__func__, "Allocating label text");
+	sensors_read_end();
 	return label;
 }
 
 /* Looks up whether a feature should be ignored. Returns
    1 if it should be ignored, 0 if not. */
-static int sensors_get_ignored(const sensors_chip_name *name,
+static int sensors_get_ignored(const sensors_chip_features *chip_features,
 			       const sensors_feature *feature)
 {
 	const sensors_chip *chip;
-	int i;
+	int i, nr;
 
-	for (chip = NULL; (chip = sensors_for_all_config_chips(name, chip));)
+	for (nr = 0; (chip = sensors_for_all_config_chips(chip_features, &nr));)
 		for (i = 0; i < chip->ignores_count; i++)
-			if (!strcmp(feature->name, chip->ignores[i].name))
+			if (feature->name == chip->ignores[i].name)
 				return 1;
 	return 0;
 }
 
-/* Read the value of a subfeature of a certain chip. Note that chip should not
-   contain wildcard values! This function will return 0 on success, and <0
-   on failure. */
-static int __sensors_get_value(const sensors_chip_name *name, int subfeat_nr,
-			       int depth, double *result)
+/* List the features of a chip which aren't ignored once, for
+   sensors_get_feature_array() */
+static void sensors_resolve_features(sensors_chip_features *chip_features,
+				     sensors_arena *arena)
+{
+	int i, count = 0;
+
+	for (i = 0; i < chip_features->feature_count; i++)
+		if (!sensors_get_ignored(chip_features,
+					 chip_features->feature + i))
+			count++;
+
+	chip_features->visible_features_count = count;
+	if (!count) {
+		chip_features->visible_features = NULL;
+		return;
+	}
+
+	chip_features->visible_features = sensors_arena_alloc(arena,
+					count * sizeof(sensors_feature *));
+	for (i = 0, count = 0; i < chip_features->feature_count; i++)
+		if (!sensors_get_ignored(chip_features,
+					 chip_features->feature + i))
+			chip_features->visible_features[count++] =
+				chip_features->feature + i;
+}
+
+/* The subfeatures reported by sensors_get_alarm_summary() */
+static int sensors_is_alarm(int type)
+{
+	switch (type) {
+	case SENSORS_SUBFEATURE_IN_ALARM:
+	case SENSORS_SUBFEATURE_IN_MIN_ALARM:
+	case SENSORS_SUBFEATURE_IN_MAX_ALARM:
+	case SENSORS_SUBFEATURE_IN_LCRIT_ALARM:
+	case SENSORS_SUBFEATURE_IN_CRIT_ALARM:
+	case SENSORS_SUBFEATURE_FAN_ALARM:
+	case SENSORS_SUBFEATURE_FAN_FAULT:
+	case SENSORS_SUBFEATURE_FAN_MIN_ALARM:
+	case SENSORS_SUBFEATURE_FAN_MAX_ALARM:
+	case SENSORS_SUBFEATURE_TEMP_ALARM:
+	case SENSORS_SUBFEATURE_TEMP_MAX_ALARM:
+	case SENSORS_SUBFEATURE_TEMP_MIN_ALARM:
+	case SENSORS_SUBFEATURE_TEMP_CRIT_ALARM:
+	case SENSORS_SUBFEATURE_TEMP_FAULT:
+	case SENSORS_SUBFEATURE_TEMP_EMERGENCY_ALARM:
+	case SENSORS_SUBFEATURE_TEMP_LCRIT_ALARM:
+	case SENSORS_SUBFEATURE_POWER_ALARM:
+	case SENSORS_SUBFEATURE_POWER_CAP_ALARM:
+	case SENSORS_SUBFEATURE_POWER_MAX_ALARM:
+	case SENSORS_SUBFEATURE_POWER_CRIT_ALARM:
+	case SENSORS_SUBFEATURE_CURR_ALARM:
+	case SENSORS_SUBFEATURE_CURR_MIN_ALARM:
+	case SENSORS_SUBFEATURE_CURR_MAX_ALARM:
+	case SENSORS_SUBFEATURE_CURR_LCRIT_ALARM:
+	case SENSORS_SUBFEATURE_CURR_CRIT_ALARM:
+	case SENSORS_SUBFEATURE_INTRUSION_ALARM:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static int sensors_is_chip_alarm(const sensors_chip_features *chip_features,
+				 const sensors_subfeature *subfeature)
+{
+	return sensors_is_alarm(subfeature->type) &&
+	       (subfeature->flags & SENSORS_MODE_R) &&
+	       !sensors_get_ignored(chip_features, chip_features->feature +
+				    subfeature->mapping);
+}
+
+/* List the alarm subfeatures of a chip once, so that checking for alarms
+   doesn't have to go through all the subfeatures */
+static void sensors_resolve_alarms(sensors_chip_features *chip_features,
+				   sensors_arena *arena)
+{
+	int i, count = 0;
+
+	for (i = 0; i < chip_features->subfeature_count; i++)
+		if (sensors_is_chip_alarm(chip_features,
+					  chip_features->subfeature + i))
+			count++;
+
+	chip_features->alarm_count = count;
+	if (!count) {
+		chip_features->alarms = NULL;
+		return;
+	}
+
+	chip_features->alarms = sensors_arena_alloc(arena, count * sizeof(int));
+	for (i = 0, count = 0; i < chip_features->subfeature_count; i++)
+		if (sensors_is_chip_alarm(chip_features,
+					  chip_features->subfeature + i))
+			chip_features->alarms[count++] = i;
+}
+
+static int __sensors_get_alarm_summary(const sensors_chip_name *match,
+				       sensors_alarm *alarms, int max)
 {
 	const sensors_chip_features *chip_features;
 	const sensors_subfeature *subfeature;
+	double value;
+	int i, j, count = 0;
+
+	for (i = 0; i < sensors_proc_chips_count; i++) {
+		chip_features = sensors_proc_chips[i];
+		if (match && !sensors_match_chip(&chip_features->chip, match))
+			continue;
+
+		for (j = 0; j < chip_features->alarm_count; j++) {
+			subfeature = chip_features->subfeature +
+				     chip_features->alarms[j];
+			/* Alarms which can't be read aren't reported */
+			if (sensors_read_subfeature(chip_features, subfeature,
+						    &value, NULL) ||
+			    value == 0)
+				continue;
+
+			/* The caller only wants to know if anything alarms */
+			if (!max)
+				return 1;
+
+			if (count < max) {
+				alarms[count].chip = &chip_features->chip;
+				alarms[count].subfeature = subfeature;
+			}
+			count++;
+		}
+	}
+	return count;
+}
+
+int sensors_get_alarm_summary(const sensors_chip_name *match,
+			      sensors_alarm *alarms, int max)
+{
+	int res;
+
+	sensors_read_begin();
+	res = __sensors_get_alarm_summary(match, alarms, max);
+	sensors_read_end();
+	return res;
+}
+
+int sensors_get_chip_value(const sensors_chip_features *chip_features,
+			   const sensors_subfeature *subfeature,
+			   int depth, double *result, uint64_t *when)
+{
 	const sensors_expr *expr = NULL;
 	double val;
-	int res, i;
+	uint64_t at;
+	int res, err, i, nr;
 
-	if (depth >= DEPTH_MAX)
-		return -SENSORS_ERR_RECURSION;
-	if (sensors_chip_name_has_wildcards(name))
-		return -SENSORS_ERR_WILDCARDS;
-	if (!(chip_features = sensors_lookup_chip(name)))
-		return -SENSORS_ERR_NO_ENTRY;
-	if (!(subfeature = sensors_lookup_subfeature_nr(chip_features,
-							subfeat_nr)))
-		return -SENSORS_ERR_NO_ENTRY;
 	if (!(subfeature->flags & SENSORS_MODE_R))
 		return -SENSORS_ERR_ACCESS_R;
 
@@ -253,46 +547,207 @@ static int __sensors_get_value(const sensors_chip_name *name, int subfeat_nr,
 		feature = sensors_lookup_feature_nr(chip_features,
 					subfeature->mapping);
 
-		chip = NULL;
+		nr = 0;
 		while (!expr &&
-		       (chip = sensors_for_all_config_chips(name, chip)))
+		       (chip = sensors_for_all_config_chips(chip_features,
+							    &nr)))
 			for (i = 0; i < chip->computes_count; i++) {
-				if (!strcmp(feature->name,
-					    chip->computes[i].name)) {
+				if (feature->name == chip->computes[i].name) {
 					expr = chip->computes[i].from_proc;
 					break;
 				}
 			}
 	}
 
-	res = sensors_read_sysfs_attr(name, subfeature, &val);
-	if (res)
-		return res;
+	/* The last value is returned along with SENSORS_ERR_SUSPENDED */
+	err = sensors_read_subfeature(chip_features, subfeature, &val, &at);
+	if (when)
+		*when = at;
+	if (err && err != -SENSORS_ERR_SUSPENDED)
+		return err;
 	if (!expr)
 		*result = val;
 	else if ((res = sensors_eval_expr(chip_features, expr, val, depth,
 					  result)))
 		return res;
-	return 0;
+	if (!err)
+		sensors_valstats_update(chip_features, subfeature, *result, at);
+	return err;
+}
+
+/* Read the value of a subfeature of a certain chip. Note that chip should not
+   contain wildcard values! This function will return 0 on success, and <0
+   on failure. */
+static int __sensors_get_value(const sensors_chip_name *name, int subfeat_nr,
+			       int depth, double *result)
+{
+	const sensors_chip_features *chip_features;
+	const sensors_subfeature *subfeature;
+
+	if (depth >= DEPTH_MAX)
+		return -SENSORS_ERR_RECURSION;
+	if (sensors_chip_name_has_wildcards(name))
+		return -SENSORS_ERR_WILDCARDS;
+	if (!(chip_features = sensors_lookup_chip(name)))
+		return -SENSORS_ERR_NO_ENTRY;
+	if (!(subfeature = sensors_lookup_subfeature_nr(chip_features,
+							subfeat_nr)))
+		return -SENSORS_ERR_NO_ENTRY;
+	return sensors_get_chip_value(chip_features, subfeature, depth,
+				      result, NULL);
 }
 
 int sensors_get_value(const sensors_chip_name *name, int subfeat_nr,
 		      double *result)
 {
-	return __sensors_get_value(name, subfeat_nr, 0, result);
+	int res;
+
+	sensors_read_begin();
+	res = __sensors_get_value(name, subfeat_nr, 0, result);
+	sensors_read_end();
+	return res;
+}
+
+static void sensors_ns_to_timespec(uint64_t ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / 1000000000;
+	ts->tv_nsec = ns % 1000000000;
+}
+
+/* Look up a chip for reading, see __sensors_get_value() */
+static int sensors_lookup_chip_read(const sensors_chip_name *name,
+				    const sensors_chip_features **chip_features)
+{
+	if (sensors_chip_name_has_wildcards(name))
+		return -SENSORS_ERR_WILDCARDS;
+	if (!(*chip_features = sensors_lookup_chip(name)))
+		return -SENSORS_ERR_NO_ENTRY;
+	return 0;
+}
+
+static int sensors_get_reading(const sensors_chip_features *chip_features,
+			       int subfeat_nr, double *value,
+			       struct timespec *timestamp)
+{
+	const sensors_subfeature *subfeature;
+	uint64_t when = 0;
+	int res;
+
+	*value = 0;
+	if (!(subfeature = sensors_lookup_subfeature_nr(chip_features,
+							subfeat_nr)))
+		res = -SENSORS_ERR_NO_ENTRY;
+	else
+		res = sensors_get_chip_value(chip_features, subfeature, 0,
+					     value, &when);
+	sensors_ns_to_timespec(when, timestamp);
+	return res;
+}
+
+int sensors_get_value_timed(const sensors_chip_name *name, int subfeat_nr,
+			    double *value, struct timespec *timestamp)
+{
+	const sensors_chip_features *chip_features;
+	int res;
+
+	sensors_read_begin();
+	res = sensors_lookup_chip_read(name, &chip_features);
+	if (!res)
+		res = sensors_get_reading(chip_features, subfeat_nr, value,
+					  timestamp);
+	sensors_read_end();
+	return res;
+}
+
+static int __sensors_get_values_timed(const sensors_chip_name *name,
+				      sensors_reading *readings, int count)
+{
+	const sensors_chip_features *chip_features;
+	int i, res;
+
+	if ((res = sensors_lookup_chip_read(name, &chip_features)))
+		return res;
+
+	sensors_virtual_begin(chip_features);
+	for (i = 0; i < count; i++)
+		readings[i].err = sensors_get_reading(chip_features,
+						      readings[i].subfeat_nr,
+						      &readings[i].value,
+						      &readings[i].timestamp);
+	sensors_virtual_end(chip_features);
+	return 0;
+}
+
+int sensors_get_values_timed(const sensors_chip_name *name,
+			     sensors_reading *readings, int count)
+{
+	int res;
+
+	sensors_read_begin();
+	res = __sensors_get_values_timed(name, readings, count);
+	sensors_read_end();
+	return res;
+}
+
+static int __sensors_get_snapshot(const sensors_chip_name *name,
+				  sensors_reading *readings, int max)
+{
+	const sensors_chip_features *chip_features;
+	const sensors_feature *feature;
+	const sensors_subfeature *subfeature;
+	sensors_reading *reading;
+	int i, j, res, count = 0;
+
+	if ((res = sensors_lookup_chip_read(name, &chip_features)))
+		return res;
+
+	sensors_virtual_begin(chip_features);
+	for (i = 0; i < chip_features->visible_features_count; i++) {
+		feature = chip_features->visible_features[i];
+		for (j = feature->first_subfeature;
+		     j < chip_features->subfeature_count &&
+		     chip_features->subfeature[j].mapping == feature->number;
+		     j++) {
+			subfeature = chip_features->subfeature + j;
+			if (!(subfeature->flags & SENSORS_MODE_R))
+				continue;
+			if (count < max) {
+				reading = readings + count;
+				reading->subfeat_nr = subfeature->number;
+				reading->err = sensors_get_reading(
+					chip_features, subfeature->number,
+					&reading->value, &reading->timestamp);
+			}
+			count++;
+		}
+	}
+	sensors_virtual_end(chip_features);
+	return count;
+}
+
+int sensors_get_snapshot(const sensors_chip_name *name,
+			 sensors_reading *readings, int max)
+{
+	int res;
+
+	sensors_read_begin();
+	res = __sensors_get_snapshot(name, readings, max);
+	sensors_read_end();
+	return res;
 }
 
 /* Set the value of a subfeature of a certain chip. Note that chip should not
    contain wildcard values! This function will return 0 on success, and <0
    on failure. */
-int sensors_set_value(const sensors_chip_name *name, int subfeat_nr,
-		      double value)
+static int __sensors_set_value(const sensors_chip_name *name, int subfeat_nr,
+			       double value)
 {
 	const sensors_chip_features *chip_features;
 	const sensors_subfeature *subfeature;
 	const sensors_expr *expr = NULL;
-	int i, res;
+	int i, res, nr;
 	double to_write;
+	uint64_t start;
 
 	if (sensors_chip_name_has_wildcards(name))
 		return -SENSORS_ERR_WILDCARDS;
@@ -312,12 +767,12 @@ int sensors_set_value(const sensors_chip_name *name, int subfeat_nr,
 		feature = sensors_lookup_feature_nr(chip_features,
 					subfeature->mapping);
 
-		chip = NULL;
+		nr = 0;
 		while (!expr &&
-		       (chip = sensors_for_all_config_chips(name, chip)))
+		       (chip = sensors_for_all_config_chips(chip_features,
+							    &nr)))
 			for (i = 0; i < chip->computes_count; i++) {
-				if (!strcmp(feature->name,
-					    chip->computes[i].name)) {
+				if (feature->name == chip->computes[i].name) {
 					expr = chip->computes[i].to_proc;
 					break;
 				}
@@ -329,23 +784,304 @@ int sensors_set_value(const sensors_chip_name *name, int subfeat_nr,
 		if ((res = sensors_eval_expr(chip_features, expr,
 					     value, 0, &to_write)))
 			return res;
-	return sensors_write_sysfs_attr(name, subfeature, to_write);
+
+	start = sensors_stats_start();
+	res = sensors_write_sysfs_attr(name, subfeature, to_write);
+	sensors_stats_attr(chip_features, subfeature, SENSORS_STATS_WRITE,
+			   start, res);
+	/* Even a failed write may have changed something */
+	sensors_read_invalidate_limits(chip_features);
+	return res;
 }
 
-const sensors_chip_name *sensors_get_detected_chips(const sensors_chip_name
-						    *match, int *nr)
+int sensors_set_value(const sensors_chip_name *name, int subfeat_nr,
+		      double value)
+{
+	int res;
+
+	sensors_read_begin();
+	res = __sensors_set_value(name, subfeat_nr, value);
+	sensors_read_end();
+	return res;
+}
+
+/*
+ * Selectors: one or more chip names with a subfeature name pattern each
+ * (several for groups of the configuration), matched once against the
+ * detected chips. The matching subfeatures are kept in a flat list, which
+ * is only rebuilt when the list of detected chips changes. Every change
+ * gives the context a new, globally unique generation number, so that a
+ * selector also notices when it is used with another context, or with a
+ * context which was reloaded.
+ */
+struct sensors_selector_entry {
+	const sensors_chip_features *chip_features;
+	const sensors_subfeature *subfeature;
+};
+
+struct sensors_selector_item {
+	sensors_chip_name chip;
+	int any_chip;
+	char *pattern;			/* fnmatch() pattern */
+};
+
+struct sensors_selector {
+	struct sensors_selector_item *items;
+	int items_count;
+	int items_max;
+	unsigned int chips_gen;		/* Generation matched against */
+	struct sensors_selector_entry *entries;
+	int entries_count;
+	int entries_max;
+};
+
+static unsigned int sensors_chips_gen;
+
+void sensors_chips_changed(void)
+{
+	sensors_current_context->chips_gen =
+		__atomic_add_fetch(&sensors_chips_gen, 1, __ATOMIC_RELAXED);
+}
+
+/* Parse a selector spec and add it to a selector */
+static int sensors_add_selector_item(sensors_selector *sel, const char *spec)
+{
+	struct sensors_selector_item item;
+	const char *slash;
+	char *chip;
+	int res;
+
+	memset(&item, 0, sizeof(item));
+
+	/* No chip part means any chip */
+	slash = strchr(spec, '/');
+	if (!slash || (slash - spec == 1 && spec[0] == '*')) {
+		item.any_chip = 1;
+	} else {
+		chip = strndup(spec, slash - spec);
+		if (!chip)
+			sensors_fatal_error(__func__, "Out of memory");
+		res = sensors_parse_chip_name(chip, &item.chip);
+		free(chip);
+		if (res)
+			return res;
+	}
+
+	if (!(slash ? slash[1] : spec[0])) {
+		sensors_free_chip_name(&item.chip);
+		return -SENSORS_ERR_PARSE;
+	}
+	item.pattern = strdup(slash ? slash + 1 : spec);
+	if (!item.pattern)
+		sensors_fatal_error(__func__, "Out of memory");
+
+	sensors_add_array_el(&item, &sel->items, &sel->items_count,
+			     &sel->items_max, sizeof(item));
+	return 0;
+}
+
+int sensors_compile_selector(const char *spec, sensors_selector **selector)
+{
+	sensors_selector *sel;
+	int res;
+
+	sel = calloc(1, sizeof(*sel));
+	if (!sel)
+		sensors_fatal_error(__func__, "Out of memory");
+
+	if ((res = sensors_add_selector_item(sel, spec))) {
+		sensors_free_selector(sel);
+		return res;
+	}
+
+	*selector = sel;
+	return 0;
+}
+
+static int __sensors_compile_group(const char *name,
+				   sensors_selector **selector)
+{
+	const sensors_group *group;
+	sensors_selector *sel;
+	int i, j, res;
+
+	sel = calloc(1, sizeof(*sel));
+	if (!sel)
+		sensors_fatal_error(__func__, "Out of memory");
+
+	/* All the statements of the group, in order */
+	for (i = 0; i < sensors_config_groups_count; i++) {
+		group = &sensors_config_groups[i];
+		if (strcmp(group->name, name))
+			continue;
+		for (j = 0; j < group->specs_count; j++)
+			if ((res = sensors_add_selector_item(sel,
+							group->specs[j]))) {
+				sensors_free_selector(sel);
+				return res;
+			}
+	}
+
+	if (!sel->items_count) {
+		sensors_free_selector(sel);
+		return -SENSORS_ERR_NO_ENTRY;
+	}
+	*selector = sel;
+	return 0;
+}
+
+int sensors_compile_group(const char *name, sensors_selector **selector)
+{
+	int res;
+
+	sensors_read_begin();
+	res = __sensors_compile_group(name, selector);
+	sensors_read_end();
+	return res;
+}
+
+void sensors_free_selector(sensors_selector *selector)
+{
+	int i;
+
+	if (!selector)
+		return;
+	for (i = 0; i < selector->items_count; i++) {
+		sensors_free_chip_name(&selector->items[i].chip);
+		free(selector->items[i].pattern);
+	}
+	free(selector->items);
+	free(selector->entries);
+	free(selector);
+}
+
+void sensors_walk_selector(const sensors_selector *sel,
+			   sensors_selector_fn fn, void *data)
+{
+	const struct sensors_selector_item *item;
+	const sensors_chip_features *chip_features;
+	const sensors_subfeature *subfeature;
+	int i, j, k;
+
+	for (k = 0; k < sel->items_count; k++) {
+		item = sel->items + k;
+		for (i = 0; i < sensors_proc_chips_count; i++) {
+			chip_features = sensors_proc_chips[i];
+			if (!item->any_chip &&
+			    !sensors_match_chip(&chip_features->chip,
+						&item->chip))
+				continue;
+
+			for (j = 0; j < chip_features->subfeature_count; j++) {
+				subfeature = chip_features->subfeature + j;
+				if (!(subfeature->flags & SENSORS_MODE_R) ||
+				    fnmatch(item->pattern, subfeature->name,
+					    0) ||
+				    sensors_get_ignored(chip_features,
+						chip_features->feature +
+						subfeature->mapping))
+					continue;
+				fn(chip_features, subfeature, data);
+			}
+		}
+	}
+}
+
+static void sensors_add_selector_entry(const sensors_chip_features
+				       *chip_features,
+				       const sensors_subfeature *subfeature,
+				       void *data)
+{
+	sensors_selector *sel = data;
+	struct sensors_selector_entry entry;
+	int i;
+
+	/* The items of a group may overlap */
+	for (i = 0; sel->items_count > 1 && i < sel->entries_count; i++)
+		if (sel->entries[i].subfeature == subfeature)
+			return;
+
+	entry.chip_features = chip_features;
+	entry.subfeature = subfeature;
+	sensors_add_array_el(&entry, &sel->entries, &sel->entries_count,
+			     &sel->entries_max, sizeof(entry));
+}
+
+static void sensors_match_selector(sensors_selector *sel)
+{
+	sel->entries_count = 0;
+	sensors_walk_selector(sel, sensors_add_selector_entry, sel);
+	sel->chips_gen = sensors_current_context->chips_gen;
+}
+
+static int __sensors_read_selector(sensors_selector *selector,
+				   sensors_selection *values, int max)
+{
+	const struct sensors_selector_entry *entry;
+	const sensors_chip_features *virt = NULL;
+	uint64_t when;
+	int i;
+
+	if (selector->chips_gen != sensors_current_context->chips_gen)
+		sensors_match_selector(selector);
+
+	for (i = 0; i < selector->entries_count && i < max; i++) {
+		entry = selector->entries + i;
+		if (entry->chip_features->virt && !virt) {
+			virt = entry->chip_features;
+			sensors_virtual_begin(virt);
+		}
+		values[i].chip = &entry->chip_features->chip;
+		values[i].subfeature = entry->subfeature;
+		values[i].value = 0;
+		when = 0;
+		values[i].err = sensors_get_chip_value(entry->chip_features,
+						       entry->subfeature, 0,
+						       &values[i].value,
+						       &when);
+		sensors_ns_to_timespec(when, &values[i].timestamp);
+	}
+	if (virt)
+		sensors_virtual_end(virt);
+	return selector->entries_count;
+}
+
+int sensors_read_selector(sensors_selector *selector,
+			  sensors_selection *values, int max)
+{
+	int res;
+
+	sensors_read_begin();
+	res = __sensors_read_selector(selector, values, max);
+	sensors_read_end();
+	return res;
+}
+
+static const sensors_chip_name *
+__sensors_get_detected_chips(const sensors_chip_name *match, int *nr)
 {
 	const sensors_chip_name *res;
 
 	while (*nr < sensors_proc_chips_count) {
-		res = &sensors_proc_chips[(*nr)++].chip;
+		res = &sensors_proc_chips[(*nr)++]->chip;
 		if (!match || sensors_match_chip(res, match))
 			return res;
 	}
 	return NULL;
 }
 
-const char *sensors_get_adapter_name(const sensors_bus_id *bus)
+const sensors_chip_name *sensors_get_detected_chips(const sensors_chip_name
+						    *match, int *nr)
+{
+	const sensors_chip_name *res;
+
+	sensors_read_begin();
+	res = __sensors_get_detected_chips(match, nr);
+	sensors_read_end();
+	return res;
+}
+
+static const char *__sensors_get_adapter_name(const sensors_bus_id *bus)
 {
 	int i;
 
@@ -377,8 +1113,18 @@ const char *sensors_get_adapter_name(const sensors_bus_id *bus)
 	return NULL;
 }
 
-const sensors_feature *
-sensors_get_features(const sensors_chip_name *name, int *nr)
+const char *sensors_get_adapter_name(const sensors_bus_id *bus)
+{
+	const char *res;
+
+	sensors_read_begin();
+	res = __sensors_get_adapter_name(bus);
+	sensors_read_end();
+	return res;
+}
+
+static const sensors_feature *
+__sensors_get_features(const sensors_chip_name *name, int *nr)
 {
 	const sensors_chip_features *chip;
 
@@ -386,16 +1132,27 @@ sensors_get_features(const sensors_chip_name *name, int *nr)
 		return NULL;	/* No such chip */
 
 	while (*nr < chip->feature_count
-	    && sensors_get_ignored(name, &chip->feature[*nr]))
+	    && sensors_get_ignored(chip, &chip->feature[*nr]))
 		(*nr)++;
 	if (*nr >= chip->feature_count)
 		return NULL;
 	return &chip->feature[(*nr)++];
 }
 
-const sensors_subfeature *
-sensors_get_all_subfeatures(const sensors_chip_name *name,
-			const sensors_feature *feature, int *nr)
+const sensors_feature *
+sensors_get_features(const sensors_chip_name *name, int *nr)
+{
+	const sensors_feature *res;
+
+	sensors_read_begin();
+	res = __sensors_get_features(name, nr);
+	sensors_read_end();
+	return res;
+}
+
+static const sensors_subfeature *
+__sensors_get_all_subfeatures(const sensors_chip_name *name,
+			      const sensors_feature *feature, int *nr)
 {
 	const sensors_chip_features *chip;
 	const sensors_subfeature *subfeature;
@@ -416,9 +1173,77 @@ sensors_get_all_subfeatures(const sensors_chip_name *name,
 }
 
 const sensors_subfeature *
-sensors_get_subfeature(const sensors_chip_name *name,
-		       const sensors_feature *feature,
-		       sensors_subfeature_type type)
+sensors_get_all_subfeatures(const sensors_chip_name *name,
+			    const sensors_feature *feature, int *nr)
+{
+	const sensors_subfeature *res;
+
+	sensors_read_begin();
+	res = __sensors_get_all_subfeatures(name, feature, nr);
+	sensors_read_end();
+	return res;
+}
+
+static const sensors_feature * const *
+__sensors_get_feature_array(const sensors_chip_name *name, int *count)
+{
+	const sensors_chip_features *chip;
+
+	*count = 0;
+	if (!(chip = sensors_lookup_chip(name)))
+		return NULL;	/* No such chip */
+
+	*count = chip->visible_features_count;
+	return (const sensors_feature * const *)chip->visible_features;
+}
+
+const sensors_feature * const *
+sensors_get_feature_array(const sensors_chip_name *name, int *count)
+{
+	const sensors_feature * const *res;
+
+	sensors_read_begin();
+	res = __sensors_get_feature_array(name, count);
+	sensors_read_end();
+	return res;
+}
+
+static const sensors_subfeature *
+__sensors_get_subfeature_array(const sensors_chip_name *name,
+			       const sensors_feature *feature, int *count)
+{
+	const sensors_chip_features *chip;
+	int i;
+
+	*count = 0;
+	if (!(chip = sensors_lookup_chip(name)))
+		return NULL;	/* No such chip */
+
+	/* The subfeatures of a feature are contiguous */
+	for (i = feature->first_subfeature; i < chip->subfeature_count &&
+	     chip->subfeature[i].mapping == feature->number; i++)
+		(*count)++;
+	if (!*count)
+		return NULL;
+	return chip->subfeature + feature->first_subfeature;
+}
+
+const sensors_subfeature *
+sensors_get_subfeature_array(const sensors_chip_name *name,
+			     const sensors_feature *feature, int *count)
+{
+	const sensors_subfeature *res;
+
+	sensors_read_begin();
+	res = __sensors_get_subfeature_array(name, feature, count);
+	sensors_read_end();
+	return res;
+}
+
+static const sensors_subfeature *
+__sensors_get_subfeature(const sensors_chip_name *name,
+			 const sensors_feature *feature,
+			 sensors_subfeature_type type)
 {
 	const sensors_chip_features *chip;
 	int i;
@@ -434,12 +1259,38 @@ sensors_get_subfeature(const sensors_chip_name *name,
 	return NULL;	/* No such subfeature */
 }
 
+const sensors_subfeature *
+sensors_get_subfeature(const sensors_chip_name *name,
+		       const sensors_feature *feature,
+		       sensors_subfeature_type type)
+{
+	const sensors_subfeature *res;
+
+	sensors_read_begin();
+	res = __sensors_get_subfeature(name, feature, type);
+	sensors_read_end();
+	return res;
+}
+
 /* Evaluate an expression */
-int sensors_eval_expr(const sensors_chip_features *chip_features,
-		      const sensors_expr *expr,
-		      double val, int depth, double *result)
+static int sensors_eval_expr(const sensors_chip_features *chip_features,
+			     const sensors_expr *expr,
+			     double val, int depth, double *result)
+{
+	int res;
+
+	sensors_stats_add(expr_evals, 1);
+	SENSORS_PROBE2(eval_expr_start, chip_features->chip.prefix, depth);
+	res = __sensors_eval_expr(chip_features, expr, val, depth, result);
+	SENSORS_PROBE2(eval_expr_done, chip_features->chip.prefix, res);
+	return res;
+}
+
+static int __sensors_eval_expr(const sensors_chip_features *chip_features,
+			       const sensors_expr *expr,
+			       double val, int depth, double *result)
 {
-	double res1, res2;
+	double res1, res2 = 0;
 	int res;
 	const sensors_subfeature *subfeature;
 
@@ -459,14 +1310,23 @@ int sensors_eval_expr(const sensors_chip_features *chip_features,
 					   subfeature->number, depth + 1,
 					   result);
 	}
-	if ((res = sensors_eval_expr(chip_features, expr->data.subexpr.sub1,
-				     val, depth, &res1)))
+	/* Aggregates are for virtual sensors only, see virtual.c */
+	if (expr->kind == sensors_kind_aggr)
+		return -SENSORS_ERR_NO_ENTRY;
+	if ((res = __sensors_eval_expr(chip_features, expr->data.subexpr.sub1,
+				       val, depth, &res1)))
 		return res;
 	if (expr->data.subexpr.sub2 &&
-	    (res = sensors_eval_expr(chip_features, expr->data.subexpr.sub2,
-				     val, depth, &res2)))
+	    (res = __sensors_eval_expr(chip_features, expr->data.subexpr.sub2,
+				       val, depth, &res2)))
 		return res;
-	switch (expr->data.subexpr.op) {
+	return sensors_eval_op(expr->data.subexpr.op, res1, res2, result);
+}
+
+int sensors_eval_op(sensors_operation op, double res1, double res2,
+		    double *result)
+{
+	switch (op) {
 	case sensors_add:
 		*result = res1 + res2;
 		return 0;
@@ -504,13 +1364,14 @@ static int sensors_do_this_chip_sets(const sensors_chip_name *name)
 	const sensors_chip_features *chip_features;
 	sensors_chip *chip;
 	double value;
-	int i;
+	int i, nr;
 	int err = 0, res;
 	const sensors_subfeature *subfeature;
 
 	chip_features = sensors_lookup_chip(name);	/* Can't fail */
+	SENSORS_PROBE1(do_chip_sets_start, name->prefix);
 
-	for (chip = NULL; (chip = sensors_for_all_config_chips(name, chip));)
+	for (nr = 0; (chip = sensors_for_all_config_chips(chip_features, &nr));)
 		for (i = 0; i < chip->sets_count; i++) {
 			subfeature = sensors_lookup_subfeature_name(chip_features,
 							chip->sets[i].name);
@@ -541,6 +1402,8 @@ static int sensors_do_this_chip_sets(const sensors_chip_name *name)
 				continue;
 			}
 		}
+
+	SENSORS_PROBE2(do_chip_sets_done, name->prefix, err);
 	return err;
 }
 
@@ -552,10 +1415,12 @@ int sensors_do_chip_sets(const sensors_chip_name *name)
 	const sensors_chip_name *found_name;
 	int res = 0;
 
+	sensors_read_begin();
 	for (nr = 0; (found_name = sensors_get_detected_chips(name, &nr));) {
 		this_res = sensors_do_this_chip_sets(found_name);
 		if (this_res)
 			res = this_res;
 	}
+	sensors_read_end();
 	return res;
 }
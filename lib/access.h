@@ -30,4 +30,41 @@
    if there are wildcards. */
 int sensors_chip_name_has_wildcards(const sensors_chip_name *chip);
 
+/* Check whether a configuration file chip block could apply to any of the
+   detected chips. Returns 1 if it could, 0 if it can't. */
+int sensors_config_chip_detected(const sensors_chip_name_list *chips);
+
+/* Find the configuration chip blocks which apply to a detected chip. This
+   must be done again whenever the configuration changes. */
+void sensors_resolve_config(sensors_chip_features *chip_features);
+
+/* Record that the list of detected chips of the current context changed,
+   so that the selectors are matched again */
+void sensors_chips_changed(void);
+
+/* Look up a detected chip by name. Returns NULL if not found. */
+const sensors_chip_features *
+sensors_lookup_chip(const sensors_chip_name *name);
+
+/* Read the value of a subfeature of a detected chip, and apply the compute
+   statement if any. If when isn't NULL, it is set to the time the
+   subfeature was read, see sensors_read_subfeature(). */
+int sensors_get_chip_value(const sensors_chip_features *chip_features,
+			   const sensors_subfeature *subfeature,
+			   int depth, double *result, uint64_t *when);
+
+/* Apply an operator of an expression to the values of its operands (res2
+   is ignored for unary operators). Returns 0 on success, <0 on failure. */
+int sensors_eval_op(sensors_operation op, double res1, double res2,
+		    double *result);
+
+/* Call fn for each readable, not ignored subfeature of the detected
+   chips which a selector matches */
+typedef void (*sensors_selector_fn)(const sensors_chip_features
+				    *chip_features,
+				    const sensors_subfeature *subfeature,
+				    void *data);
+void sensors_walk_selector(const sensors_selector *sel,
+			   sensors_selector_fn fn, void *data);
+
 #endif /* def LIB_SENSORS_ACCESS_H */
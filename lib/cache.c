@@ -0,0 +1,478 @@
+/*
+    cache.c - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+/* this define needed for O_CLOEXEC, mkostemp() and secure_getenv() */
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "sensors.h"
+#include "data.h"
+#include "error.h"
+#include "general.h"
+#include "cache.h"
+#include "../version.h"
+
+/*
+   The discovery cache holds the detected busses and chips in a flat file,
+   which is mmap'ed and validated as a whole before anything is loaded
+   from it. All references are offsets, so the file can be mapped at any
+   address. The layout is:
+
+     header
+     bus records		(bus_count)
+     chip records		(chip_count)
+     feature records		(feature_count, all chips in order)
+     subfeature records		(subfeature_count, all chips in order)
+     strings			(strings_size bytes, NUL-terminated)
+
+   The cache is only used if the sysfs fingerprint stored in the header
+   matches the current one. The file uses the native byte order; it is
+   not meant to be shared between machines.
+*/
+
+#define CACHE_MAGIC	0x43534d4cU	/* "LMSC" */
+#define CACHE_VERSION	1
+
+struct cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t fingerprint;
+	uint32_t lib_hash;
+	uint32_t bus_count;
+	uint32_t chip_count;
+	uint32_t feature_count;
+	uint32_t subfeature_count;
+	uint32_t strings_size;
+};
+
+struct cache_bus {
+	uint32_t adapter;
+	int16_t type;
+	int16_t nr;
+};
+
+struct cache_chip {
+	uint32_t prefix;
+	uint32_t path;
+	int16_t bus_type;
+	int16_t bus_nr;
+	int32_t addr;
+	uint32_t feature_count;
+	uint32_t subfeature_count;
+};
+
+struct cache_feature {
+	uint32_t name;
+	int32_t type;
+	int32_t first_subfeature;
+};
+
+struct cache_subfeature {
+	uint32_t name;
+	int32_t type;
+	int32_t mapping;
+	uint32_t flags;
+};
+
+static char *cache_path;
+
+int sensors_set_cache_file(const char *path)
+{
+	free(cache_path);
+	cache_path = NULL;
+
+	if (path) {
+		cache_path = strdup(path);
+		if (!cache_path)
+			sensors_fatal_error(__func__, "Out of memory");
+	}
+	return 0;
+}
+
+const char *sensors_cache_file(void)
+{
+	const char *path;
+
+	if (cache_path)
+		return cache_path;
+
+	/* Not for set-user-ID programs: the cache could redirect writes */
+	path = secure_getenv("LIBSENSORS_CACHE");
+	if (path && path[0])
+		return path;
+	return NULL;
+}
+
+/* The cache is invalidated by library upgrades, as the discovery rules
+   may have changed */
+static uint32_t cache_lib_hash(void)
+{
+	const char *p;
+	uint32_t h = 2166136261U;
+
+	for (p = LM_VERSION; *p; p++) {
+		h ^= (unsigned char)*p;
+		h *= 16777619U;
+	}
+	return h ^ CACHE_VERSION;
+}
+
+static int check_string(const struct cache_header *hdr, uint32_t offset)
+{
+	return offset < hdr->strings_size;
+}
+
+/* Validate all records, so that loading can't fail half-way */
+static int cache_check(const struct cache_header *hdr,
+		       const struct cache_bus *bus,
+		       const struct cache_chip *chip,
+		       const struct cache_feature *feature,
+		       const struct cache_subfeature *subfeature)
+{
+	uint32_t i, j, nf = 0, nsf = 0;
+
+	for (i = 0; i < hdr->bus_count; i++)
+		if (!check_string(hdr, bus[i].adapter))
+			return -1;
+
+	for (i = 0; i < hdr->chip_count; i++) {
+		if (!check_string(hdr, chip[i].prefix) ||
+		    !check_string(hdr, chip[i].path) ||
+		    !chip[i].feature_count || !chip[i].subfeature_count ||
+		    chip[i].feature_count > hdr->feature_count - nf ||
+		    chip[i].subfeature_count > hdr->subfeature_count - nsf)
+			return -1;
+
+		for (j = 0; j < chip[i].feature_count; j++, nf++)
+			if (!check_string(hdr, feature[nf].name) ||
+			    feature[nf].first_subfeature < 0 ||
+			    (uint32_t)feature[nf].first_subfeature >=
+			    chip[i].subfeature_count)
+				return -1;
+
+		for (j = 0; j < chip[i].subfeature_count; j++, nsf++)
+			if (!check_string(hdr, subfeature[nsf].name) ||
+			    subfeature[nsf].mapping < 0 ||
+			    (uint32_t)subfeature[nsf].mapping >=
+			    chip[i].feature_count)
+				return -1;
+	}
+
+	return nf == hdr->feature_count && nsf == hdr->subfeature_count ?
+	       0 : -1;
+}
+
+static void cache_populate(const struct cache_header *hdr,
+			   const struct cache_bus *bus,
+			   const struct cache_chip *chip,
+			   const struct cache_feature *feature,
+			   const struct cache_subfeature *subfeature,
+			   const char *strings)
+{
+	uint32_t i;
+	int j;
+
+	for (i = 0; i < hdr->bus_count; i++) {
+		sensors_bus entry;
+
+		entry.adapter = sensors_arena_strdup(&sensors_proc_arena,
+						     strings + bus[i].adapter);
+		entry.bus.type = bus[i].type;
+		entry.bus.nr = bus[i].nr;
+		sensors_add_proc_bus(&entry);
+	}
+
+	for (i = 0; i < hdr->chip_count; i++) {
+		sensors_chip_features entry, *new_chip;
+
+		memset(&entry, 0, sizeof(entry));
+		entry.chip.prefix = sensors_intern_name(strings +
+							chip[i].prefix);
+		entry.chip.path = sensors_arena_strdup(&sensors_proc_arena,
+						       strings + chip[i].path);
+		entry.chip.bus.type = chip[i].bus_type;
+		entry.chip.bus.nr = chip[i].bus_nr;
+		entry.chip.addr = chip[i].addr;
+
+		entry.feature_count = chip[i].feature_count;
+		entry.feature = sensors_arena_calloc(&sensors_proc_arena,
+						     entry.feature_count,
+						     sizeof(sensors_feature));
+		for (j = 0; j < entry.feature_count; j++, feature++) {
+			entry.feature[j].name =
+				sensors_intern_name(strings + feature->name);
+			entry.feature[j].number = j;
+			entry.feature[j].type = feature->type;
+			entry.feature[j].first_subfeature =
+				feature->first_subfeature;
+		}
+
+		entry.subfeature_count = chip[i].subfeature_count;
+		entry.subfeature = sensors_arena_calloc(&sensors_proc_arena,
+						entry.subfeature_count,
+						sizeof(sensors_subfeature));
+		for (j = 0; j < entry.subfeature_count; j++, subfeature++) {
+			entry.subfeature[j].name =
+				sensors_intern_name(strings + subfeature->name);
+			entry.subfeature[j].number = j;
+			entry.subfeature[j].type = subfeature->type;
+			entry.subfeature[j].mapping = subfeature->mapping;
+			entry.subfeature[j].flags = subfeature->flags;
+		}
+
+		new_chip = sensors_arena_alloc(&sensors_proc_arena,
+					       sizeof(*new_chip));
+		*new_chip = entry;
+		sensors_add_proc_chips(&new_chip);
+	}
+}
+
+void *sensors_cache_map(const char *path, size_t min_size, size_t *size)
+{
+	int fd;
+	struct stat st;
+	void *map;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	/* Sysfs paths are taken from the file, and later written to, so
+	   only trust files which nobody else could have planted */
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+	    (st.st_uid != geteuid() && st.st_uid != 0) ||
+	    (st.st_mode & (S_IWGRP | S_IWOTH)) ||
+	    st.st_size < (off_t)min_size) {
+		close(fd);
+		return NULL;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	*size = st.st_size;
+	return map;
+}
+
+int sensors_cache_load(const char *path, uint64_t fingerprint)
+{
+	int err = -1;
+	size_t map_size;
+	void *map;
+	const char *p;
+	const struct cache_header *hdr;
+	const struct cache_bus *bus;
+	const struct cache_chip *chip;
+	const struct cache_feature *feature;
+	const struct cache_subfeature *subfeature;
+	uint64_t size;
+
+	map = sensors_cache_map(path, sizeof(struct cache_header), &map_size);
+	if (!map)
+		return -1;
+
+	hdr = map;
+	if (hdr->magic != CACHE_MAGIC || hdr->version != CACHE_VERSION ||
+	    hdr->lib_hash != cache_lib_hash() ||
+	    hdr->fingerprint != fingerprint)
+		goto exit_unmap;
+
+	size = sizeof(struct cache_header) +
+	       (uint64_t)hdr->bus_count * sizeof(struct cache_bus) +
+	       (uint64_t)hdr->chip_count * sizeof(struct cache_chip) +
+	       (uint64_t)hdr->feature_count * sizeof(struct cache_feature) +
+	       (uint64_t)hdr->subfeature_count *
+	       sizeof(struct cache_subfeature) +
+	       hdr->strings_size;
+	if (size != (uint64_t)map_size || !hdr->strings_size)
+		goto exit_unmap;
+
+	p = (const char *)(hdr + 1);
+	bus = (const struct cache_bus *)p;
+	p += hdr->bus_count * sizeof(struct cache_bus);
+	chip = (const struct cache_chip *)p;
+	p += hdr->chip_count * sizeof(struct cache_chip);
+	feature = (const struct cache_feature *)p;
+	p += hdr->feature_count * sizeof(struct cache_feature);
+	subfeature = (const struct cache_subfeature *)p;
+	p += hdr->subfeature_count * sizeof(struct cache_subfeature);
+
+	/* All strings are terminated if the last one is */
+	if (p[hdr->strings_size - 1] != '\0' ||
+	    cache_check(hdr, bus, chip, feature, subfeature))
+		goto exit_unmap;
+
+	cache_populate(hdr, bus, chip, feature, subfeature, p);
+	err = 0;
+
+exit_unmap:
+	munmap(map, map_size);
+	return err;
+}
+
+/* Append a string to the string area and return its offset */
+static uint32_t cache_add_string(char *strings, uint32_t *size,
+				 const char *s)
+{
+	uint32_t offset = *size;
+	size_t len = strlen(s) + 1;
+
+	memcpy(strings + offset, s, len);
+	*size += len;
+	return offset;
+}
+
+void sensors_cache_save(const char *path, uint64_t fingerprint)
+{
+	struct cache_header hdr;
+	struct cache_bus *bus;
+	struct cache_chip *chip;
+	struct cache_feature *feature;
+	struct cache_subfeature *subfeature;
+	char *buf, *strings;
+	size_t size, strings_max;
+	int i, j;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = CACHE_MAGIC;
+	hdr.version = CACHE_VERSION;
+	hdr.fingerprint = fingerprint;
+	hdr.lib_hash = cache_lib_hash();
+	hdr.bus_count = sensors_proc_bus_count;
+	hdr.chip_count = sensors_proc_chips_count;
+
+	strings_max = 0;
+	for (i = 0; i < sensors_proc_bus_count; i++)
+		strings_max += strlen(sensors_proc_bus[i].adapter) + 1;
+	for (i = 0; i < sensors_proc_chips_count; i++) {
+		const sensors_chip_features *c = sensors_proc_chips[i];
+
+		strings_max += strlen(c->chip.prefix) + 1 +
+			       strlen(c->chip.path) + 1;
+		for (j = 0; j < c->feature_count; j++)
+			strings_max += strlen(c->feature[j].name) + 1;
+		for (j = 0; j < c->subfeature_count; j++)
+			strings_max += strlen(c->subfeature[j].name) + 1;
+		hdr.feature_count += c->feature_count;
+		hdr.subfeature_count += c->subfeature_count;
+	}
+	if (strings_max > UINT32_MAX)
+		return;
+
+	size = sizeof(hdr) + hdr.bus_count * sizeof(*bus) +
+	       hdr.chip_count * sizeof(*chip) +
+	       hdr.feature_count * sizeof(*feature) +
+	       hdr.subfeature_count * sizeof(*subfeature) + strings_max;
+	buf = malloc(size);
+	if (!buf)
+		return;
+
+	bus = (struct cache_bus *)(buf + sizeof(hdr));
+	chip = (struct cache_chip *)(bus + hdr.bus_count);
+	feature = (struct cache_feature *)(chip + hdr.chip_count);
+	subfeature = (struct cache_subfeature *)(feature + hdr.feature_count);
+	strings = (char *)(subfeature + hdr.subfeature_count);
+
+	for (i = 0; i < sensors_proc_bus_count; i++) {
+		bus[i].adapter = cache_add_string(strings, &hdr.strings_size,
+						  sensors_proc_bus[i].adapter);
+		bus[i].type = sensors_proc_bus[i].bus.type;
+		bus[i].nr = sensors_proc_bus[i].bus.nr;
+	}
+
+	for (i = 0; i < sensors_proc_chips_count; i++) {
+		const sensors_chip_features *c = sensors_proc_chips[i];
+
+		chip[i].prefix = cache_add_string(strings, &hdr.strings_size,
+						  c->chip.prefix);
+		chip[i].path = cache_add_string(strings, &hdr.strings_size,
+						c->chip.path);
+		chip[i].bus_type = c->chip.bus.type;
+		chip[i].bus_nr = c->chip.bus.nr;
+		chip[i].addr = c->chip.addr;
+		chip[i].feature_count = c->feature_count;
+		chip[i].subfeature_count = c->subfeature_count;
+
+		for (j = 0; j < c->feature_count; j++, feature++) {
+			feature->name = cache_add_string(strings,
+							 &hdr.strings_size,
+							 c->feature[j].name);
+			feature->type = c->feature[j].type;
+			feature->first_subfeature =
+				c->feature[j].first_subfeature;
+		}
+		for (j = 0; j < c->subfeature_count; j++, subfeature++) {
+			subfeature->name = cache_add_string(strings,
+							&hdr.strings_size,
+							c->subfeature[j].name);
+			subfeature->type = c->subfeature[j].type;
+			subfeature->mapping = c->subfeature[j].mapping;
+			subfeature->flags = c->subfeature[j].flags;
+		}
+	}
+
+	/* An empty string area would be rejected by the loader */
+	if (!hdr.strings_size)
+		goto exit_free;
+	memcpy(buf, &hdr, sizeof(hdr));
+	sensors_cache_write(path, buf, size);
+
+exit_free:
+	free(buf);
+}
+
+void sensors_cache_write(const char *path, const void *buf, size_t size)
+{
+	char tmp_path[PATH_MAX], *slash;
+	int fd, len;
+
+	/* Create the cache directory if needed, but only one level */
+	len = snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path);
+	if (len < 0 || len >= (int)sizeof(tmp_path))
+		return;
+	slash = strrchr(tmp_path, '/');
+	if (slash && slash != tmp_path) {
+		*slash = '\0';
+		mkdir(tmp_path, 0755);
+		*slash = '/';
+	}
+
+	/* Write to a temporary file and rename it, so that readers never
+	   see a partially written cache */
+	fd = mkostemp(tmp_path, O_CLOEXEC);
+	if (fd < 0)
+		return;
+	if (fchmod(fd, 0644) < 0 ||
+	    write(fd, buf, size) != (ssize_t)size) {
+		close(fd);
+		unlink(tmp_path);
+		return;
+	}
+	if (close(fd) < 0 || rename(tmp_path, path) < 0)
+		unlink(tmp_path);
+}
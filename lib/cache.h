@@ -0,0 +1,48 @@
+/*
+    cache.h - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#ifndef LIB_SENSORS_CACHE_H
+#define LIB_SENSORS_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Return the discovery cache file to use, or NULL if caching is
+   disabled */
+const char *sensors_cache_file(void);
+
+/* Load the detected busses and chips from the cache file. Returns 0 on
+   success, <0 if the cache is missing, invalid or out of date, in which
+   case nothing was loaded. */
+int sensors_cache_load(const char *path, uint64_t fingerprint);
+
+/* Save the detected busses and chips to the cache file. Failures are
+   silently ignored, the cache is only an optimization. */
+void sensors_cache_save(const char *path, uint64_t fingerprint);
+
+/* Map a cache file of at least min_size bytes in memory, read-only.
+   Files not owned by the effective user or root, or writable by others,
+   are refused. Returns NULL on failure. Unmap it with munmap(). */
+void *sensors_cache_map(const char *path, size_t min_size, size_t *size);
+
+/* Atomically replace a cache file with the given contents. Failures are
+   silently ignored. */
+void sensors_cache_write(const char *path, const void *buf, size_t size);
+
+#endif /* def LIB_SENSORS_CACHE_H */
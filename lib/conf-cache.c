@@ -0,0 +1,914 @@
+/*
+    conf-cache.c - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+/* this define needed for secure_getenv() */
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sensors.h"
+#include "data.h"
+#include "error.h"
+#include "general.h"
+#include "cache.h"
+#include "conf-cache.h"
+#include "../version.h"
+
+/*
+   The configuration cache holds the result of parsing the default
+   configuration files, after bus substitution, in a flat file which is
+   mmap'ed and validated as a whole before anything is loaded from it.
+   Strings are referenced by offset, everything else by index. The layout
+   is:
+
+     header
+     expression records		(expr_count)
+     file records		(file_count)
+     chip records		(chip_count)
+     chip name records		(fits_count, all chips in order)
+     label records		(label_count, all chips in order)
+     set records		(set_count, all chips in order)
+     compute records		(compute_count, all chips in order)
+     ignore records		(ignore_count, all chips in order)
+     virtual records		(virtual_count)
+     group records		(group_count)
+     group selector records	(group_spec_count, all groups in order)
+     strings			(strings_size bytes, NUL-terminated)
+
+   Expressions are stored in post-order, so a node only refers to nodes
+   before it. The cache is only used if the fingerprint stored in the
+   header matches the current one.
+*/
+
+#define CONF_CACHE_MAGIC	0x43434d4cU	/* "LMCC" */
+#define CONF_CACHE_VERSION	4
+
+#define CONF_CACHE_NONE		0xffffffffU	/* NULL string */
+
+struct conf_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t fingerprint;
+	uint32_t expr_count;
+	uint32_t file_count;
+	uint32_t chip_count;
+	uint32_t fits_count;
+	uint32_t label_count;
+	uint32_t set_count;
+	uint32_t compute_count;
+	uint32_t ignore_count;
+	uint32_t virtual_count;
+	uint32_t group_count;
+	uint32_t group_spec_count;
+	uint32_t strings_size;
+};
+
+struct conf_cache_expr {
+	double val;
+	int32_t kind;
+	int32_t op;		/* Operation or aggregate function */
+	uint32_t var;		/* Variable name or selector */
+	int32_t sub1;
+	int32_t sub2;
+	int32_t pad;
+};
+
+struct conf_cache_line {
+	int32_t file;		/* -1 if none */
+	int32_t lineno;
+};
+
+struct conf_cache_file {
+	uint32_t name;
+};
+
+struct conf_cache_chip {
+	uint32_t fits_count;
+	uint32_t label_count;
+	uint32_t set_count;
+	uint32_t compute_count;
+	uint32_t ignore_count;
+	int32_t suspended;
+	struct conf_cache_line line;
+};
+
+struct conf_cache_name {
+	uint32_t prefix;
+	int16_t bus_type;
+	int16_t bus_nr;
+	int32_t addr;
+};
+
+struct conf_cache_label {
+	uint32_t name;
+	uint32_t value;
+	struct conf_cache_line line;
+};
+
+struct conf_cache_set {
+	uint32_t name;
+	int32_t value;
+	struct conf_cache_line line;
+};
+
+struct conf_cache_compute {
+	uint32_t name;
+	int32_t from_proc;
+	int32_t to_proc;
+	struct conf_cache_line line;
+};
+
+struct conf_cache_ignore {
+	uint32_t name;
+	struct conf_cache_line line;
+};
+
+struct conf_cache_virtual {
+	uint32_t name;
+	int32_t value;
+	struct conf_cache_line line;
+};
+
+struct conf_cache_group {
+	uint32_t name;
+	uint32_t spec_count;
+	struct conf_cache_line line;
+};
+
+struct conf_cache_spec {
+	uint32_t spec;
+};
+
+/* Pointers to the sections of a cache file */
+struct conf_cache_map {
+	const struct conf_cache_header *hdr;
+	const struct conf_cache_expr *expr;
+	const struct conf_cache_file *file;
+	const struct conf_cache_chip *chip;
+	const struct conf_cache_name *fits;
+	const struct conf_cache_label *label;
+	const struct conf_cache_set *set;
+	const struct conf_cache_compute *compute;
+	const struct conf_cache_ignore *ignore;
+	const struct conf_cache_virtual *virt;
+	const struct conf_cache_group *group;
+	const struct conf_cache_spec *spec;
+	const char *strings;
+};
+
+static char *config_cache_path;
+
+int sensors_set_config_cache_file(const char *path)
+{
+	free(config_cache_path);
+	config_cache_path = NULL;
+
+	if (path) {
+		config_cache_path = strdup(path);
+		if (!config_cache_path)
+			sensors_fatal_error(__func__, "Out of memory");
+	}
+	return 0;
+}
+
+const char *sensors_config_cache_file(void)
+{
+	const char *path;
+
+	if (config_cache_path)
+		return config_cache_path;
+
+	/* Not for set-user-ID programs: the cache could inject writes */
+	path = secure_getenv("LIBSENSORS_CONFIG_CACHE");
+	if (path && path[0])
+		return path;
+	return NULL;
+}
+
+/* FNV-1a, 64-bit */
+static void conf_cache_hash(uint64_t *h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len--) {
+		*h ^= *p++;
+		*h *= 1099511628211ULL;
+	}
+}
+
+uint64_t sensors_config_cache_fingerprint(void)
+{
+	uint64_t h = 14695981039346656037ULL;
+	uint32_t version = CONF_CACHE_VERSION;
+	int i;
+
+	conf_cache_hash(&h, LM_VERSION, sizeof(LM_VERSION));
+	conf_cache_hash(&h, &version, sizeof(version));
+
+	for (i = 0; i < sensors_proc_bus_count; i++) {
+		conf_cache_hash(&h, &sensors_proc_bus[i].bus,
+				sizeof(sensors_proc_bus[i].bus));
+		conf_cache_hash(&h, sensors_proc_bus[i].adapter,
+				strlen(sensors_proc_bus[i].adapter) + 1);
+	}
+
+	/* Skipped chip blocks depend on the detected chips */
+	conf_cache_hash(&h, &sensors_config_skip_absent,
+			sizeof(sensors_config_skip_absent));
+	if (sensors_config_skip_absent > 0) {
+		for (i = 0; i < sensors_proc_chips_count; i++) {
+			const sensors_chip_name *chip =
+				&sensors_proc_chips[i]->chip;
+
+			conf_cache_hash(&h, chip->prefix,
+					strlen(chip->prefix) + 1);
+			conf_cache_hash(&h, &chip->bus.type,
+					sizeof(chip->bus.type));
+			conf_cache_hash(&h, &chip->addr, sizeof(chip->addr));
+		}
+	}
+
+	return h;
+}
+
+void sensors_config_cache_add_file(uint64_t *fingerprint, const char *path)
+{
+	struct stat st;
+	int64_t id[5];
+
+	memset(id, 0, sizeof(id));
+	if (stat(path, &st) == 0) {
+		id[0] = st.st_size;
+		id[1] = st.st_mtim.tv_sec;
+		id[2] = st.st_mtim.tv_nsec;
+		id[3] = st.st_ino;
+		id[4] = st.st_dev;
+	}
+
+	conf_cache_hash(fingerprint, path, strlen(path) + 1);
+	conf_cache_hash(fingerprint, id, sizeof(id));
+}
+
+static int check_string(const struct conf_cache_map *m, uint32_t offset)
+{
+	return offset < m->hdr->strings_size;
+}
+
+static int check_line(const struct conf_cache_map *m,
+		      const struct conf_cache_line *line)
+{
+	return line->file >= -1 && line->file < (int32_t)m->hdr->file_count;
+}
+
+static int check_expr(const struct conf_cache_map *m, int32_t index)
+{
+	return index >= 0 && index < (int32_t)m->hdr->expr_count;
+}
+
+/* Validate all records, so that loading can't fail half-way */
+static int conf_cache_check(const struct conf_cache_map *m)
+{
+	const struct conf_cache_header *hdr = m->hdr;
+	uint64_t fits = 0, labels = 0, sets = 0, computes = 0, ignores = 0;
+	uint64_t specs = 0;
+	uint32_t i;
+
+	for (i = 0; i < hdr->expr_count; i++) {
+		const struct conf_cache_expr *e = &m->expr[i];
+
+		switch (e->kind) {
+		case sensors_kind_val:
+		case sensors_kind_source:
+			break;
+		case sensors_kind_var:
+			if (!check_string(m, e->var))
+				return -1;
+			break;
+		case sensors_kind_aggr:
+			if (e->op < sensors_max || e->op > sensors_avg ||
+			    !check_string(m, e->var))
+				return -1;
+			break;
+		case sensors_kind_sub:
+			if (e->op < sensors_add || e->op > sensors_log ||
+			    e->sub1 < 0 || e->sub1 >= (int32_t)i ||
+			    e->sub2 < -1 || e->sub2 >= (int32_t)i)
+				return -1;
+			/* Only the unary operators have no second operand */
+			if (e->sub2 < 0 && e->op != sensors_negate &&
+			    e->op != sensors_exp && e->op != sensors_log)
+				return -1;
+			break;
+		default:
+			return -1;
+		}
+	}
+
+	for (i = 0; i < hdr->file_count; i++)
+		if (!check_string(m, m->file[i].name))
+			return -1;
+
+	for (i = 0; i < hdr->chip_count; i++) {
+		if (!m->chip[i].fits_count || !check_line(m, &m->chip[i].line))
+			return -1;
+		fits += m->chip[i].fits_count;
+		labels += m->chip[i].label_count;
+		sets += m->chip[i].set_count;
+		computes += m->chip[i].compute_count;
+		ignores += m->chip[i].ignore_count;
+	}
+	if (fits != hdr->fits_count || labels != hdr->label_count ||
+	    sets != hdr->set_count || computes != hdr->compute_count ||
+	    ignores != hdr->ignore_count)
+		return -1;
+
+	for (i = 0; i < hdr->fits_count; i++)
+		if (m->fits[i].prefix != CONF_CACHE_NONE &&
+		    !check_string(m, m->fits[i].prefix))
+			return -1;
+	for (i = 0; i < hdr->label_count; i++)
+		if (!check_string(m, m->label[i].name) ||
+		    !check_string(m, m->label[i].value) ||
+		    !check_line(m, &m->label[i].line))
+			return -1;
+	for (i = 0; i < hdr->set_count; i++)
+		if (!check_string(m, m->set[i].name) ||
+		    !check_expr(m, m->set[i].value) ||
+		    !check_line(m, &m->set[i].line))
+			return -1;
+	for (i = 0; i < hdr->compute_count; i++)
+		if (!check_string(m, m->compute[i].name) ||
+		    !check_expr(m, m->compute[i].from_proc) ||
+		    !check_expr(m, m->compute[i].to_proc) ||
+		    !check_line(m, &m->compute[i].line))
+			return -1;
+	for (i = 0; i < hdr->ignore_count; i++)
+		if (!check_string(m, m->ignore[i].name) ||
+		    !check_line(m, &m->ignore[i].line))
+			return -1;
+	for (i = 0; i < hdr->virtual_count; i++)
+		if (!check_string(m, m->virt[i].name) ||
+		    !check_expr(m, m->virt[i].value) ||
+		    !check_line(m, &m->virt[i].line))
+			return -1;
+
+	for (i = 0; i < hdr->group_count; i++) {
+		if (!m->group[i].spec_count ||
+		    !check_string(m, m->group[i].name) ||
+		    !check_line(m, &m->group[i].line))
+			return -1;
+		specs += m->group[i].spec_count;
+	}
+	if (specs != hdr->group_spec_count)
+		return -1;
+	for (i = 0; i < hdr->group_spec_count; i++)
+		if (!check_string(m, m->spec[i].spec))
+			return -1;
+
+	return 0;
+}
+
+/* Copy count records into a new heap array, or return NULL if empty */
+static void *conf_cache_array(int count, size_t size)
+{
+	void *array;
+
+	if (!count)
+		return NULL;
+	array = malloc(count * size);
+	if (!array)
+		sensors_fatal_error(__func__, "Out of memory");
+	return array;
+}
+
+static sensors_config_line conf_cache_get_line(const char **files,
+					const struct conf_cache_line *l)
+{
+	sensors_config_line line;
+
+	line.filename = l->file < 0 ? NULL : files[l->file];
+	line.lineno = l->lineno;
+	return line;
+}
+
+static void conf_cache_populate(const struct conf_cache_map *m)
+{
+	const struct conf_cache_header *hdr = m->hdr;
+	const char *strings = m->strings;
+	const struct conf_cache_name *fits = m->fits;
+	const struct conf_cache_label *label = m->label;
+	const struct conf_cache_set *set = m->set;
+	const struct conf_cache_compute *compute = m->compute;
+	const struct conf_cache_ignore *ignore = m->ignore;
+	const struct conf_cache_spec *spec = m->spec;
+	const char **files;
+	sensors_expr *expr;
+	sensors_chip entry;
+	sensors_virtual virt;
+	sensors_group group;
+	uint32_t i;
+	int j;
+
+	files = conf_cache_array(hdr->file_count, sizeof(*files));
+	for (i = 0; i < hdr->file_count; i++) {
+		char *name = sensors_arena_strdup(&sensors_config_arena,
+						  strings + m->file[i].name);
+
+		sensors_add_config_files(&name);
+		files[i] = name;
+	}
+
+	expr = sensors_arena_calloc(&sensors_config_arena, hdr->expr_count,
+				    sizeof(sensors_expr));
+	for (i = 0; i < hdr->expr_count; i++) {
+		const struct conf_cache_expr *e = &m->expr[i];
+
+		expr[i].kind = e->kind;
+		switch (e->kind) {
+		case sensors_kind_val:
+			expr[i].data.val = e->val;
+			break;
+		case sensors_kind_var:
+			expr[i].data.var = sensors_intern_name(strings +
+							       e->var);
+			break;
+		case sensors_kind_aggr:
+			expr[i].data.aggr.op = e->op;
+			expr[i].data.aggr.spec =
+				sensors_arena_strdup(&sensors_config_arena,
+						     strings + e->var);
+			break;
+		case sensors_kind_sub:
+			expr[i].data.subexpr.op = e->op;
+			expr[i].data.subexpr.sub1 = &expr[e->sub1];
+			expr[i].data.subexpr.sub2 = e->sub2 < 0 ? NULL :
+						    &expr[e->sub2];
+			break;
+		default:
+			break;
+		}
+	}
+
+	for (i = 0; i < hdr->chip_count; i++) {
+		const struct conf_cache_chip *c = &m->chip[i];
+
+		memset(&entry, 0, sizeof(entry));
+		entry.suspended = c->suspended;
+		entry.line = conf_cache_get_line(files, &c->line);
+
+		entry.chips.fits = conf_cache_array(c->fits_count,
+						    sizeof(sensors_chip_name));
+		entry.chips.fits_count = entry.chips.fits_max = c->fits_count;
+		for (j = 0; j < entry.chips.fits_count; j++, fits++) {
+			sensors_chip_name *name = &entry.chips.fits[j];
+
+			name->prefix = fits->prefix == CONF_CACHE_NONE ? NULL :
+				       sensors_intern_name(strings +
+							   fits->prefix);
+			name->bus.type = fits->bus_type;
+			name->bus.nr = fits->bus_nr;
+			name->addr = fits->addr;
+			name->path = NULL;
+		}
+
+		entry.labels = conf_cache_array(c->label_count,
+						sizeof(sensors_label));
+		entry.labels_count = entry.labels_max = c->label_count;
+		for (j = 0; j < entry.labels_count; j++, label++) {
+			entry.labels[j].name =
+				sensors_intern_name(strings + label->name);
+			entry.labels[j].value =
+				sensors_arena_strdup(&sensors_config_arena,
+						     strings + label->value);
+			entry.labels[j].line = conf_cache_get_line(files,
+								&label->line);
+		}
+
+		entry.sets = conf_cache_array(c->set_count,
+					      sizeof(sensors_set));
+		entry.sets_count = entry.sets_max = c->set_count;
+		for (j = 0; j < entry.sets_count; j++, set++) {
+			entry.sets[j].name =
+				sensors_intern_name(strings + set->name);
+			entry.sets[j].value = &expr[set->value];
+			entry.sets[j].line = conf_cache_get_line(files,
+								 &set->line);
+		}
+
+		entry.computes = conf_cache_array(c->compute_count,
+						  sizeof(sensors_compute));
+		entry.computes_count = entry.computes_max = c->compute_count;
+		for (j = 0; j < entry.computes_count; j++, compute++) {
+			entry.computes[j].name =
+				sensors_intern_name(strings + compute->name);
+			entry.computes[j].from_proc =
+				&expr[compute->from_proc];
+			entry.computes[j].to_proc = &expr[compute->to_proc];
+			entry.computes[j].line = conf_cache_get_line(files,
+							&compute->line);
+		}
+
+		entry.ignores = conf_cache_array(c->ignore_count,
+						 sizeof(sensors_ignore));
+		entry.ignores_count = entry.ignores_max = c->ignore_count;
+		for (j = 0; j < entry.ignores_count; j++, ignore++) {
+			entry.ignores[j].name =
+				sensors_intern_name(strings + ignore->name);
+			entry.ignores[j].line = conf_cache_get_line(files,
+							&ignore->line);
+		}
+
+		sensors_add_config_chips(&entry);
+	}
+
+	for (i = 0; i < hdr->virtual_count; i++) {
+		virt.name = sensors_intern_name(strings + m->virt[i].name);
+		virt.value = &expr[m->virt[i].value];
+		virt.line = conf_cache_get_line(files, &m->virt[i].line);
+		sensors_add_config_virtuals(&virt);
+	}
+
+	for (i = 0; i < hdr->group_count; i++) {
+		const struct conf_cache_group *g = &m->group[i];
+
+		group.name = sensors_intern_name(strings + g->name);
+		group.line = conf_cache_get_line(files, &g->line);
+		group.specs = conf_cache_array(g->spec_count, sizeof(char *));
+		group.specs_count = group.specs_max = g->spec_count;
+		for (j = 0; j < group.specs_count; j++, spec++)
+			group.specs[j] =
+				sensors_arena_strdup(&sensors_config_arena,
+						     strings + spec->spec);
+		sensors_add_config_groups(&group);
+	}
+
+	/* Bus substitution was done before saving */
+	sensors_config_chips_subst = sensors_config_chips_count;
+	free(files);
+}
+
+int sensors_config_cache_load(const char *path, uint64_t fingerprint)
+{
+	struct conf_cache_map m;
+	const struct conf_cache_header *hdr;
+	const char *p;
+	size_t map_size;
+	uint64_t size;
+	void *map;
+	int err = -1;
+
+	map = sensors_cache_map(path, sizeof(struct conf_cache_header),
+				&map_size);
+	if (!map)
+		return -1;
+
+	hdr = map;
+	if (hdr->magic != CONF_CACHE_MAGIC ||
+	    hdr->version != CONF_CACHE_VERSION ||
+	    hdr->fingerprint != fingerprint)
+		goto exit_unmap;
+
+	size = sizeof(struct conf_cache_header) +
+	       (uint64_t)hdr->expr_count * sizeof(struct conf_cache_expr) +
+	       (uint64_t)hdr->file_count * sizeof(struct conf_cache_file) +
+	       (uint64_t)hdr->chip_count * sizeof(struct conf_cache_chip) +
+	       (uint64_t)hdr->fits_count * sizeof(struct conf_cache_name) +
+	       (uint64_t)hdr->label_count * sizeof(struct conf_cache_label) +
+	       (uint64_t)hdr->set_count * sizeof(struct conf_cache_set) +
+	       (uint64_t)hdr->compute_count *
+	       sizeof(struct conf_cache_compute) +
+	       (uint64_t)hdr->ignore_count * sizeof(struct conf_cache_ignore) +
+	       (uint64_t)hdr->virtual_count *
+	       sizeof(struct conf_cache_virtual) +
+	       (uint64_t)hdr->group_count * sizeof(struct conf_cache_group) +
+	       (uint64_t)hdr->group_spec_count *
+	       sizeof(struct conf_cache_spec) +
+	       hdr->strings_size;
+	if (size != (uint64_t)map_size || !hdr->strings_size)
+		goto exit_unmap;
+
+	m.hdr = hdr;
+	p = (const char *)(hdr + 1);
+	m.expr = (const struct conf_cache_expr *)p;
+	p += hdr->expr_count * sizeof(struct conf_cache_expr);
+	m.file = (const struct conf_cache_file *)p;
+	p += hdr->file_count * sizeof(struct conf_cache_file);
+	m.chip = (const struct conf_cache_chip *)p;
+	p += hdr->chip_count * sizeof(struct conf_cache_chip);
+	m.fits = (const struct conf_cache_name *)p;
+	p += hdr->fits_count * sizeof(struct conf_cache_name);
+	m.label = (const struct conf_cache_label *)p;
+	p += hdr->label_count * sizeof(struct conf_cache_label);
+	m.set = (const struct conf_cache_set *)p;
+	p += hdr->set_count * sizeof(struct conf_cache_set);
+	m.compute = (const struct conf_cache_compute *)p;
+	p += hdr->compute_count * sizeof(struct conf_cache_compute);
+	m.ignore = (const struct conf_cache_ignore *)p;
+	p += hdr->ignore_count * sizeof(struct conf_cache_ignore);
+	m.virt = (const struct conf_cache_virtual *)p;
+	p += hdr->virtual_count * sizeof(struct conf_cache_virtual);
+	m.group = (const struct conf_cache_group *)p;
+	p += hdr->group_count * sizeof(struct conf_cache_group);
+	m.spec = (const struct conf_cache_spec *)p;
+	p += hdr->group_spec_count * sizeof(struct conf_cache_spec);
+	m.strings = p;
+
+	/* All strings are terminated if the last one is */
+	if (m.strings[hdr->strings_size - 1] != '\0' || conf_cache_check(&m))
+		goto exit_unmap;
+
+	conf_cache_populate(&m);
+	err = 0;
+
+exit_unmap:
+	munmap(map, map_size);
+	return err;
+}
+
+/*
+ * Saving: the sizes are computed in a first pass, then the records are
+ * filled in a buffer of the right size.
+ */
+struct conf_cache_writer {
+	struct conf_cache_header hdr;
+	struct conf_cache_expr *expr;
+	char *strings;
+	uint64_t strings_max;
+};
+
+static void conf_cache_count_expr(struct conf_cache_writer *w,
+				  const sensors_expr *expr)
+{
+	w->hdr.expr_count++;
+	if (expr->kind == sensors_kind_var)
+		w->strings_max += strlen(expr->data.var) + 1;
+	else if (expr->kind == sensors_kind_aggr)
+		w->strings_max += strlen(expr->data.aggr.spec) + 1;
+	else if (expr->kind == sensors_kind_sub) {
+		conf_cache_count_expr(w, expr->data.subexpr.sub1);
+		if (expr->data.subexpr.sub2)
+			conf_cache_count_expr(w, expr->data.subexpr.sub2);
+	}
+}
+
+/* Append a string to the string area and return its offset */
+static uint32_t conf_cache_add_string(struct conf_cache_writer *w,
+				      const char *s)
+{
+	uint32_t offset = w->hdr.strings_size;
+	size_t len = strlen(s) + 1;
+
+	memcpy(w->strings + offset, s, len);
+	w->hdr.strings_size += len;
+	return offset;
+}
+
+/* Append an expression in post-order and return its index */
+static int32_t conf_cache_add_expr(struct conf_cache_writer *w,
+				   const sensors_expr *expr)
+{
+	struct conf_cache_expr e;
+
+	memset(&e, 0, sizeof(e));
+	e.kind = expr->kind;
+	e.sub1 = e.sub2 = -1;
+	switch (expr->kind) {
+	case sensors_kind_val:
+		e.val = expr->data.val;
+		break;
+	case sensors_kind_var:
+		e.var = conf_cache_add_string(w, expr->data.var);
+		break;
+	case sensors_kind_aggr:
+		e.op = expr->data.aggr.op;
+		e.var = conf_cache_add_string(w, expr->data.aggr.spec);
+		break;
+	case sensors_kind_sub:
+		e.op = expr->data.subexpr.op;
+		e.sub1 = conf_cache_add_expr(w, expr->data.subexpr.sub1);
+		if (expr->data.subexpr.sub2)
+			e.sub2 = conf_cache_add_expr(w,
+						     expr->data.subexpr.sub2);
+		break;
+	default:
+		break;
+	}
+
+	w->expr[w->hdr.expr_count] = e;
+	return w->hdr.expr_count++;
+}
+
+static struct conf_cache_line conf_cache_line(const sensors_config_line *line)
+{
+	struct conf_cache_line l;
+	int i;
+
+	l.file = -1;
+	l.lineno = line->lineno;
+	for (i = sensors_config_files_count - 1; i >= 0; i--) {
+		if (line->filename == sensors_config_files[i]) {
+			l.file = i;
+			break;
+		}
+	}
+	return l;
+}
+
+void sensors_config_cache_save(const char *path, uint64_t fingerprint)
+{
+	struct conf_cache_writer w;
+	struct conf_cache_file *file;
+	struct conf_cache_chip *chip;
+	struct conf_cache_name *fits;
+	struct conf_cache_label *label;
+	struct conf_cache_set *set;
+	struct conf_cache_compute *compute;
+	struct conf_cache_ignore *ignore;
+	struct conf_cache_virtual *virt;
+	struct conf_cache_group *group;
+	struct conf_cache_spec *spec;
+	char *buf;
+	size_t size;
+	int i, j;
+
+	memset(&w, 0, sizeof(w));
+	w.hdr.magic = CONF_CACHE_MAGIC;
+	w.hdr.version = CONF_CACHE_VERSION;
+	w.hdr.fingerprint = fingerprint;
+	w.hdr.file_count = sensors_config_files_count;
+	w.hdr.chip_count = sensors_config_chips_count;
+	w.hdr.virtual_count = sensors_config_virtuals_count;
+	w.hdr.group_count = sensors_config_groups_count;
+
+	for (i = 0; i < sensors_config_files_count; i++)
+		w.strings_max += strlen(sensors_config_files[i]) + 1;
+	for (i = 0; i < sensors_config_chips_count; i++) {
+		const sensors_chip *c = &sensors_config_chips[i];
+
+		for (j = 0; j < c->chips.fits_count; j++)
+			if (c->chips.fits[j].prefix)
+				w.strings_max +=
+					strlen(c->chips.fits[j].prefix) + 1;
+		for (j = 0; j < c->labels_count; j++)
+			w.strings_max += strlen(c->labels[j].name) + 1 +
+					 strlen(c->labels[j].value) + 1;
+		for (j = 0; j < c->sets_count; j++) {
+			w.strings_max += strlen(c->sets[j].name) + 1;
+			conf_cache_count_expr(&w, c->sets[j].value);
+		}
+		for (j = 0; j < c->computes_count; j++) {
+			w.strings_max += strlen(c->computes[j].name) + 1;
+			conf_cache_count_expr(&w, c->computes[j].from_proc);
+			conf_cache_count_expr(&w, c->computes[j].to_proc);
+		}
+		for (j = 0; j < c->ignores_count; j++)
+			w.strings_max += strlen(c->ignores[j].name) + 1;
+
+		w.hdr.fits_count += c->chips.fits_count;
+		w.hdr.label_count += c->labels_count;
+		w.hdr.set_count += c->sets_count;
+		w.hdr.compute_count += c->computes_count;
+		w.hdr.ignore_count += c->ignores_count;
+	}
+	for (i = 0; i < sensors_config_virtuals_count; i++) {
+		w.strings_max += strlen(sensors_config_virtuals[i].name) + 1;
+		conf_cache_count_expr(&w, sensors_config_virtuals[i].value);
+	}
+	for (i = 0; i < sensors_config_groups_count; i++) {
+		const sensors_group *g = &sensors_config_groups[i];
+
+		w.strings_max += strlen(g->name) + 1;
+		for (j = 0; j < g->specs_count; j++)
+			w.strings_max += strlen(g->specs[j]) + 1;
+		w.hdr.group_spec_count += g->specs_count;
+	}
+	/* An empty string area would be rejected by the loader */
+	if (!w.strings_max || w.strings_max > UINT32_MAX)
+		return;
+
+	size = sizeof(w.hdr) +
+	       w.hdr.expr_count * sizeof(struct conf_cache_expr) +
+	       w.hdr.file_count * sizeof(*file) +
+	       w.hdr.chip_count * sizeof(*chip) +
+	       w.hdr.fits_count * sizeof(*fits) +
+	       w.hdr.label_count * sizeof(*label) +
+	       w.hdr.set_count * sizeof(*set) +
+	       w.hdr.compute_count * sizeof(*compute) +
+	       w.hdr.ignore_count * sizeof(*ignore) +
+	       w.hdr.virtual_count * sizeof(*virt) +
+	       w.hdr.group_count * sizeof(*group) +
+	       w.hdr.group_spec_count * sizeof(*spec) + w.strings_max;
+	buf = calloc(1, size);
+	if (!buf)
+		return;
+
+	w.expr = (struct conf_cache_expr *)(buf + sizeof(w.hdr));
+	file = (struct conf_cache_file *)(w.expr + w.hdr.expr_count);
+	chip = (struct conf_cache_chip *)(file + w.hdr.file_count);
+	fits = (struct conf_cache_name *)(chip + w.hdr.chip_count);
+	label = (struct conf_cache_label *)(fits + w.hdr.fits_count);
+	set = (struct conf_cache_set *)(label + w.hdr.label_count);
+	compute = (struct conf_cache_compute *)(set + w.hdr.set_count);
+	ignore = (struct conf_cache_ignore *)(compute + w.hdr.compute_count);
+	virt = (struct conf_cache_virtual *)(ignore + w.hdr.ignore_count);
+	group = (struct conf_cache_group *)(virt + w.hdr.virtual_count);
+	spec = (struct conf_cache_spec *)(group + w.hdr.group_count);
+	w.strings = (char *)(spec + w.hdr.group_spec_count);
+
+	/* Recounted while filling */
+	w.hdr.expr_count = 0;
+
+	for (i = 0; i < sensors_config_files_count; i++)
+		file[i].name = conf_cache_add_string(&w,
+						     sensors_config_files[i]);
+
+	for (i = 0; i < sensors_config_chips_count; i++) {
+		const sensors_chip *c = &sensors_config_chips[i];
+
+		chip[i].fits_count = c->chips.fits_count;
+		chip[i].label_count = c->labels_count;
+		chip[i].set_count = c->sets_count;
+		chip[i].compute_count = c->computes_count;
+		chip[i].ignore_count = c->ignores_count;
+		chip[i].suspended = c->suspended;
+		chip[i].line = conf_cache_line(&c->line);
+
+		for (j = 0; j < c->chips.fits_count; j++, fits++) {
+			const sensors_chip_name *name = &c->chips.fits[j];
+
+			fits->prefix = name->prefix ?
+				       conf_cache_add_string(&w, name->prefix) :
+				       CONF_CACHE_NONE;
+			fits->bus_type = name->bus.type;
+			fits->bus_nr = name->bus.nr;
+			fits->addr = name->addr;
+		}
+		for (j = 0; j < c->labels_count; j++, label++) {
+			label->name = conf_cache_add_string(&w,
+							    c->labels[j].name);
+			label->value = conf_cache_add_string(&w,
+							c->labels[j].value);
+			label->line = conf_cache_line(&c->labels[j].line);
+		}
+		for (j = 0; j < c->sets_count; j++, set++) {
+			set->name = conf_cache_add_string(&w, c->sets[j].name);
+			set->value = conf_cache_add_expr(&w, c->sets[j].value);
+			set->line = conf_cache_line(&c->sets[j].line);
+		}
+		for (j = 0; j < c->computes_count; j++, compute++) {
+			compute->name = conf_cache_add_string(&w,
+							c->computes[j].name);
+			compute->from_proc = conf_cache_add_expr(&w,
+						c->computes[j].from_proc);
+			compute->to_proc = conf_cache_add_expr(&w,
+						c->computes[j].to_proc);
+			compute->line = conf_cache_line(&c->computes[j].line);
+		}
+		for (j = 0; j < c->ignores_count; j++, ignore++) {
+			ignore->name = conf_cache_add_string(&w,
+							c->ignores[j].name);
+			ignore->line = conf_cache_line(&c->ignores[j].line);
+		}
+	}
+
+	for (i = 0; i < sensors_config_virtuals_count; i++) {
+		const sensors_virtual *v = &sensors_config_virtuals[i];
+
+		virt[i].name = conf_cache_add_string(&w, v->name);
+		virt[i].value = conf_cache_add_expr(&w, v->value);
+		virt[i].line = conf_cache_line(&v->line);
+	}
+
+	for (i = 0; i < sensors_config_groups_count; i++) {
+		const sensors_group *g = &sensors_config_groups[i];
+
+		group[i].name = conf_cache_add_string(&w, g->name);
+		group[i].spec_count = g->specs_count;
+		group[i].line = conf_cache_line(&g->line);
+		for (j = 0; j < g->specs_count; j++, spec++)
+			spec->spec = conf_cache_add_string(&w, g->specs[j]);
+	}
+
+	memcpy(buf, &w.hdr, sizeof(w.hdr));
+	sensors_cache_write(path, buf, size);
+	free(buf);
+}
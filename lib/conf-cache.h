@@ -0,0 +1,47 @@
+/*
+    conf-cache.h - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#ifndef LIB_SENSORS_CONF_CACHE_H
+#define LIB_SENSORS_CONF_CACHE_H
+
+#include <stdint.h>
+
+/* Return the configuration cache file to use, or NULL if caching is
+   disabled */
+const char *sensors_config_cache_file(void);
+
+/* Start a fingerprint of the parsed configuration. It covers the library
+   version, the detected busses, which bus substitution depends on, and
+   the detected chips if chip blocks are skipped for absent chips. */
+uint64_t sensors_config_cache_fingerprint(void);
+
+/* Mix the identity (size, modification time, inode) of a configuration
+   file into the fingerprint. Missing files are accounted for too. */
+void sensors_config_cache_add_file(uint64_t *fingerprint, const char *path);
+
+/* Load the parsed configuration from the cache file. Returns 0 on success,
+   <0 if the cache is missing, invalid or out of date, in which case
+   nothing was loaded. */
+int sensors_config_cache_load(const char *path, uint64_t fingerprint);
+
+/* Save the parsed configuration to the cache file. Failures are silently
+   ignored, the cache is only an optimization. */
+void sensors_config_cache_save(const char *path, uint64_t fingerprint);
+
+#endif /* def LIB_SENSORS_CONF_CACHE_H */
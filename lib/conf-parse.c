@@ -0,0 +1,1868 @@
+/* A Bison parser, made by GNU Bison 3.8.2.  */
+
+/* Bison implementation for Yacc-like parsers in C
+
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
+
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
+
+/* C LALR(1) parser skeleton written by Richard Stallman, by
+   simplifying the original so-called "semantic" parser.  */
+
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+/* All symbols defined below should begin with yy or YY, to avoid
+   infringing on user name space.  This should be done even for local
+   variables, as they might otherwise be expanded by user macros.
+   There are some unavoidable exceptions within include files to
+   define necessary library symbols; they are noted "INFRINGES ON
+   USER NAME SPACE" below.  */
+
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
+
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
+
+/* Skeleton name.  */
+#define YYSKELETON_NAME "yacc.c"
+
+/* Pure parsers.  */
+#define YYPURE 1
+
+/* Push parsers.  */
+#define YYPUSH 0
+
+/* Pull parsers.  */
+#define YYPULL 1
+
+
+/* Substitute the variable and function names.  */
+#define yyparse         sensors_yyparse
+#define yylex           sensors_yylex
+#define yyerror         sensors_yyerror
+#define yydebug         sensors_yydebug
+#define yynerrs         sensors_yynerrs
+
+/* First part of user prologue.  */
+#line 1 "lib/conf-parse.y"
+
+/*
+    conf-parse.y - Part of libsensors, a Linux library for reading sensor data.
+    Copyright (c) 1998, 1999  Frodo Looijaard <frodol@dds.nl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#define YYERROR_VERBOSE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "data.h"
+#include "general.h"
+#include "error.h"
+#include "conf.h"
+#include "access.h"
+#include "virtual.h"
+
+static void sensors_yyerror(sensors_scanner *scanner, const char *err);
+static sensors_expr *malloc_expr(void);
+static int expr_uses(const sensors_expr *expr, sensors_expr_kind kind);
+
+/* The parser is reentrant, its state is in the scanner */
+#define current_chip (scanner->current_chip)
+#define current_chip_skipped (scanner->current_chip_skipped)
+
+#define bus_add_el(el) sensors_add_array_el(el,\
+                                      &sensors_config_busses,\
+                                      &sensors_config_busses_count,\
+                                      &sensors_config_busses_max,\
+                                      sizeof(sensors_bus))
+#define label_add_el(el) sensors_add_array_el(el,\
+                                        &current_chip->labels,\
+                                        &current_chip->labels_count,\
+                                        &current_chip->labels_max,\
+                                        sizeof(sensors_label));
+#define set_add_el(el) sensors_add_array_el(el,\
+                                      &current_chip->sets,\
+                                      &current_chip->sets_count,\
+                                      &current_chip->sets_max,\
+                                      sizeof(sensors_set));
+#define compute_add_el(el) sensors_add_array_el(el,\
+                                          &current_chip->computes,\
+                                          &current_chip->computes_count,\
+                                          &current_chip->computes_max,\
+                                          sizeof(sensors_compute));
+#define ignore_add_el(el) sensors_add_array_el(el,\
+                                          &current_chip->ignores,\
+                                          &current_chip->ignores_count,\
+                                          &current_chip->ignores_max,\
+                                          sizeof(sensors_ignore));
+#define virtual_add_el(el) sensors_add_array_el(el,\
+                                          &sensors_config_virtuals,\
+                                          &sensors_config_virtuals_count,\
+                                          &sensors_config_virtuals_max,\
+                                          sizeof(sensors_virtual));
+#define group_add_el(el) sensors_add_array_el(el,\
+                                        &sensors_config_groups,\
+                                        &sensors_config_groups_count,\
+                                        &sensors_config_groups_max,\
+                                        sizeof(sensors_group));
+#define chip_add_el(el) sensors_add_array_el(el,\
+                                       &sensors_config_chips,\
+                                       &sensors_config_chips_count,\
+                                       &sensors_config_chips_max,\
+                                       sizeof(sensors_chip));
+
+#define fits_add_el(el,list) sensors_add_array_el(el,\
+                                                  &(list).fits,\
+                                                  &(list).fits_count,\
+                                                  &(list).fits_max, \
+		                                  sizeof(sensors_chip_name));
+
+#define spec_add_el(el,group) sensors_add_array_el(el,\
+                                                   &(group).specs,\
+                                                   &(group).specs_count,\
+                                                   &(group).specs_max, \
+		                                   sizeof(char *));
+
+
+#line 173 "lib/conf-parse.c"
+
+# ifndef YY_CAST
+#  ifdef __cplusplus
+#   define YY_CAST(Type, Val) static_cast<Type> (Val)
+#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
+#  else
+#   define YY_CAST(Type, Val) ((Type) (Val))
+#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
+#  endif
+# endif
+# ifndef YY_NULLPTR
+#  if defined __cplusplus
+#   if 201103L <= __cplusplus
+#    define YY_NULLPTR nullptr
+#   else
+#    define YY_NULLPTR 0
+#   endif
+#  else
+#   define YY_NULLPTR ((void*)0)
+#  endif
+# endif
+
+#include "conf-parse.h"
+/* Symbol kind.  */
+enum yysymbol_kind_t
+{
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_3_ = 3,                         /* '-'  */
+  YYSYMBOL_4_ = 4,                         /* '+'  */
+  YYSYMBOL_5_ = 5,                         /* '*'  */
+  YYSYMBOL_6_ = 6,                         /* '/'  */
+  YYSYMBOL_NEG = 7,                        /* NEG  */
+  YYSYMBOL_8_ = 8,                         /* '^'  */
+  YYSYMBOL_9_ = 9,                         /* '`'  */
+  YYSYMBOL_10_ = 10,                       /* ','  */
+  YYSYMBOL_EOL = 11,                       /* EOL  */
+  YYSYMBOL_BUS = 12,                       /* BUS  */
+  YYSYMBOL_LABEL = 13,                     /* LABEL  */
+  YYSYMBOL_SET = 14,                       /* SET  */
+  YYSYMBOL_CHIP = 15,                      /* CHIP  */
+  YYSYMBOL_COMPUTE = 16,                   /* COMPUTE  */
+  YYSYMBOL_IGNORE = 17,                    /* IGNORE  */
+  YYSYMBOL_SUSPENDED = 18,                 /* SUSPENDED  */
+  YYSYMBOL_VIRTUAL = 19,                   /* VIRTUAL  */
+  YYSYMBOL_GROUP = 20,                     /* GROUP  */
+  YYSYMBOL_FLOAT = 21,                     /* FLOAT  */
+  YYSYMBOL_NAME = 22,                      /* NAME  */
+  YYSYMBOL_ERROR = 23,                     /* ERROR  */
+  YYSYMBOL_24_ = 24,                       /* '@'  */
+  YYSYMBOL_25_ = 25,                       /* '('  */
+  YYSYMBOL_26_ = 26,                       /* ')'  */
+  YYSYMBOL_YYACCEPT = 27,                  /* $accept  */
+  YYSYMBOL_input = 28,                     /* input  */
+  YYSYMBOL_line = 29,                      /* line  */
+  YYSYMBOL_bus_statement = 30,             /* bus_statement  */
+  YYSYMBOL_label_statement = 31,           /* label_statement  */
+  YYSYMBOL_set_statement = 32,             /* set_statement  */
+  YYSYMBOL_compute_statement = 33,         /* compute_statement  */
+  YYSYMBOL_ignore_statement = 34,          /* ignore_statement  */
+  YYSYMBOL_suspended_statement = 35,       /* suspended_statement  */
+  YYSYMBOL_virtual_statement = 36,         /* virtual_statement  */
+  YYSYMBOL_group_statement = 37,           /* group_statement  */
+  YYSYMBOL_chip_statement = 38,            /* chip_statement  */
+  YYSYMBOL_chip_name_list = 39,            /* chip_name_list  */
+  YYSYMBOL_expression = 40,                /* expression  */
+  YYSYMBOL_bus_id = 41,                    /* bus_id  */
+  YYSYMBOL_adapter_name = 42,              /* adapter_name  */
+  YYSYMBOL_function_name = 43,             /* function_name  */
+  YYSYMBOL_string = 44,                    /* string  */
+  YYSYMBOL_selector_list = 45,             /* selector_list  */
+  YYSYMBOL_selector = 46,                  /* selector  */
+  YYSYMBOL_chip_name = 47                  /* chip_name  */
+};
+typedef enum yysymbol_kind_t yysymbol_kind_t;
+
+
+
+
+#ifdef short
+# undef short
+#endif
+
+/* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
+   <limits.h> and (if available) <stdint.h> are included
+   so that the code can choose integer types of a good width.  */
+
+#ifndef __PTRDIFF_MAX__
+# include <limits.h> /* INFRINGES ON USER NAME SPACE */
+# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
+#  define YY_STDINT_H
+# endif
+#endif
+
+/* Narrow types that promote to a signed type and that can represent a
+   signed or unsigned integer of at least N bits.  In tables they can
+   save space and decrease cache pressure.  Promoting to a signed type
+   helps avoid bugs in integer arithmetic.  */
+
+#ifdef __INT_LEAST8_MAX__
+typedef __INT_LEAST8_TYPE__ yytype_int8;
+#elif defined YY_STDINT_H
+typedef int_least8_t yytype_int8;
+#else
+typedef signed char yytype_int8;
+#endif
+
+#ifdef __INT_LEAST16_MAX__
+typedef __INT_LEAST16_TYPE__ yytype_int16;
+#elif defined YY_STDINT_H
+typedef int_least16_t yytype_int16;
+#else
+typedef short yytype_int16;
+#endif
+
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
+#endif
+
+#if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST8_TYPE__ yytype_uint8;
+#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST8_MAX <= INT_MAX)
+typedef uint_least8_t yytype_uint8;
+#elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
+typedef unsigned char yytype_uint8;
+#else
+typedef short yytype_uint8;
+#endif
+
+#if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST16_TYPE__ yytype_uint16;
+#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST16_MAX <= INT_MAX)
+typedef uint_least16_t yytype_uint16;
+#elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
+typedef unsigned short yytype_uint16;
+#else
+typedef int yytype_uint16;
+#endif
+
+#ifndef YYPTRDIFF_T
+# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
+#  define YYPTRDIFF_T __PTRDIFF_TYPE__
+#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
+# elif defined PTRDIFF_MAX
+#  ifndef ptrdiff_t
+#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  endif
+#  define YYPTRDIFF_T ptrdiff_t
+#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
+# else
+#  define YYPTRDIFF_T long
+#  define YYPTRDIFF_MAXIMUM LONG_MAX
+# endif
+#endif
+
+#ifndef YYSIZE_T
+# ifdef __SIZE_TYPE__
+#  define YYSIZE_T __SIZE_TYPE__
+# elif defined size_t
+#  define YYSIZE_T size_t
+# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYSIZE_T size_t
+# else
+#  define YYSIZE_T unsigned
+# endif
+#endif
+
+#define YYSIZE_MAXIMUM                                  \
+  YY_CAST (YYPTRDIFF_T,                                 \
+           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
+            ? YYPTRDIFF_MAXIMUM                         \
+            : YY_CAST (YYSIZE_T, -1)))
+
+#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
+
+
+/* Stored state numbers (used for stacks). */
+typedef yytype_int8 yy_state_t;
+
+/* State numbers in computations.  */
+typedef int yy_state_fast_t;
+
+#ifndef YY_
+# if defined YYENABLE_NLS && YYENABLE_NLS
+#  if ENABLE_NLS
+#   include <libintl.h> /* INFRINGES ON USER NAME SPACE */
+#   define YY_(Msgid) dgettext ("bison-runtime", Msgid)
+#  endif
+# endif
+# ifndef YY_
+#  define YY_(Msgid) Msgid
+# endif
+#endif
+
+
+#ifndef YY_ATTRIBUTE_PURE
+# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
+# else
+#  define YY_ATTRIBUTE_PURE
+# endif
+#endif
+
+#ifndef YY_ATTRIBUTE_UNUSED
+# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
+# else
+#  define YY_ATTRIBUTE_UNUSED
+# endif
+#endif
+
+/* Suppress unused-variable warnings by "using" E.  */
+#if ! defined lint || defined __GNUC__
+# define YY_USE(E) ((void) (E))
+#else
+# define YY_USE(E) /* empty */
+#endif
+
+/* Suppress an incorrect diagnostic about yylval being uninitialized.  */
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
+    _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+# endif
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
+    _Pragma ("GCC diagnostic pop")
+#else
+# define YY_INITIAL_VALUE(Value) Value
+#endif
+#ifndef YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END
+#endif
+#ifndef YY_INITIAL_VALUE
+# define YY_INITIAL_VALUE(Value) /* Nothing. */
+#endif
+
+#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
+# define YY_IGNORE_USELESS_CAST_BEGIN                          \
+    _Pragma ("GCC diagnostic push")                            \
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+# define YY_IGNORE_USELESS_CAST_END            \
+    _Pragma ("GCC diagnostic pop")
+#endif
+#ifndef YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_END
+#endif
+
+
+#define YY_ASSERT(E) ((void) (0 && (E)))
+
+#if !defined yyoverflow
+
+/* The parser invokes alloca or malloc; define the necessary symbols.  */
+
+# ifdef YYSTACK_USE_ALLOCA
+#  if YYSTACK_USE_ALLOCA
+#   ifdef __GNUC__
+#    define YYSTACK_ALLOC __builtin_alloca
+#   elif defined __BUILTIN_VA_ARG_INCR
+#    include <alloca.h> /* INFRINGES ON USER NAME SPACE */
+#   elif defined _AIX
+#    define YYSTACK_ALLOC __alloca
+#   elif defined _MSC_VER
+#    include <malloc.h> /* INFRINGES ON USER NAME SPACE */
+#    define alloca _alloca
+#   else
+#    define YYSTACK_ALLOC alloca
+#    if ! defined _ALLOCA_H && ! defined EXIT_SUCCESS
+#     include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+      /* Use EXIT_SUCCESS as a witness for stdlib.h.  */
+#     ifndef EXIT_SUCCESS
+#      define EXIT_SUCCESS 0
+#     endif
+#    endif
+#   endif
+#  endif
+# endif
+
+# ifdef YYSTACK_ALLOC
+   /* Pacify GCC's 'empty if-body' warning.  */
+#  define YYSTACK_FREE(Ptr) do { /* empty */; } while (0)
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+    /* The OS might guarantee only one guard page at the bottom of the stack,
+       and a page size can be as small as 4096 bytes.  So we cannot safely
+       invoke alloca (N) if N exceeds 4096.  Use a slightly smaller number
+       to allow for a few compiler-allocated temporary stack slots.  */
+#   define YYSTACK_ALLOC_MAXIMUM 4032 /* reasonable circa 2006 */
+#  endif
+# else
+#  define YYSTACK_ALLOC YYMALLOC
+#  define YYSTACK_FREE YYFREE
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+#   define YYSTACK_ALLOC_MAXIMUM YYSIZE_MAXIMUM
+#  endif
+#  if (defined __cplusplus && ! defined EXIT_SUCCESS \
+       && ! ((defined YYMALLOC || defined malloc) \
+             && (defined YYFREE || defined free)))
+#   include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+#   ifndef EXIT_SUCCESS
+#    define EXIT_SUCCESS 0
+#   endif
+#  endif
+#  ifndef YYMALLOC
+#   define YYMALLOC malloc
+#   if ! defined malloc && ! defined EXIT_SUCCESS
+void *malloc (YYSIZE_T); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+#  ifndef YYFREE
+#   define YYFREE free
+#   if ! defined free && ! defined EXIT_SUCCESS
+void free (void *); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+# endif
+#endif /* !defined yyoverflow */
+
+#if (! defined yyoverflow \
+     && (! defined __cplusplus \
+         || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
+
+/* A type that is properly aligned for any stack member.  */
+union yyalloc
+{
+  yy_state_t yyss_alloc;
+  YYSTYPE yyvs_alloc;
+};
+
+/* The size of the maximum gap between one aligned stack and the next.  */
+# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
+
+/* The size of an array large to enough to hold all stacks, each with
+   N elements.  */
+# define YYSTACK_BYTES(N) \
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
+      + YYSTACK_GAP_MAXIMUM)
+
+# define YYCOPY_NEEDED 1
+
+/* Relocate STACK from its old location to the new one.  The
+   local variables YYSIZE and YYSTACKSIZE give the old and new number of
+   elements in the stack, and YYPTR gives the new location of the
+   stack.  Advance YYPTR to a properly aligned location for the next
+   stack.  */
+# define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
+    do                                                                  \
+      {                                                                 \
+        YYPTRDIFF_T yynewbytes;                                         \
+        YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
+        Stack = &yyptr->Stack_alloc;                                    \
+        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
+        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
+      }                                                                 \
+    while (0)
+
+#endif
+
+#if defined YYCOPY_NEEDED && YYCOPY_NEEDED
+/* Copy COUNT objects from SRC to DST.  The source and destination do
+   not overlap.  */
+# ifndef YYCOPY
+#  if defined __GNUC__ && 1 < __GNUC__
+#   define YYCOPY(Dst, Src, Count) \
+      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
+#  else
+#   define YYCOPY(Dst, Src, Count)              \
+      do                                        \
+        {                                       \
+          YYPTRDIFF_T yyi;                      \
+          for (yyi = 0; yyi < (Count); yyi++)   \
+            (Dst)[yyi] = (Src)[yyi];            \
+        }                                       \
+      while (0)
+#  endif
+# endif
+#endif /* !YYCOPY_NEEDED */
+
+/* YYFINAL -- State number of the termination state.  */
+#define YYFINAL  2
+/* YYLAST -- Last index in YYTABLE.  */
+#define YYLAST   71
+
+/* YYNTOKENS -- Number of terminals.  */
+#define YYNTOKENS  27
+/* YYNNTS -- Number of nonterminals.  */
+#define YYNNTS  21
+/* YYNRULES -- Number of rules.  */
+#define YYNRULES  44
+/* YYNSTATES -- Number of states.  */
+#define YYNSTATES  83
+
+/* YYMAXUTOK -- Last valid token kind.  */
+#define YYMAXUTOK   271
+
+
+/* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex, with out-of-bounds checking.  */
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
+
+/* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex.  */
+static const yytype_int8 yytranslate[] =
+{
+       0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+      25,    26,     5,     4,    10,     3,     2,     6,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,    24,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     8,     2,     9,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     1,     2,     7,    11,
+      12,    13,    14,    15,    16,    17,    18,    19,    20,    21,
+      22,    23
+};
+
+#if YYDEBUG
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+static const yytype_int16 yyrline[] =
+{
+       0,   148,   148,   149,   152,   153,   154,   155,   156,   157,
+     158,   159,   160,   161,   164,   173,   188,   207,   228,   242,
+     261,   278,   285,   312,   318,   324,   329,   334,   338,   355,
+     362,   369,   376,   383,   390,   392,   399,   408,   417,   421,
+     425,   429,   435,   441,   452
+};
+#endif
+
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
+
+#if YYDEBUG || 0
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
+
+/* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
+   First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
+static const char *const yytname[] =
+{
+  "\"end of file\"", "error", "\"invalid token\"", "'-'", "'+'", "'*'",
+  "'/'", "NEG", "'^'", "'`'", "','", "EOL", "BUS", "LABEL", "SET", "CHIP",
+  "COMPUTE", "IGNORE", "SUSPENDED", "VIRTUAL", "GROUP", "FLOAT", "NAME",
+  "ERROR", "'@'", "'('", "')'", "$accept", "input", "line",
+  "bus_statement", "label_statement", "set_statement", "compute_statement",
+  "ignore_statement", "suspended_statement", "virtual_statement",
+  "group_statement", "chip_statement", "chip_name_list", "expression",
+  "bus_id", "adapter_name", "function_name", "string", "selector_list",
+  "selector", "chip_name", YY_NULLPTR
+};
+
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
+{
+  return yytname[yysymbol];
+}
+#endif
+
+#define YYPACT_NINF (-55)
+
+#define yypact_value_is_default(Yyn) \
+  ((Yyn) == YYPACT_NINF)
+
+#define YYTABLE_NINF (-1)
+
+#define yytable_value_is_error(Yyn) \
+  0
+
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
+static const yytype_int8 yypact[] =
+{
+     -55,    33,   -55,    -2,   -11,   -10,   -10,    -8,   -10,   -10,
+      -5,   -10,   -10,   -55,    10,    11,    12,    14,    15,    19,
+      24,    25,    31,   -55,   -55,    21,   -55,    22,     7,   -55,
+      -8,   -55,     7,   -55,   -55,     7,    36,   -55,   -55,   -55,
+     -55,   -55,   -55,   -55,   -55,   -55,   -55,   -55,   -55,   -55,
+       7,     7,     7,   -55,    34,   -55,     7,    64,   -55,    51,
+      64,   -55,    36,   -55,   -55,   -55,   -55,    36,     1,     7,
+       7,     7,     7,     7,   -55,    38,   -55,    -4,    -4,   -55,
+     -55,    64,   -55
+};
+
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
+static const yytype_int8 yydefact[] =
+{
+       2,     0,     1,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     3,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,    13,    37,     0,    39,     0,     0,    44,
+      22,    23,     0,    18,    19,     0,     0,     4,     5,     6,
+       8,     9,    10,    11,    12,     7,    38,    14,    40,    15,
+       0,     0,     0,    25,    26,    27,     0,    16,    24,     0,
+      20,    43,    21,    41,    33,    35,    36,     0,     0,     0,
+       0,     0,     0,     0,    42,     0,    34,    30,    29,    31,
+      32,    17,    28
+};
+
+/* YYPGOTO[NTERM-NUM].  */
+static const yytype_int8 yypgoto[] =
+{
+     -55,   -55,   -55,   -55,   -55,   -55,   -55,   -55,   -55,   -55,
+     -55,   -55,   -55,   -32,   -55,   -55,    54,   -55,   -55,   -54,
+      41
+};
+
+/* YYDEFGOTO[NTERM-NUM].  */
+static const yytype_int8 yydefgoto[] =
+{
+       0,     1,    13,    14,    15,    16,    17,    18,    19,    20,
+      21,    22,    30,    57,    25,    47,    27,    49,    62,    63,
+      31
+};
+
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
+static const yytype_int8 yytable[] =
+{
+      59,    71,    72,    60,    69,    70,    71,    72,    74,    23,
+      50,    24,    26,    75,    29,    51,    52,    34,    64,    65,
+      66,    37,    38,    39,    68,    40,    41,    76,    53,    54,
+      42,    55,    56,     2,     3,    43,    44,    77,    78,    79,
+      80,    81,    45,    46,    48,     4,     5,     6,     7,     8,
+       9,    10,    11,    12,    69,    70,    71,    72,    61,    67,
+      28,    73,    32,    33,    82,    35,    36,    69,    70,    71,
+      72,    58
+};
+
+static const yytype_int8 yycheck[] =
+{
+      32,     5,     6,    35,     3,     4,     5,     6,    62,    11,
+       3,    22,    22,    67,    22,     8,     9,    22,    50,    51,
+      52,    11,    11,    11,    56,    11,    11,    26,    21,    22,
+      11,    24,    25,     0,     1,    11,    11,    69,    70,    71,
+      72,    73,    11,    22,    22,    12,    13,    14,    15,    16,
+      17,    18,    19,    20,     3,     4,     5,     6,    22,    25,
+       6,    10,     8,     9,    26,    11,    12,     3,     4,     5,
+       6,    30
+};
+
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
+static const yytype_int8 yystos[] =
+{
+       0,    28,     0,     1,    12,    13,    14,    15,    16,    17,
+      18,    19,    20,    29,    30,    31,    32,    33,    34,    35,
+      36,    37,    38,    11,    22,    41,    22,    43,    43,    22,
+      39,    47,    43,    43,    22,    43,    43,    11,    11,    11,
+      11,    11,    11,    11,    11,    11,    22,    42,    22,    44,
+       3,     8,     9,    21,    22,    24,    25,    40,    47,    40,
+      40,    22,    45,    46,    40,    40,    40,    25,    40,     3,
+       4,     5,     6,    10,    46,    46,    26,    40,    40,    40,
+      40,    40,    26
+};
+
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr1[] =
+{
+       0,    27,    28,    28,    29,    29,    29,    29,    29,    29,
+      29,    29,    29,    29,    30,    31,    32,    33,    34,    35,
+      36,    37,    38,    39,    39,    40,    40,    40,    40,    40,
+      40,    40,    40,    40,    40,    40,    40,    41,    42,    43,
+      44,    45,    45,    46,    47
+};
+
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr2[] =
+{
+       0,     2,     0,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     3,     3,     3,     5,     2,     2,
+       3,     3,     2,     1,     2,     1,     1,     1,     4,     3,
+       3,     3,     3,     2,     3,     2,     2,     1,     1,     1,
+       1,     1,     2,     1,     1
+};
+
+
+enum { YYENOMEM = -2 };
+
+#define yyerrok         (yyerrstatus = 0)
+#define yyclearin       (yychar = YYEMPTY)
+
+#define YYACCEPT        goto yyacceptlab
+#define YYABORT         goto yyabortlab
+#define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
+
+
+#define YYRECOVERING()  (!!yyerrstatus)
+
+#define YYBACKUP(Token, Value)                                    \
+  do                                                              \
+    if (yychar == YYEMPTY)                                        \
+      {                                                           \
+        yychar = (Token);                                         \
+        yylval = (Value);                                         \
+        YYPOPSTACK (yylen);                                       \
+        yystate = *yyssp;                                         \
+        goto yybackup;                                            \
+      }                                                           \
+    else                                                          \
+      {                                                           \
+        yyerror (scanner, YY_("syntax error: cannot back up")); \
+        YYERROR;                                                  \
+      }                                                           \
+  while (0)
+
+/* Backward compatibility with an undocumented macro.
+   Use YYerror or YYUNDEF. */
+#define YYERRCODE YYUNDEF
+
+
+/* Enable debugging if requested.  */
+#if YYDEBUG
+
+# ifndef YYFPRINTF
+#  include <stdio.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYFPRINTF fprintf
+# endif
+
+# define YYDPRINTF(Args)                        \
+do {                                            \
+  if (yydebug)                                  \
+    YYFPRINTF Args;                             \
+} while (0)
+
+
+
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
+do {                                                                      \
+  if (yydebug)                                                            \
+    {                                                                     \
+      YYFPRINTF (stderr, "%s ", Title);                                   \
+      yy_symbol_print (stderr,                                            \
+                  Kind, Value, scanner); \
+      YYFPRINTF (stderr, "\n");                                           \
+    }                                                                     \
+} while (0)
+
+
+/*-----------------------------------.
+| Print this symbol's value on YYO.  |
+`-----------------------------------*/
+
+static void
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, sensors_scanner *scanner)
+{
+  FILE *yyoutput = yyo;
+  YY_USE (yyoutput);
+  YY_USE (scanner);
+  if (!yyvaluep)
+    return;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+/*---------------------------.
+| Print this symbol on YYO.  |
+`---------------------------*/
+
+static void
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, sensors_scanner *scanner)
+{
+  YYFPRINTF (yyo, "%s %s (",
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
+
+  yy_symbol_value_print (yyo, yykind, yyvaluep, scanner);
+  YYFPRINTF (yyo, ")");
+}
+
+/*------------------------------------------------------------------.
+| yy_stack_print -- Print the state stack from its BOTTOM up to its |
+| TOP (included).                                                   |
+`------------------------------------------------------------------*/
+
+static void
+yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
+{
+  YYFPRINTF (stderr, "Stack now");
+  for (; yybottom <= yytop; yybottom++)
+    {
+      int yybot = *yybottom;
+      YYFPRINTF (stderr, " %d", yybot);
+    }
+  YYFPRINTF (stderr, "\n");
+}
+
+# define YY_STACK_PRINT(Bottom, Top)                            \
+do {                                                            \
+  if (yydebug)                                                  \
+    yy_stack_print ((Bottom), (Top));                           \
+} while (0)
+
+
+/*------------------------------------------------.
+| Report that the YYRULE is going to be reduced.  |
+`------------------------------------------------*/
+
+static void
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule, sensors_scanner *scanner)
+{
+  int yylno = yyrline[yyrule];
+  int yynrhs = yyr2[yyrule];
+  int yyi;
+  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
+             yyrule - 1, yylno);
+  /* The symbols being reduced.  */
+  for (yyi = 0; yyi < yynrhs; yyi++)
+    {
+      YYFPRINTF (stderr, "   $%d = ", yyi + 1);
+      yy_symbol_print (stderr,
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)], scanner);
+      YYFPRINTF (stderr, "\n");
+    }
+}
+
+# define YY_REDUCE_PRINT(Rule)          \
+do {                                    \
+  if (yydebug)                          \
+    yy_reduce_print (yyssp, yyvsp, Rule, scanner); \
+} while (0)
+
+/* Nonzero means print parse trace.  It is left uninitialized so that
+   multiple parsers can coexist.  */
+int yydebug;
+#else /* !YYDEBUG */
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
+# define YY_STACK_PRINT(Bottom, Top)
+# define YY_REDUCE_PRINT(Rule)
+#endif /* !YYDEBUG */
+
+
+/* YYINITDEPTH -- initial size of the parser's stacks.  */
+#ifndef YYINITDEPTH
+# define YYINITDEPTH 200
+#endif
+
+/* YYMAXDEPTH -- maximum size the stacks can grow to (effective only
+   if the built-in stack extension method is used).
+
+   Do not make this value too large; the results are undefined if
+   YYSTACK_ALLOC_MAXIMUM < YYSTACK_BYTES (YYMAXDEPTH)
+   evaluated with infinite-precision integer arithmetic.  */
+
+#ifndef YYMAXDEPTH
+# define YYMAXDEPTH 10000
+#endif
+
+
+
+
+
+
+/*-----------------------------------------------.
+| Release the memory associated to this symbol.  |
+`-----------------------------------------------*/
+
+static void
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep, sensors_scanner *scanner)
+{
+  YY_USE (yyvaluep);
+  YY_USE (scanner);
+  if (!yymsg)
+    yymsg = "Deleting";
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+
+
+
+
+/*----------.
+| yyparse.  |
+`----------*/
+
+int
+yyparse (sensors_scanner *scanner)
+{
+/* Lookahead token kind.  */
+int yychar;
+
+
+/* The semantic value of the lookahead symbol.  */
+/* Default value used for initialization, for pacifying older GCCs
+   or non-GCC compilers.  */
+YY_INITIAL_VALUE (static YYSTYPE yyval_default;)
+YYSTYPE yylval YY_INITIAL_VALUE (= yyval_default);
+
+    /* Number of syntax errors so far.  */
+    int yynerrs = 0;
+
+    yy_state_fast_t yystate = 0;
+    /* Number of tokens to shift before error messages enabled.  */
+    int yyerrstatus = 0;
+
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
+       to reallocate them elsewhere.  */
+
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize = YYINITDEPTH;
+
+    /* The state stack: array, bottom, top.  */
+    yy_state_t yyssa[YYINITDEPTH];
+    yy_state_t *yyss = yyssa;
+    yy_state_t *yyssp = yyss;
+
+    /* The semantic value stack: array, bottom, top.  */
+    YYSTYPE yyvsa[YYINITDEPTH];
+    YYSTYPE *yyvs = yyvsa;
+    YYSTYPE *yyvsp = yyvs;
+
+  int yyn;
+  /* The return value of yyparse.  */
+  int yyresult;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
+  /* The variables used to return semantic value and location from the
+     action routines.  */
+  YYSTYPE yyval;
+
+
+
+#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
+
+  /* The number of symbols on the RHS of the reduced rule.
+     Keep to zero when no symbol should be popped.  */
+  int yylen = 0;
+
+  YYDPRINTF ((stderr, "Starting parse\n"));
+
+  yychar = YYEMPTY; /* Cause a token to be read.  */
+
+  goto yysetstate;
+
+
+/*------------------------------------------------------------.
+| yynewstate -- push a new state, which is found in yystate.  |
+`------------------------------------------------------------*/
+yynewstate:
+  /* In all cases, when you get here, the value and location stacks
+     have just been pushed.  So pushing a state here evens the stacks.  */
+  yyssp++;
+
+
+/*--------------------------------------------------------------------.
+| yysetstate -- set current state (the top of the stack) to yystate.  |
+`--------------------------------------------------------------------*/
+yysetstate:
+  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+  YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
+  YY_IGNORE_USELESS_CAST_BEGIN
+  *yyssp = YY_CAST (yy_state_t, yystate);
+  YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
+
+  if (yyss + yystacksize - 1 <= yyssp)
+#if !defined yyoverflow && !defined YYSTACK_RELOCATE
+    YYNOMEM;
+#else
+    {
+      /* Get the current used size of the three stacks, in elements.  */
+      YYPTRDIFF_T yysize = yyssp - yyss + 1;
+
+# if defined yyoverflow
+      {
+        /* Give user a chance to reallocate the stack.  Use copies of
+           these so that the &'s don't force the real ones into
+           memory.  */
+        yy_state_t *yyss1 = yyss;
+        YYSTYPE *yyvs1 = yyvs;
+
+        /* Each stack pointer address is followed by the size of the
+           data in use in that stack, in bytes.  This used to be a
+           conditional around just the two extra args, but that might
+           be undefined if yyoverflow is a macro.  */
+        yyoverflow (YY_("memory exhausted"),
+                    &yyss1, yysize * YYSIZEOF (*yyssp),
+                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
+                    &yystacksize);
+        yyss = yyss1;
+        yyvs = yyvs1;
+      }
+# else /* defined YYSTACK_RELOCATE */
+      /* Extend the stack our own way.  */
+      if (YYMAXDEPTH <= yystacksize)
+        YYNOMEM;
+      yystacksize *= 2;
+      if (YYMAXDEPTH < yystacksize)
+        yystacksize = YYMAXDEPTH;
+
+      {
+        yy_state_t *yyss1 = yyss;
+        union yyalloc *yyptr =
+          YY_CAST (union yyalloc *,
+                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
+        if (! yyptr)
+          YYNOMEM;
+        YYSTACK_RELOCATE (yyss_alloc, yyss);
+        YYSTACK_RELOCATE (yyvs_alloc, yyvs);
+#  undef YYSTACK_RELOCATE
+        if (yyss1 != yyssa)
+          YYSTACK_FREE (yyss1);
+      }
+# endif
+
+      yyssp = yyss + yysize - 1;
+      yyvsp = yyvs + yysize - 1;
+
+      YY_IGNORE_USELESS_CAST_BEGIN
+      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
+                  YY_CAST (long, yystacksize)));
+      YY_IGNORE_USELESS_CAST_END
+
+      if (yyss + yystacksize - 1 <= yyssp)
+        YYABORT;
+    }
+#endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
+
+
+  if (yystate == YYFINAL)
+    YYACCEPT;
+
+  goto yybackup;
+
+
+/*-----------.
+| yybackup.  |
+`-----------*/
+yybackup:
+  /* Do appropriate processing given the current state.  Read a
+     lookahead token if we need one and don't already have one.  */
+
+  /* First try to decide what to do without reference to lookahead token.  */
+  yyn = yypact[yystate];
+  if (yypact_value_is_default (yyn))
+    goto yydefault;
+
+  /* Not known => get a lookahead token if don't already have one.  */
+
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
+  if (yychar == YYEMPTY)
+    {
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yylex (&yylval, scanner);
+    }
+
+  if (yychar <= YYEOF)
+    {
+      yychar = YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
+      YYDPRINTF ((stderr, "Now at end of input.\n"));
+    }
+  else if (yychar == YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
+  else
+    {
+      yytoken = YYTRANSLATE (yychar);
+      YY_SYMBOL_PRINT ("Next token is", yytoken, &yylval, &yylloc);
+    }
+
+  /* If the proper action on seeing token YYTOKEN is to reduce or to
+     detect an error, take that action.  */
+  yyn += yytoken;
+  if (yyn < 0 || YYLAST < yyn || yycheck[yyn] != yytoken)
+    goto yydefault;
+  yyn = yytable[yyn];
+  if (yyn <= 0)
+    {
+      if (yytable_value_is_error (yyn))
+        goto yyerrlab;
+      yyn = -yyn;
+      goto yyreduce;
+    }
+
+  /* Count tokens shifted since error; after three, turn off error
+     status.  */
+  if (yyerrstatus)
+    yyerrstatus--;
+
+  /* Shift the lookahead token.  */
+  YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
+  yystate = yyn;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+  /* Discard the shifted token.  */
+  yychar = YYEMPTY;
+  goto yynewstate;
+
+
+/*-----------------------------------------------------------.
+| yydefault -- do the default action for the current state.  |
+`-----------------------------------------------------------*/
+yydefault:
+  yyn = yydefact[yystate];
+  if (yyn == 0)
+    goto yyerrlab;
+  goto yyreduce;
+
+
+/*-----------------------------.
+| yyreduce -- do a reduction.  |
+`-----------------------------*/
+yyreduce:
+  /* yyn is the number of a rule to reduce with.  */
+  yylen = yyr2[yyn];
+
+  /* If YYLEN is nonzero, implement the default value of the action:
+     '$$ = $1'.
+
+     Otherwise, the following line sets YYVAL to garbage.
+     This behavior is undocumented and Bison
+     users should not rely upon it.  Assigning to YYVAL
+     unconditionally makes the parser a bit smaller, and it avoids a
+     GCC warning that YYVAL may be used uninitialized.  */
+  yyval = yyvsp[1-yylen];
+
+
+  YY_REDUCE_PRINT (yyn);
+  switch (yyn)
+    {
+  case 14: /* bus_statement: BUS bus_id adapter_name  */
+#line 165 "lib/conf-parse.y"
+                  { sensors_bus new_el;
+		    new_el.line = (yyvsp[-2].line);
+		    new_el.bus = (yyvsp[-1].bus);
+                    new_el.adapter = (yyvsp[0].name);
+		    bus_add_el(&new_el);
+		  }
+#line 1269 "lib/conf-parse.c"
+    break;
+
+  case 15: /* label_statement: LABEL function_name string  */
+#line 174 "lib/conf-parse.y"
+                          { sensors_label new_el;
+			    if (!current_chip && !current_chip_skipped) {
+			      sensors_yyerror(scanner, "Label statement before first chip statement");
+			      YYERROR;
+			    }
+			    if (!current_chip_skipped) {
+			      new_el.line = (yyvsp[-2].line);
+			      new_el.name = (yyvsp[-1].name);
+			      new_el.value = (yyvsp[0].name);
+			      label_add_el(&new_el);
+			    }
+			  }
+#line 1286 "lib/conf-parse.c"
+    break;
+
+  case 16: /* set_statement: SET function_name expression  */
+#line 189 "lib/conf-parse.y"
+                  { sensors_set new_el;
+		    if (!current_chip && !current_chip_skipped) {
+		      sensors_yyerror(scanner, "Set statement before first chip statement");
+		      YYERROR;
+		    }
+		    if (expr_uses((yyvsp[0].expr), sensors_kind_aggr)) {
+		      sensors_yyerror(scanner, "Aggregate functions are only allowed in virtual statements");
+		      YYERROR;
+		    }
+		    if (!current_chip_skipped) {
+		      new_el.line = (yyvsp[-2].line);
+		      new_el.name = (yyvsp[-1].name);
+		      new_el.value = (yyvsp[0].expr);
+		      set_add_el(&new_el);
+		    }
+		  }
+#line 1307 "lib/conf-parse.c"
+    break;
+
+  case 17: /* compute_statement: COMPUTE function_name expression ',' expression  */
+#line 208 "lib/conf-parse.y"
+                          { sensors_compute new_el;
+			    if (!current_chip && !current_chip_skipped) {
+			      sensors_yyerror(scanner, "Compute statement before first chip statement");
+			      YYERROR;
+			    }
+			    if (expr_uses((yyvsp[-2].expr), sensors_kind_aggr) ||
+			        expr_uses((yyvsp[0].expr), sensors_kind_aggr)) {
+			      sensors_yyerror(scanner, "Aggregate functions are only allowed in virtual statements");
+			      YYERROR;
+			    }
+			    if (!current_chip_skipped) {
+			      new_el.line = (yyvsp[-4].line);
+			      new_el.name = (yyvsp[-3].name);
+			      new_el.from_proc = (yyvsp[-2].expr);
+			      new_el.to_proc = (yyvsp[0].expr);
+			      compute_add_el(&new_el);
+			    }
+			  }
+#line 1330 "lib/conf-parse.c"
+    break;
+
+  case 18: /* ignore_statement: IGNORE function_name  */
+#line 229 "lib/conf-parse.y"
+                        { sensors_ignore new_el;
+			  if (!current_chip && !current_chip_skipped) {
+			    sensors_yyerror(scanner, "Ignore statement before first chip statement");
+			    YYERROR;
+			  }
+			  if (!current_chip_skipped) {
+			    new_el.line = (yyvsp[-1].line);
+			    new_el.name = (yyvsp[0].name);
+			    ignore_add_el(&new_el);
+			  }
+			}
+#line 1346 "lib/conf-parse.c"
+    break;
+
+  case 19: /* suspended_statement: SUSPENDED NAME  */
+#line 243 "lib/conf-parse.y"
+                        { int mode;
+			  if (!current_chip && !current_chip_skipped) {
+			    sensors_yyerror(scanner, "Suspended statement before first chip statement");
+			    YYERROR;
+			  }
+			  if (!strcmp((yyvsp[0].name), "wake"))
+			    mode = SENSORS_SUSPENDED_WAKE;
+			  else if (!strcmp((yyvsp[0].name), "skip"))
+			    mode = SENSORS_SUSPENDED_SKIP;
+			  else {
+			    sensors_yyerror(scanner, "Suspended statement expects wake or skip");
+			    YYERROR;
+			  }
+			  if (!current_chip_skipped)
+			    current_chip->suspended = mode;
+			}
+#line 1367 "lib/conf-parse.c"
+    break;
+
+  case 20: /* virtual_statement: VIRTUAL function_name expression  */
+#line 262 "lib/conf-parse.y"
+                        { sensors_virtual new_el;
+			  if (!sensors_virtual_name_valid((yyvsp[-1].name))) {
+			    sensors_yyerror(scanner, "Virtual sensor name must be that of an input feature, such as temp1");
+			    YYERROR;
+			  }
+			  if (expr_uses((yyvsp[0].expr), sensors_kind_source)) {
+			    sensors_yyerror(scanner, "Virtual statement can't use @");
+			    YYERROR;
+			  }
+			  new_el.line = (yyvsp[-2].line);
+			  new_el.name = (yyvsp[-1].name);
+			  new_el.value = (yyvsp[0].expr);
+			  virtual_add_el(&new_el);
+			}
+#line 1386 "lib/conf-parse.c"
+    break;
+
+  case 21: /* group_statement: GROUP function_name selector_list  */
+#line 279 "lib/conf-parse.y"
+                        { (yyvsp[0].group).line = (yyvsp[-2].line);
+			  (yyvsp[0].group).name = (yyvsp[-1].name);
+			  group_add_el(&(yyvsp[0].group));
+			}
+#line 1395 "lib/conf-parse.c"
+    break;
+
+  case 22: /* chip_statement: CHIP chip_name_list  */
+#line 286 "lib/conf-parse.y"
+                  { sensors_chip new_el;
+		    if (sensors_config_skip_absent > 0 &&
+		        !sensors_config_chip_detected(&(yyvsp[0].chips))) {
+		      /* No detected chip can use this block */
+		      free((yyvsp[0].chips).fits);
+		      current_chip_skipped = 1;
+		    } else {
+		      new_el.line = (yyvsp[-1].line);
+		      new_el.labels = NULL;
+		      new_el.sets = NULL;
+		      new_el.computes = NULL;
+		      new_el.ignores = NULL;
+		      new_el.labels_count = new_el.labels_max = 0;
+		      new_el.sets_count = new_el.sets_max = 0;
+		      new_el.computes_count = new_el.computes_max = 0;
+		      new_el.ignores_count = new_el.ignores_max = 0;
+		      new_el.suspended = -1;
+		      new_el.chips = (yyvsp[0].chips);
+		      chip_add_el(&new_el);
+		      current_chip = sensors_config_chips + 
+		                     sensors_config_chips_count - 1;
+		      current_chip_skipped = 0;
+		    }
+		  }
+#line 1424 "lib/conf-parse.c"
+    break;
+
+  case 23: /* chip_name_list: chip_name  */
+#line 313 "lib/conf-parse.y"
+                  { 
+		    (yyval.chips).fits = NULL;
+		    (yyval.chips).fits_count = (yyval.chips).fits_max = 0;
+		    fits_add_el(&(yyvsp[0].chip),(yyval.chips));
+		  }
+#line 1434 "lib/conf-parse.c"
+    break;
+
+  case 24: /* chip_name_list: chip_name_list chip_name  */
+#line 319 "lib/conf-parse.y"
+                  { (yyval.chips) = (yyvsp[-1].chips);
+		    fits_add_el(&(yyvsp[0].chip),(yyval.chips));
+		  }
+#line 1442 "lib/conf-parse.c"
+    break;
+
+  case 25: /* expression: FLOAT  */
+#line 325 "lib/conf-parse.y"
+                  { (yyval.expr) = malloc_expr(); 
+		    (yyval.expr)->data.val = (yyvsp[0].value); 
+		    (yyval.expr)->kind = sensors_kind_val;
+		  }
+#line 1451 "lib/conf-parse.c"
+    break;
+
+  case 26: /* expression: NAME  */
+#line 330 "lib/conf-parse.y"
+                  { (yyval.expr) = malloc_expr(); 
+		    (yyval.expr)->data.var = sensors_intern_name((yyvsp[0].name));
+		    (yyval.expr)->kind = sensors_kind_var;
+		  }
+#line 1460 "lib/conf-parse.c"
+    break;
+
+  case 27: /* expression: '@'  */
+#line 335 "lib/conf-parse.y"
+                  { (yyval.expr) = malloc_expr();
+		    (yyval.expr)->kind = sensors_kind_source;
+		  }
+#line 1468 "lib/conf-parse.c"
+    break;
+
+  case 28: /* expression: NAME '(' selector ')'  */
+#line 339 "lib/conf-parse.y"
+                  { (yyval.expr) = malloc_expr();
+		    (yyval.expr)->kind = sensors_kind_aggr;
+		    if (!strcmp((yyvsp[-3].name), "max"))
+		      (yyval.expr)->data.aggr.op = sensors_max;
+		    else if (!strcmp((yyvsp[-3].name), "min"))
+		      (yyval.expr)->data.aggr.op = sensors_min;
+		    else if (!strcmp((yyvsp[-3].name), "sum"))
+		      (yyval.expr)->data.aggr.op = sensors_sum;
+		    else if (!strcmp((yyvsp[-3].name), "avg"))
+		      (yyval.expr)->data.aggr.op = sensors_avg;
+		    else {
+		      sensors_yyerror(scanner, "Unknown aggregate function");
+		      YYERROR;
+		    }
+		    (yyval.expr)->data.aggr.spec = (yyvsp[-1].name);
+		  }
+#line 1489 "lib/conf-parse.c"
+    break;
+
+  case 29: /* expression: expression '+' expression  */
+#line 356 "lib/conf-parse.y"
+                  { (yyval.expr) = malloc_expr(); 
+		    (yyval.expr)->kind = sensors_kind_sub;
+		    (yyval.expr)->data.subexpr.op = sensors_add;
+		    (yyval.expr)->data.subexpr.sub1 = (yyvsp[-2].expr);
+		    (yyval.expr)->data.subexpr.sub2 = (yyvsp[0].expr);
+		  }
+#line 1500 "lib/conf-parse.c"
+    break;
+
+  case 30: /* expression: expression '-' expression  */
+#line 363 "lib/conf-parse.y"
+                  { (yyval.expr) = malloc_expr(); 
+		    (yyval.expr)->kind = sensors_kind_sub;
+		    (yyval.expr)->data.subexpr.op = sensors_sub;
+		    (yyval.expr)->data.subexpr.sub1 = (yyvsp[-2].expr);
+		    (yyval.expr)->data.subexpr.sub2 = (yyvsp[0].expr);
+		  }
+#line 1511 "lib/conf-parse.c"
+    break;
+
+  case 31: /* expression: expression '*' expression  */
+#line 370 "lib/conf-parse.y"
+                  { (yyval.expr) = malloc_expr(); 
+		    (yyval.expr)->kind = sensors_kind_sub;
+		    (yyval.expr)->data.subexpr.op = sensors_multiply;
+		    (yyval.expr)->data.subexpr.sub1 = (yyvsp[-2].expr);
+		    (yyval.expr)->data.subexpr.sub2 = (yyvsp[0].expr);
+		  }
+#line 1522 "lib/conf-parse.c"
+    break;
+
+  case 32: /* expression: expression '/' expression  */
+#line 377 "lib/conf-parse.y"
+                  { (yyval.expr) = malloc_expr(); 
+		    (yyval.expr)->kind = sensors_kind_sub;
+		    (yyval.expr)->data.subexpr.op = sensors_divide;
+		    (yyval.expr)->data.subexpr.sub1 = (yyvsp[-2].expr);
+		    (yyval.expr)->data.subexpr.sub2 = (yyvsp[0].expr);
+		  }
+#line 1533 "lib/conf-parse.c"
+    break;
+
+  case 33: /* expression: '-' expression  */
+#line 384 "lib/conf-parse.y"
+                  { (yyval.expr) = malloc_expr(); 
+		    (yyval.expr)->kind = sensors_kind_sub;
+		    (yyval.expr)->data.subexpr.op = sensors_negate;
+		    (yyval.expr)->data.subexpr.sub1 = (yyvsp[0].expr);
+		    (yyval.expr)->data.subexpr.sub2 = NULL;
+		  }
+#line 1544 "lib/conf-parse.c"
+    break;
+
+  case 34: /* expression: '(' expression ')'  */
+#line 391 "lib/conf-parse.y"
+                  { (yyval.expr) = (yyvsp[-1].expr); }
+#line 1550 "lib/conf-parse.c"
+    break;
+
+  case 35: /* expression: '^' expression  */
+#line 393 "lib/conf-parse.y"
+                  { (yyval.expr) = malloc_expr(); 
+		    (yyval.expr)->kind = sensors_kind_sub;
+		    (yyval.expr)->data.subexpr.op = sensors_exp;
+		    (yyval.expr)->data.subexpr.sub1 = (yyvsp[0].expr);
+		    (yyval.expr)->data.subexpr.sub2 = NULL;
+		  }
+#line 1561 "lib/conf-parse.c"
+    break;
+
+  case 36: /* expression: '`' expression  */
+#line 400 "lib/conf-parse.y"
+                  { (yyval.expr) = malloc_expr(); 
+		    (yyval.expr)->kind = sensors_kind_sub;
+		    (yyval.expr)->data.subexpr.op = sensors_log;
+		    (yyval.expr)->data.subexpr.sub1 = (yyvsp[0].expr);
+		    (yyval.expr)->data.subexpr.sub2 = NULL;
+		  }
+#line 1572 "lib/conf-parse.c"
+    break;
+
+  case 37: /* bus_id: NAME  */
+#line 409 "lib/conf-parse.y"
+                  { int res = sensors_parse_bus_id((yyvsp[0].name),&(yyval.bus));
+		    if (res) {
+                      sensors_yyerror(scanner, "Parse error in bus id");
+		      YYERROR;
+                    }
+		  }
+#line 1583 "lib/conf-parse.c"
+    break;
+
+  case 38: /* adapter_name: NAME  */
+#line 418 "lib/conf-parse.y"
+                  { (yyval.name) = (yyvsp[0].name); }
+#line 1589 "lib/conf-parse.c"
+    break;
+
+  case 39: /* function_name: NAME  */
+#line 422 "lib/conf-parse.y"
+                  { (yyval.name) = sensors_intern_name((yyvsp[0].name)); }
+#line 1595 "lib/conf-parse.c"
+    break;
+
+  case 40: /* string: NAME  */
+#line 426 "lib/conf-parse.y"
+          { (yyval.name) = (yyvsp[0].name); }
+#line 1601 "lib/conf-parse.c"
+    break;
+
+  case 41: /* selector_list: selector  */
+#line 430 "lib/conf-parse.y"
+                  {
+		    (yyval.group).specs = NULL;
+		    (yyval.group).specs_count = (yyval.group).specs_max = 0;
+		    spec_add_el(&(yyvsp[0].name),(yyval.group));
+		  }
+#line 1611 "lib/conf-parse.c"
+    break;
+
+  case 42: /* selector_list: selector_list selector  */
+#line 436 "lib/conf-parse.y"
+                  { (yyval.group) = (yyvsp[-1].group);
+		    spec_add_el(&(yyvsp[0].name),(yyval.group));
+		  }
+#line 1619 "lib/conf-parse.c"
+    break;
+
+  case 43: /* selector: NAME  */
+#line 442 "lib/conf-parse.y"
+                  { sensors_selector *selector;
+		    if (sensors_compile_selector((yyvsp[0].name), &selector)) {
+		      sensors_yyerror(scanner, "Parse error in selector");
+		      YYERROR;
+		    }
+		    sensors_free_selector(selector);
+		    (yyval.name) = (yyvsp[0].name);
+		  }
+#line 1632 "lib/conf-parse.c"
+    break;
+
+  case 44: /* chip_name: NAME  */
+#line 453 "lib/conf-parse.y"
+                  { int res = sensors_arena_parse_chip_name(&sensors_config_arena,
+							    (yyvsp[0].name), &(yyval.chip));
+		    if (res) {
+		      sensors_yyerror(scanner, "Parse error in chip name");
+		      YYERROR;
+		    }
+		    if ((yyval.chip).prefix)
+		      (yyval.chip).prefix = sensors_intern_name((yyval.chip).prefix);
+		  }
+#line 1646 "lib/conf-parse.c"
+    break;
+
+
+#line 1650 "lib/conf-parse.c"
+
+      default: break;
+    }
+  /* User semantic actions sometimes alter yychar, and that requires
+     that yytoken be updated with the new translation.  We take the
+     approach of translating immediately before every use of yytoken.
+     One alternative is translating here after every semantic action,
+     but that translation would be missed if the semantic action invokes
+     YYABORT, YYACCEPT, or YYERROR immediately after altering yychar or
+     if it invokes YYBACKUP.  In the case of YYABORT or YYACCEPT, an
+     incorrect destructor might then be invoked immediately.  In the
+     case of YYERROR or YYBACKUP, subsequent parser actions might lead
+     to an incorrect destructor call or verbose syntax error message
+     before the lookahead is translated.  */
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
+
+  YYPOPSTACK (yylen);
+  yylen = 0;
+
+  *++yyvsp = yyval;
+
+  /* Now 'shift' the result of the reduction.  Determine what state
+     that goes to, based on the state we popped back to and the rule
+     number reduced by.  */
+  {
+    const int yylhs = yyr1[yyn] - YYNTOKENS;
+    const int yyi = yypgoto[yylhs] + *yyssp;
+    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp
+               ? yytable[yyi]
+               : yydefgoto[yylhs]);
+  }
+
+  goto yynewstate;
+
+
+/*--------------------------------------.
+| yyerrlab -- here on detecting error.  |
+`--------------------------------------*/
+yyerrlab:
+  /* Make sure we have latest lookahead translation.  See comments at
+     user semantic actions for why this is necessary.  */
+  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
+  /* If not already recovering from an error, report this error.  */
+  if (!yyerrstatus)
+    {
+      ++yynerrs;
+      yyerror (scanner, YY_("syntax error"));
+    }
+
+  if (yyerrstatus == 3)
+    {
+      /* If just tried and failed to reuse lookahead token after an
+         error, discard it.  */
+
+      if (yychar <= YYEOF)
+        {
+          /* Return failure if at end of input.  */
+          if (yychar == YYEOF)
+            YYABORT;
+        }
+      else
+        {
+          yydestruct ("Error: discarding",
+                      yytoken, &yylval, scanner);
+          yychar = YYEMPTY;
+        }
+    }
+
+  /* Else will try to reuse lookahead token after shifting the error
+     token.  */
+  goto yyerrlab1;
+
+
+/*---------------------------------------------------.
+| yyerrorlab -- error raised explicitly by YYERROR.  |
+`---------------------------------------------------*/
+yyerrorlab:
+  /* Pacify compilers when the user code never invokes YYERROR and the
+     label yyerrorlab therefore never appears in user code.  */
+  if (0)
+    YYERROR;
+  ++yynerrs;
+
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYERROR.  */
+  YYPOPSTACK (yylen);
+  yylen = 0;
+  YY_STACK_PRINT (yyss, yyssp);
+  yystate = *yyssp;
+  goto yyerrlab1;
+
+
+/*-------------------------------------------------------------.
+| yyerrlab1 -- common code for both syntax error and YYERROR.  |
+`-------------------------------------------------------------*/
+yyerrlab1:
+  yyerrstatus = 3;      /* Each real token shifted decrements this.  */
+
+  /* Pop stack until we find a state that shifts the error token.  */
+  for (;;)
+    {
+      yyn = yypact[yystate];
+      if (!yypact_value_is_default (yyn))
+        {
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
+            {
+              yyn = yytable[yyn];
+              if (0 < yyn)
+                break;
+            }
+        }
+
+      /* Pop the current state because it cannot handle the error token.  */
+      if (yyssp == yyss)
+        YYABORT;
+
+
+      yydestruct ("Error: popping",
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp, scanner);
+      YYPOPSTACK (1);
+      yystate = *yyssp;
+      YY_STACK_PRINT (yyss, yyssp);
+    }
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+
+  /* Shift the error token.  */
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
+
+  yystate = yyn;
+  goto yynewstate;
+
+
+/*-------------------------------------.
+| yyacceptlab -- YYACCEPT comes here.  |
+`-------------------------------------*/
+yyacceptlab:
+  yyresult = 0;
+  goto yyreturnlab;
+
+
+/*-----------------------------------.
+| yyabortlab -- YYABORT comes here.  |
+`-----------------------------------*/
+yyabortlab:
+  yyresult = 1;
+  goto yyreturnlab;
+
+
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
+yyexhaustedlab:
+  yyerror (scanner, YY_("memory exhausted"));
+  yyresult = 2;
+  goto yyreturnlab;
+
+
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
+  if (yychar != YYEMPTY)
+    {
+      /* Make sure we have latest lookahead translation.  See comments at
+         user semantic actions for why this is necessary.  */
+      yytoken = YYTRANSLATE (yychar);
+      yydestruct ("Cleanup: discarding lookahead",
+                  yytoken, &yylval, scanner);
+    }
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYABORT or YYACCEPT.  */
+  YYPOPSTACK (yylen);
+  YY_STACK_PRINT (yyss, yyssp);
+  while (yyssp != yyss)
+    {
+      yydestruct ("Cleanup: popping",
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp, scanner);
+      YYPOPSTACK (1);
+    }
+#ifndef yyoverflow
+  if (yyss != yyssa)
+    YYSTACK_FREE (yyss);
+#endif
+
+  return yyresult;
+}
+
+#line 464 "lib/conf-parse.y"
+
+
+void sensors_yyerror(sensors_scanner *scanner, const char *err)
+{
+  sensors_config_parse_errors++;
+  if (scanner->lex_error[0]) {
+    sensors_parse_error_wfn(scanner->lex_error, scanner->filename, scanner->lineno);
+    scanner->lex_error[0] = '\0';
+  } else
+    sensors_parse_error_wfn(err, scanner->filename, scanner->lineno);
+}
+
+sensors_expr *malloc_expr(void)
+{
+  return sensors_arena_alloc(&sensors_config_arena, sizeof(sensors_expr));
+}
+
+int expr_uses(const sensors_expr *expr, sensors_expr_kind kind)
+{
+  if (expr->kind == kind)
+    return 1;
+  if (expr->kind != sensors_kind_sub)
+    return 0;
+  return expr_uses(expr->data.subexpr.sub1, kind) ||
+         (expr->data.subexpr.sub2 && expr_uses(expr->data.subexpr.sub2, kind));
+}
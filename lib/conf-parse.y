@@ -30,12 +30,15 @@
 #include "error.h"
 #include "conf.h"
 #include "access.h"
-#include "init.h"
+#include "virtual.h"
 
-static void sensors_yyerror(const char *err);
+static void sensors_yyerror(sensors_scanner *scanner, const char *err);
 static sensors_expr *malloc_expr(void);
+static int expr_uses(const sensors_expr *expr, sensors_expr_kind kind);
 
-static sensors_chip *current_chip = NULL;
+/* The parser is reentrant, its state is in the scanner */
+#define current_chip (scanner->current_chip)
+#define current_chip_skipped (scanner->current_chip_skipped)
 
 #define bus_add_el(el) sensors_add_array_el(el,\
                                       &sensors_config_busses,\
@@ -62,6 +65,16 @@ static sensors_chip *current_chip = NULL;
                                           &current_chip->ignores_count,\
                                           &current_chip->ignores_max,\
                                           sizeof(sensors_ignore));
+#define virtual_add_el(el) sensors_add_array_el(el,\
+                                          &sensors_config_virtuals,\
+                                          &sensors_config_virtuals_count,\
+                                          &sensors_config_virtuals_max,\
+                                          sizeof(sensors_virtual));
+#define group_add_el(el) sensors_add_array_el(el,\
+                                        &sensors_config_groups,\
+                                        &sensors_config_groups_count,\
+                                        &sensors_config_groups_max,\
+                                        sizeof(sensors_group));
 #define chip_add_el(el) sensors_add_array_el(el,\
                                        &sensors_config_chips,\
                                        &sensors_config_chips_count,\
@@ -74,13 +87,24 @@ static sensors_chip *current_chip = NULL;
                                                   &(list).fits_max, \
 		                                  sizeof(sensors_chip_name));
 
+#define spec_add_el(el,group) sensors_add_array_el(el,\
+                                                   &(group).specs,\
+                                                   &(group).specs_count,\
+                                                   &(group).specs_max, \
+		                                   sizeof(char *));
+
 %}
 
+%define api.pure
+%parse-param {sensors_scanner *scanner}
+%lex-param {sensors_scanner *scanner}
+
 %union {
   double value;
   char *name;
   void *nothing;
   sensors_chip_name_list chips;
+  sensors_group group;
   sensors_expr *expr;
   sensors_bus_id bus;
   sensors_chip_name chip;
@@ -100,16 +124,21 @@ static sensors_chip *current_chip = NULL;
 %token <line> CHIP
 %token <line> COMPUTE
 %token <line> IGNORE
+%token <line> SUSPENDED
+%token <line> VIRTUAL
+%token <line> GROUP
 %token <value> FLOAT
 %token <name> NAME
 %token <nothing> ERROR
 
 %type <chips> chip_name_list
+%type <group> selector_list
 %type <expr> expression
 %type <bus> bus_id
 %type <name> adapter_name
 %type <name> function_name
 %type <name> string
+%type <name> selector
 %type <chip> chip_name
 
 %start input
@@ -126,6 +155,9 @@ line:	  bus_statement EOL
 	| chip_statement EOL
 	| compute_statement EOL
 	| ignore_statement EOL
+	| suspended_statement EOL
+	| virtual_statement EOL
+	| group_statement EOL
 	| error	EOL
 ;
 
@@ -140,79 +172,140 @@ bus_statement:	  BUS bus_id adapter_name
 
 label_statement:	  LABEL function_name string
 			  { sensors_label new_el;
-			    if (!current_chip) {
-			      sensors_yyerror("Label statement before first chip statement");
-			      free($2);
-			      free($3);
+			    if (!current_chip && !current_chip_skipped) {
+			      sensors_yyerror(scanner, "Label statement before first chip statement");
 			      YYERROR;
 			    }
-			    new_el.line = $1;
-			    new_el.name = $2;
-			    new_el.value = $3;
-			    label_add_el(&new_el);
+			    if (!current_chip_skipped) {
+			      new_el.line = $1;
+			      new_el.name = $2;
+			      new_el.value = $3;
+			      label_add_el(&new_el);
+			    }
 			  }
 ;
 
 set_statement:	  SET function_name expression
 		  { sensors_set new_el;
-		    if (!current_chip) {
-		      sensors_yyerror("Set statement before first chip statement");
-		      free($2);
-		      sensors_free_expr($3);
+		    if (!current_chip && !current_chip_skipped) {
+		      sensors_yyerror(scanner, "Set statement before first chip statement");
 		      YYERROR;
 		    }
-		    new_el.line = $1;
-		    new_el.name = $2;
-		    new_el.value = $3;
-		    set_add_el(&new_el);
+		    if (expr_uses($3, sensors_kind_aggr)) {
+		      sensors_yyerror(scanner, "Aggregate functions are only allowed in virtual statements");
+		      YYERROR;
+		    }
+		    if (!current_chip_skipped) {
+		      new_el.line = $1;
+		      new_el.name = $2;
+		      new_el.value = $3;
+		      set_add_el(&new_el);
+		    }
 		  }
 ;
 
 compute_statement:	  COMPUTE function_name expression ',' expression
 			  { sensors_compute new_el;
-			    if (!current_chip) {
-			      sensors_yyerror("Compute statement before first chip statement");
-			      free($2);
-			      sensors_free_expr($3);
-			      sensors_free_expr($5);
+			    if (!current_chip && !current_chip_skipped) {
+			      sensors_yyerror(scanner, "Compute statement before first chip statement");
 			      YYERROR;
 			    }
-			    new_el.line = $1;
-			    new_el.name = $2;
-			    new_el.from_proc = $3;
-			    new_el.to_proc = $5;
-			    compute_add_el(&new_el);
+			    if (expr_uses($3, sensors_kind_aggr) ||
+			        expr_uses($5, sensors_kind_aggr)) {
+			      sensors_yyerror(scanner, "Aggregate functions are only allowed in virtual statements");
+			      YYERROR;
+			    }
+			    if (!current_chip_skipped) {
+			      new_el.line = $1;
+			      new_el.name = $2;
+			      new_el.from_proc = $3;
+			      new_el.to_proc = $5;
+			      compute_add_el(&new_el);
+			    }
 			  }
 ;
 
 ignore_statement:	IGNORE function_name
 			{ sensors_ignore new_el;
-			  if (!current_chip) {
-			    sensors_yyerror("Ignore statement before first chip statement");
-			    free($2);
+			  if (!current_chip && !current_chip_skipped) {
+			    sensors_yyerror(scanner, "Ignore statement before first chip statement");
+			    YYERROR;
+			  }
+			  if (!current_chip_skipped) {
+			    new_el.line = $1;
+			    new_el.name = $2;
+			    ignore_add_el(&new_el);
+			  }
+			}
+;
+
+suspended_statement:	SUSPENDED NAME
+			{ int mode;
+			  if (!current_chip && !current_chip_skipped) {
+			    sensors_yyerror(scanner, "Suspended statement before first chip statement");
+			    YYERROR;
+			  }
+			  if (!strcmp($2, "wake"))
+			    mode = SENSORS_SUSPENDED_WAKE;
+			  else if (!strcmp($2, "skip"))
+			    mode = SENSORS_SUSPENDED_SKIP;
+			  else {
+			    sensors_yyerror(scanner, "Suspended statement expects wake or skip");
+			    YYERROR;
+			  }
+			  if (!current_chip_skipped)
+			    current_chip->suspended = mode;
+			}
+;
+
+virtual_statement:	VIRTUAL function_name expression
+			{ sensors_virtual new_el;
+			  if (!sensors_virtual_name_valid($2)) {
+			    sensors_yyerror(scanner, "Virtual sensor name must be that of an input feature, such as temp1");
+			    YYERROR;
+			  }
+			  if (expr_uses($3, sensors_kind_source)) {
+			    sensors_yyerror(scanner, "Virtual statement can't use @");
 			    YYERROR;
 			  }
 			  new_el.line = $1;
 			  new_el.name = $2;
-			  ignore_add_el(&new_el);
+			  new_el.value = $3;
+			  virtual_add_el(&new_el);
+			}
+;
+
+group_statement:	GROUP function_name selector_list
+			{ $3.line = $1;
+			  $3.name = $2;
+			  group_add_el(&$3);
 			}
 ;
 
 chip_statement:	  CHIP chip_name_list
 		  { sensors_chip new_el;
-		    new_el.line = $1;
-		    new_el.labels = NULL;
-		    new_el.sets = NULL;
-		    new_el.computes = NULL;
-		    new_el.ignores = NULL;
-		    new_el.labels_count = new_el.labels_max = 0;
-		    new_el.sets_count = new_el.sets_max = 0;
-		    new_el.computes_count = new_el.computes_max = 0;
-		    new_el.ignores_count = new_el.ignores_max = 0;
-		    new_el.chips = $2;
-		    chip_add_el(&new_el);
-		    current_chip = sensors_config_chips + 
-		                   sensors_config_chips_count - 1;
+		    if (sensors_config_skip_absent > 0 &&
+		        !sensors_config_chip_detected(&$2)) {
+		      /* No detected chip can use this block */
+		      free($2.fits);
+		      current_chip_skipped = 1;
+		    } else {
+		      new_el.line = $1;
+		      new_el.labels = NULL;
+		      new_el.sets = NULL;
+		      new_el.computes = NULL;
+		      new_el.ignores = NULL;
+		      new_el.labels_count = new_el.labels_max = 0;
+		      new_el.sets_count = new_el.sets_max = 0;
+		      new_el.computes_count = new_el.computes_max = 0;
+		      new_el.ignores_count = new_el.ignores_max = 0;
+		      new_el.suspended = -1;
+		      new_el.chips = $2;
+		      chip_add_el(&new_el);
+		      current_chip = sensors_config_chips + 
+		                     sensors_config_chips_count - 1;
+		      current_chip_skipped = 0;
+		    }
 		  }
 ;
 
@@ -235,13 +328,30 @@ expression:	  FLOAT
 		  }
 		| NAME
 		  { $$ = malloc_expr(); 
-		    $$->data.var = $1;
+		    $$->data.var = sensors_intern_name($1);
 		    $$->kind = sensors_kind_var;
 		  }
 		| '@'
 		  { $$ = malloc_expr();
 		    $$->kind = sensors_kind_source;
 		  }
+		| NAME '(' selector ')'
+		  { $$ = malloc_expr();
+		    $$->kind = sensors_kind_aggr;
+		    if (!strcmp($1, "max"))
+		      $$->data.aggr.op = sensors_max;
+		    else if (!strcmp($1, "min"))
+		      $$->data.aggr.op = sensors_min;
+		    else if (!strcmp($1, "sum"))
+		      $$->data.aggr.op = sensors_sum;
+		    else if (!strcmp($1, "avg"))
+		      $$->data.aggr.op = sensors_avg;
+		    else {
+		      sensors_yyerror(scanner, "Unknown aggregate function");
+		      YYERROR;
+		    }
+		    $$->data.aggr.spec = $3;
+		  }
 		| expression '+' expression
 		  { $$ = malloc_expr(); 
 		    $$->kind = sensors_kind_sub;
@@ -297,9 +407,8 @@ expression:	  FLOAT
 
 bus_id:		  NAME
 		  { int res = sensors_parse_bus_id($1,&$$);
-		    free($1);
 		    if (res) {
-                      sensors_yyerror("Parse error in bus id");
+                      sensors_yyerror(scanner, "Parse error in bus id");
 		      YYERROR;
                     }
 		  }
@@ -310,38 +419,71 @@ adapter_name:	  NAME
 ;
 
 function_name:	  NAME
-		  { $$ = $1; }
+		  { $$ = sensors_intern_name($1); }
 ;
 
 string:	  NAME
 	  { $$ = $1; }
 ;
 
+selector_list:	  selector
+		  {
+		    $$.specs = NULL;
+		    $$.specs_count = $$.specs_max = 0;
+		    spec_add_el(&$1,$$);
+		  }
+		| selector_list selector
+		  { $$ = $1;
+		    spec_add_el(&$2,$$);
+		  }
+;
+
+selector:	  NAME
+		  { sensors_selector *selector;
+		    if (sensors_compile_selector($1, &selector)) {
+		      sensors_yyerror(scanner, "Parse error in selector");
+		      YYERROR;
+		    }
+		    sensors_free_selector(selector);
+		    $$ = $1;
+		  }
+;
+
 chip_name:	  NAME
-		  { int res = sensors_parse_chip_name($1,&$$); 
-		    free($1);
+		  { int res = sensors_arena_parse_chip_name(&sensors_config_arena,
+							    $1, &$$);
 		    if (res) {
-		      sensors_yyerror("Parse error in chip name");
+		      sensors_yyerror(scanner, "Parse error in chip name");
 		      YYERROR;
 		    }
+		    if ($$.prefix)
+		      $$.prefix = sensors_intern_name($$.prefix);
 		  }
 ;
 
 %%
 
-void sensors_yyerror(const char *err)
+void sensors_yyerror(sensors_scanner *scanner, const char *err)
 {
-  if (sensors_lex_error[0]) {
-    sensors_parse_error_wfn(sensors_lex_error, sensors_yyfilename, sensors_yylineno);
-    sensors_lex_error[0] = '\0';
+  sensors_config_parse_errors++;
+  if (scanner->lex_error[0]) {
+    sensors_parse_error_wfn(scanner->lex_error, scanner->filename, scanner->lineno);
+    scanner->lex_error[0] = '\0';
   } else
-    sensors_parse_error_wfn(err, sensors_yyfilename, sensors_yylineno);
+    sensors_parse_error_wfn(err, scanner->filename, scanner->lineno);
 }
 
 sensors_expr *malloc_expr(void)
 {
-  sensors_expr *res = malloc(sizeof(sensors_expr));
-  if (! res)
-    sensors_fatal_error(__func__, "Allocating a new expression");
-  return res;
+  return sensors_arena_alloc(&sensors_config_arena, sizeof(sensors_expr));
+}
+
+int expr_uses(const sensors_expr *expr, sensors_expr_kind kind)
+{
+  if (expr->kind == kind)
+    return 1;
+  if (expr->kind != sensors_kind_sub)
+    return 0;
+  return expr_uses(expr->data.subexpr.sub1, kind) ||
+         (expr->data.subexpr.sub2 && expr_uses(expr->data.subexpr.sub2, kind));
 }
@@ -21,14 +21,13 @@
 #ifndef LIB_SENSORS_CONF_H
 #define LIB_SENSORS_CONF_H
 
-/* This is defined in conf-lex.l */
-int sensors_yylex(void);
-extern char sensors_lex_error[];
-extern const char *sensors_yyfilename;
-extern int sensors_yylineno;
-extern FILE *sensors_yyin;
+#include "scanner.h"
+
+/* This is defined in conf-lex.l. lvalp points to the YYSTYPE which
+   receives the semantic value of the token. */
+int sensors_yylex(void *lvalp, sensors_scanner *scanner);
 
 /* This is defined in conf-parse.y */
-int sensors_yyparse(void);
+int sensors_yyparse(sensors_scanner *scanner);
 
 #endif /* LIB_SENSORS_CONF_H */
@@ -0,0 +1,541 @@
+/*
+    context.c - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "sensors.h"
+#include "data.h"
+#include "error.h"
+#include "sysfs.h"
+
+/*
+ * The default context is published through default_context, and replaced
+ * as a whole by sensors_reload(). Readers never lock anything: they
+ * announce themselves in one of two counters, then load the pointer. The
+ * reloading thread publishes the new context first, then waits until both
+ * counters have been seen at zero once, flipping the counter new readers
+ * use in between, so that it doesn't wait for readers which came after
+ * the switch. Readers which may still see the old context are gone then,
+ * and it can be freed.
+ */
+static sensors_context *default_context = &sensors_default_context;
+static long default_readers[2];
+static int default_readers_idx;
+
+/* Serializes reloads and updates */
+static pthread_mutex_t reload_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Nesting depth of sensors_read_begin(), and counter used by the calling
+   thread, -1 if it doesn't read from the default context */
+static __thread int read_depth;
+static __thread int read_idx;
+
+void sensors_read_begin(void)
+{
+	int idx;
+
+	if (read_depth++)
+		return;
+
+	/* A sensors_ctx_*() function is running */
+	if (sensors_current_context) {
+		read_idx = -1;
+		return;
+	}
+
+	idx = __atomic_load_n(&default_readers_idx, __ATOMIC_SEQ_CST);
+	__atomic_fetch_add(&default_readers[idx], 1, __ATOMIC_SEQ_CST);
+	read_idx = idx;
+	sensors_current_context = __atomic_load_n(&default_context,
+						  __ATOMIC_SEQ_CST);
+}
+
+void sensors_read_end(void)
+{
+	if (--read_depth || read_idx < 0)
+		return;
+
+	sensors_current_context = NULL;
+	__atomic_fetch_sub(&default_readers[read_idx], 1, __ATOMIC_SEQ_CST);
+}
+
+/* Wait until no reader can see a default context older than the current
+   one */
+static void sensors_wait_readers(void)
+{
+	int i, idx;
+
+	for (i = 0; i < 2; i++) {
+		idx = default_readers_idx;
+		__atomic_store_n(&default_readers_idx, !idx, __ATOMIC_SEQ_CST);
+		while (__atomic_load_n(&default_readers[idx], __ATOMIC_SEQ_CST))
+			usleep(1000);
+	}
+}
+
+int sensors_reload(FILE *input)
+{
+	sensors_context *ctx, *old;
+	int res;
+
+	/* Build the new state off to the side */
+	ctx = sensors_context_new();
+	res = sensors_ctx_init(ctx, input);
+	if (res) {
+		sensors_context_free(ctx);
+		return res;
+	}
+
+	pthread_mutex_lock(&reload_lock);
+	old = default_context;
+	/* Keep listening for hotplug events on the same socket */
+	ctx->hotplug_fd = old->hotplug_fd;
+	__atomic_store_n(&default_context, ctx, __ATOMIC_SEQ_CST);
+	sensors_wait_readers();
+	old->hotplug_fd = -1;
+	pthread_mutex_unlock(&reload_lock);
+
+	if (old == &sensors_default_context)
+		sensors_ctx_cleanup(old);
+	else
+		sensors_context_free(old);
+	return 0;
+}
+
+/*
+ * Hotplug processing changes the list of detected chips, which other
+ * threads may be reading. The default context is then replaced by a
+ * shallow copy: only the array of chips and the slots of the table of
+ * names are copied, the rest is shared with the current one. Names
+ * interned meanwhile go to an arena of the copy, so that nothing the
+ * current context owns is changed if the copy is discarded. When the copy
+ * is published, it takes over the arena of names of the current one. The
+ * removed chips are freed once the readers of the old context are gone,
+ * and the old context itself (but not what it shares with the copy).
+ */
+void sensors_update_begin(void)
+{
+	sensors_context *ctx, *old;
+	size_t size;
+
+	pthread_mutex_lock(&reload_lock);
+	old = default_context;
+
+	ctx = malloc(sizeof(*ctx));
+	if (!ctx)
+		sensors_fatal_error(__func__, "Out of memory");
+	*ctx = *old;
+
+	size = old->proc_chips_count * sizeof(*old->proc_chips);
+	ctx->proc_chips = NULL;
+	ctx->proc_chips_max = old->proc_chips_count;
+	if (size) {
+		ctx->proc_chips = malloc(size);
+		if (!ctx->proc_chips)
+			sensors_fatal_error(__func__, "Out of memory");
+		memcpy(ctx->proc_chips, old->proc_chips, size);
+	}
+
+	ctx->removed_chips = NULL;
+	ctx->removed_chips_count = ctx->removed_chips_max = 0;
+
+	size = old->names.size * sizeof(*old->names.slots);
+	ctx->names.slots = NULL;
+	memset(&ctx->names.arena, 0, sizeof(ctx->names.arena));
+	if (size) {
+		ctx->names.slots = malloc(size);
+		if (!ctx->names.slots)
+			sensors_fatal_error(__func__, "Out of memory");
+		memcpy(ctx->names.slots, old->names.slots, size);
+	}
+
+	sensors_context_enter(ctx);
+}
+
+void sensors_update_end(void)
+{
+	sensors_context *ctx = sensors_current_context;
+	sensors_context *old = default_context;
+
+	if (ctx->chips_gen == old->chips_gen) {
+		/* Nothing changed */
+		free(ctx->proc_chips);
+		sensors_strtab_free(&ctx->names);
+		free(ctx);
+	} else {
+		sensors_arena_merge(&ctx->names.arena, &old->names.arena);
+		__atomic_store_n(&default_context, ctx, __ATOMIC_SEQ_CST);
+		sensors_wait_readers();
+		sensors_sysfs_free_removed_chips();
+		free(old->proc_chips);
+		free(old->names.slots);
+		if (old != &sensors_default_context)
+			free(old);
+	}
+
+	sensors_context_leave(NULL);
+	pthread_mutex_unlock(&reload_lock);
+}
+
+/*
+ * The other library functions work on the current context of the calling
+ * thread. The functions below make the given context current for the
+ * duration of the call, so that the rest of the library doesn't have to
+ * know about contexts at all.
+ */
+
+sensors_context *sensors_context_new(void)
+{
+	sensors_context *ctx;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx)
+		sensors_fatal_error(__func__, "Out of memory");
+	ctx->hotplug_fd = -1;
+	return ctx;
+}
+
+void sensors_context_free(sensors_context *ctx)
+{
+	if (!ctx || ctx == &sensors_default_context)
+		return;
+
+	sensors_ctx_cleanup(ctx);
+	free(ctx);
+}
+
+int sensors_ctx_init(sensors_context *ctx, FILE *input)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_init(input);
+	sensors_context_leave(prev);
+	return res;
+}
+
+void sensors_ctx_cleanup(sensors_context *ctx)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+
+	sensors_cleanup();
+	sensors_context_leave(prev);
+}
+
+const char *sensors_ctx_get_adapter_name(sensors_context *ctx,
+					 const sensors_bus_id *bus)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	const char *res;
+
+	res = sensors_get_adapter_name(bus);
+	sensors_context_leave(prev);
+	return res;
+}
+
+char *sensors_ctx_get_label(sensors_context *ctx,
+			    const sensors_chip_name *name,
+			    const sensors_feature *feature)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	char *res;
+
+	res = sensors_get_label(name, feature);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_get_value(sensors_context *ctx, const sensors_chip_name *name,
+			  int subfeat_nr, double *value)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_get_value(name, subfeat_nr, value);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_get_value_timed(sensors_context *ctx,
+				const sensors_chip_name *name, int subfeat_nr,
+				double *value, struct timespec *timestamp)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_get_value_timed(name, subfeat_nr, value, timestamp);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_get_values_timed(sensors_context *ctx,
+				 const sensors_chip_name *name,
+				 sensors_reading *readings, int count)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_get_values_timed(name, readings, count);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_get_snapshot(sensors_context *ctx,
+			     const sensors_chip_name *name,
+			     sensors_reading *readings, int max)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_get_snapshot(name, readings, max);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_get_energy_power(sensors_context *ctx,
+				 const sensors_chip_name *name, int subfeat_nr,
+				 double *power)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_get_energy_power(name, subfeat_nr, power);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_get_energy_powers(sensors_context *ctx,
+				  const sensors_chip_name *name,
+				  sensors_reading *readings, int count)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_get_energy_powers(name, readings, count);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_set_value(sensors_context *ctx, const sensors_chip_name *name,
+			  int subfeat_nr, double value)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_set_value(name, subfeat_nr, value);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_do_chip_sets(sensors_context *ctx,
+			     const sensors_chip_name *name)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_do_chip_sets(name);
+	sensors_context_leave(prev);
+	return res;
+}
+
+const sensors_chip_name *
+sensors_ctx_get_detected_chips(sensors_context *ctx,
+			       const sensors_chip_name *match, int *nr)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	const sensors_chip_name *res;
+
+	res = sensors_get_detected_chips(match, nr);
+	sensors_context_leave(prev);
+	return res;
+}
+
+const sensors_feature *
+sensors_ctx_get_features(sensors_context *ctx, const sensors_chip_name *name,
+			 int *nr)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	const sensors_feature *res;
+
+	res = sensors_get_features(name, nr);
+	sensors_context_leave(prev);
+	return res;
+}
+
+const sensors_subfeature *
+sensors_ctx_get_all_subfeatures(sensors_context *ctx,
+				const sensors_chip_name *name,
+				const sensors_feature *feature, int *nr)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	const sensors_subfeature *res;
+
+	res = sensors_get_all_subfeatures(name, feature, nr);
+	sensors_context_leave(prev);
+	return res;
+}
+
+const sensors_subfeature *
+sensors_ctx_get_subfeature(sensors_context *ctx,
+			   const sensors_chip_name *name,
+			   const sensors_feature *feature,
+			   sensors_subfeature_type type)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	const sensors_subfeature *res;
+
+	res = sensors_get_subfeature(name, feature, type);
+	sensors_context_leave(prev);
+	return res;
+}
+
+const sensors_feature * const *
+sensors_ctx_get_feature_array(sensors_context *ctx,
+			      const sensors_chip_name *name, int *count)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	const sensors_feature * const *res;
+
+	res = sensors_get_feature_array(name, count);
+	sensors_context_leave(prev);
+	return res;
+}
+
+const sensors_subfeature *
+sensors_ctx_get_subfeature_array(sensors_context *ctx,
+				 const sensors_chip_name *name,
+				 const sensors_feature *feature, int *count)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	const sensors_subfeature *res;
+
+	res = sensors_get_subfeature_array(name, feature, count);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_hotplug_open(sensors_context *ctx)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_hotplug_open();
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_hotplug_process(sensors_context *ctx,
+				sensors_hotplug_callback cb, void *data)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_hotplug_process(cb, data);
+	sensors_context_leave(prev);
+	return res;
+}
+
+void sensors_ctx_hotplug_close(sensors_context *ctx)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+
+	sensors_hotplug_close();
+	sensors_context_leave(prev);
+}
+
+void sensors_ctx_dump_config(sensors_context *ctx, FILE *out,
+			     const sensors_chip_name *match)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+
+	sensors_dump_config(out, match);
+	sensors_context_leave(prev);
+}
+
+int sensors_ctx_get_stats(sensors_context *ctx, const sensors_chip_name *name,
+			  int subfeat_nr, sensors_stats *stats)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_get_stats(name, subfeat_nr, stats);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_get_value_stats(sensors_context *ctx,
+				const sensors_chip_name *name, int subfeat_nr,
+				sensors_value_stats *stats)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_get_value_stats(name, subfeat_nr, stats);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_get_read_state(sensors_context *ctx,
+			       const sensors_chip_name *name, int subfeat_nr,
+			       sensors_read_state *state)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_get_read_state(name, subfeat_nr, state);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_get_alarm_summary(sensors_context *ctx,
+				  const sensors_chip_name *match,
+				  sensors_alarm *alarms, int max)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_get_alarm_summary(match, alarms, max);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_compile_group(sensors_context *ctx, const char *name,
+			      sensors_selector **selector)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_compile_group(name, selector);
+	sensors_context_leave(prev);
+	return res;
+}
+
+int sensors_ctx_read_selector(sensors_context *ctx,
+			      sensors_selector *selector,
+			      sensors_selection *values, int max)
+{
+	sensors_context *prev = sensors_context_enter(ctx);
+	int res;
+
+	res = sensors_read_selector(selector, values, max);
+	sensors_context_leave(prev);
+	return res;
+}
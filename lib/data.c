@@ -33,26 +33,24 @@
 
 const char *libsensors_version = LM_VERSION;
 
-char **sensors_config_files = NULL;
-int sensors_config_files_count = 0;
-int sensors_config_files_max = 0;
+sensors_context sensors_default_context = {
+	.hotplug_fd = -1,
+};
 
-sensors_chip *sensors_config_chips = NULL;
-int sensors_config_chips_count = 0;
-int sensors_config_chips_subst = 0;
-int sensors_config_chips_max = 0;
+__thread sensors_context *sensors_current_context;
 
-sensors_bus *sensors_config_busses = NULL;
-int sensors_config_busses_count = 0;
-int sensors_config_busses_max = 0;
+sensors_context *sensors_context_enter(sensors_context *ctx)
+{
+	sensors_context *prev = sensors_current_context;
 
-sensors_chip_features *sensors_proc_chips = NULL;
-int sensors_proc_chips_count = 0;
-int sensors_proc_chips_max = 0;
+	sensors_current_context = ctx;
+	return prev;
+}
 
-sensors_bus *sensors_proc_bus = NULL;
-int sensors_proc_bus_count = 0;
-int sensors_proc_bus_max = 0;
+void sensors_context_leave(sensors_context *prev)
+{
+	sensors_current_context = prev;
+}
 
 void sensors_free_chip_name(sensors_chip_name *chip)
 {
@@ -75,12 +73,14 @@ void sensors_free_chip_name(sensors_chip_name *chip)
    be any decimal i2c bus number. '5e' can be any hexadecimal i2c device
    address, and '10dd' any hexadecimal isa address.
 
-   The 'prefix' part in the result is freshly allocated. All old contents
-   of res is overwritten. res itself is not allocated. In case of an error
-   return (ie. != 0), res is undefined, but all allocations are undone.
+   The 'prefix' part in the result is freshly allocated, from the arena
+   if one is given. All old contents of res is overwritten. res itself is
+   not allocated. In case of an error return (ie. != 0), res is undefined,
+   but heap allocations are undone.
 */
 
-int sensors_parse_chip_name(const char *name, sensors_chip_name *res)
+static int parse_chip_name(sensors_arena *arena, const char *name,
+			   sensors_chip_name *res)
 {
 	char *dash;
 
@@ -91,7 +91,11 @@ int sensors_parse_chip_name(const char *name, sensors_chip_name *res)
 	} else {
 		if (!(dash = strchr(name, '-')))
 			return -SENSORS_ERR_CHIP_NAME;
-		res->prefix = strndup(name, dash - name);
+		if (arena)
+			res->prefix = sensors_arena_strndup(arena, name,
+							    dash - name);
+		else
+			res->prefix = strndup(name, dash - name);
 		if (!res->prefix)
 			sensors_fatal_error(__func__,
 					    "Allocating name prefix");
@@ -161,10 +165,22 @@ int sensors_parse_chip_name(const char *name, sensors_chip_name *res)
 	return 0;
 
 ERROR:
-	free(res->prefix);
+	if (!arena)
+		free(res->prefix);
 	return -SENSORS_ERR_CHIP_NAME;
 }
 
+int sensors_parse_chip_name(const char *name, sensors_chip_name *res)
+{
+	return parse_chip_name(NULL, name, res);
+}
+
+int sensors_arena_parse_chip_name(sensors_arena *arena, const char *name,
+				  sensors_chip_name *res)
+{
+	return parse_chip_name(arena, name, res);
+}
+
 int sensors_snprintf_chip_name(char *str, size_t size,
 			       const sensors_chip_name *chip)
 {
@@ -22,6 +22,7 @@
 #ifndef LIB_SENSORS_DATA_H
 #define LIB_SENSORS_DATA_H
 
+#include <stdint.h>
 #include "sensors.h"
 #include "general.h"
 
@@ -35,14 +36,21 @@ typedef enum sensors_operation {
 	sensors_negate, sensors_exp, sensors_log,
 } sensors_operation;
 
+/* Aggregate functions of virtual sensors */
+typedef enum sensors_aggregate {
+	sensors_max, sensors_min, sensors_sum, sensors_avg,
+} sensors_aggregate;
+
 /* An expression can have several forms */
 typedef enum sensors_expr_kind {
 	sensors_kind_val, sensors_kind_source, sensors_kind_var,
-	sensors_kind_sub
+	sensors_kind_sub, sensors_kind_aggr
 } sensors_expr_kind;
 
 /* An expression. It is either a floating point value, a variable name,
-   an operation on subexpressions, or the special value 'sub' } */
+   an operation on subexpressions, an aggregate function of the
+   subfeatures matched by a selector (virtual sensors only), or the
+   special value 'sub' } */
 struct sensors_expr;
 
 typedef struct sensors_subexpr {
@@ -51,12 +59,18 @@ typedef struct sensors_subexpr {
 	struct sensors_expr *sub2;
 } sensors_subexpr;
 
+typedef struct sensors_aggr {
+	sensors_aggregate op;
+	char *spec;		/* Selector, see sensors_compile_selector() */
+} sensors_aggr;
+
 typedef struct sensors_expr {
 	sensors_expr_kind kind;
 	union {
 		double val;
 		char *var;
 		sensors_subexpr subexpr;
+		sensors_aggr aggr;
 	} data;
 } sensors_expr;
 
@@ -97,6 +111,24 @@ typedef struct sensors_ignore {
 	sensors_config_line line;
 } sensors_ignore;
 
+/* Config file virtual declaration: a feature name of the virtual chip,
+   combined with an expression */
+typedef struct sensors_virtual {
+	char *name;
+	sensors_expr *value;
+	sensors_config_line line;
+} sensors_virtual;
+
+/* Config file group declaration: a group name, combined with the
+   selectors of the subfeatures it collects */
+typedef struct sensors_group {
+	char *name;
+	char **specs;
+	int specs_count;
+	int specs_max;
+	sensors_config_line line;
+} sensors_group;
+
 /* A list of chip names, used to represent a config file chips declaration */
 typedef struct sensors_chip_name_list {
 	sensors_chip_name *fits;
@@ -104,6 +136,10 @@ typedef struct sensors_chip_name_list {
 	int fits_max;
 } sensors_chip_name_list;
 
+/* What to do with a runtime-suspended device, see the suspended statement */
+#define SENSORS_SUSPENDED_WAKE	0	/* Read it, waking it up */
+#define SENSORS_SUSPENDED_SKIP	1	/* Don't read it */
+
 /* A config file chip block */
 typedef struct sensors_chip {
 	sensors_chip_name_list chips;
@@ -119,6 +155,7 @@ typedef struct sensors_chip {
 	sensors_ignore *ignores;
 	int ignores_count;
 	int ignores_max;
+	int suspended;		/* SENSORS_SUSPENDED_*, or -1 if not set */
 	sensors_config_line line;
 } sensors_chip;
 
@@ -130,43 +167,273 @@ typedef struct sensors_bus {
 	sensors_config_line line;
 } sensors_bus;
 
-/* Internal data about all features and subfeatures of a chip */
+/* Read state of a subfeature: the last value read, shared by the threads
+   which asked for it while the read was in flight, and the tracking of
+   failures. See read.c. */
+typedef struct sensors_read_slot {
+	unsigned int seq;	/* Odd while the value is being updated */
+	double value;
+	int err;
+	uint64_t at;		/* When value was read, CLOCK_MONOTONIC ns */
+	/* Protected by the read lock of the slot */
+	int inflight;
+	unsigned int done;	/* Number of reads completed */
+	int failures;		/* Consecutive failed reads */
+	int last_err;
+	unsigned int suppressed; /* Reads not attempted since the last one */
+	uint64_t retry_at;	/* Don't read before, CLOCK_MONOTONIC ns */
+	int fault;		/* The fault subfeature is set */
+	uint64_t fault_check_at;
+	double last_value;	/* Returned while the device is suspended */
+	uint64_t last_at;
+	/* Cached limit, protected by the read lock of the slot */
+	unsigned int limit_gen;	/* Generation of the chip limits */
+	uint64_t limit_until;	/* Read again after, CLOCK_MONOTONIC ns */
+	double limit_value;
+	uint64_t limit_at;
+	/* Protected by the burst lock of the chip */
+	int wanted;		/* Input read since the chip was found */
+	unsigned int burst_gen;	/* Burst which burst_value comes from */
+	double burst_value;
+	int burst_err;
+	uint64_t burst_at;
+	/* Set once */
+	int fault_nr;		/* Fault subfeature of an input, or -1 */
+	int input_nr;		/* Input of a fault subfeature, or -1 */
+} sensors_read_slot;
+
+/* Internal data about all features and subfeatures of a chip. Chips found
+   by sensors_init() are allocated from sensors_proc_arena. Chips added
+   later by hotplug have their own arena, so that they can be released
+   individually when they go away. */
 typedef struct sensors_chip_features {
 	struct sensors_chip_name chip;
 	struct sensors_feature *feature;
 	struct sensors_subfeature *subfeature;
 	int feature_count;
 	int subfeature_count;
+	sensors_arena arena;
+	/* Indexes of the configuration chip blocks which apply to this
+	   chip, latest first, as resolved by sensors_resolve_config() */
+	int *config_chips;
+	int config_chips_count;
+	/* One per subfeature */
+	sensors_read_slot *read_slots;
+	int read_coalesce;	/* Share the result of concurrent reads */
+	int read_backoff;	/* Max retry delay of failing reads in ms,
+				   0 if failures aren't tracked */
+	/* Inputs read together, NULL if disabled */
+	struct sensors_read_burst *burst;
+	/* Limits are cached, NULL if disabled */
+	struct sensors_limit_cache *limits;
+	/* power/runtime_status file of the device, if it must not be
+	   read while suspended, NULL otherwise */
+	const char *runtime_status;
+	/* The features which aren't ignored, as resolved by
+	   sensors_resolve_config() */
+	const sensors_feature **visible_features;
+	int visible_features_count;
+	/* Indexes of the alarm and fault subfeatures which aren't ignored,
+	   as resolved by sensors_resolve_config() */
+	int *alarms;
+	int alarm_count;
+	/* One per feature, set if it has no _label file */
+	unsigned char *label_absent;
+	/* One per subfeature, NULL if statistics are disabled */
+	sensors_stats *stats;
+	/* Last samples of the energy inputs, NULL if none, see energy.c */
+	struct sensors_energy *energy;
+	/* Value statistics of the subfeatures, NULL if disabled, see
+	   valstats.c */
+	struct sensors_valstats *valstats;
+	/* State of the virtual chip, NULL for detected chips, see
+	   virtual.c */
+	struct sensors_virtual_chip *virt;
 } sensors_chip_features;
 
-extern char **sensors_config_files;
-extern int sensors_config_files_count;
-extern int sensors_config_files_max;
+/* All the state of the library: the detected chips and the parsed
+   configuration. Applications only know it as an opaque sensors_context.
+   The functions of the library work on the context of the calling thread,
+   see sensors_context_enter(). */
+struct sensors_context {
+	/* Memory arenas: one for the data of the detected chips (names,
+	   paths, features and subfeatures), one for the data of the parsed
+	   configuration files (strings and expressions). Both are released
+	   by sensors_cleanup(). */
+	sensors_arena proc_arena;
+	sensors_arena config_arena;
+
+	/* Table of interned names: chip prefixes, feature and subfeature
+	   names of the detected chips, and the feature and subfeature names
+	   referenced by the configuration files. Names stored in the
+	   internal structures are always interned, so they can be compared
+	   by pointer. */
+	sensors_strtab names;
+
+	char **config_files;
+	int config_files_count;
+	int config_files_max;
+
+	sensors_chip *config_chips;
+	int config_chips_count;
+	int config_chips_subst;
+	int config_chips_max;
+
+	/* If set, chip blocks of the configuration files which can't apply
+	   to any detected chip are skipped while parsing */
+	int config_skip_absent;
+
+	/* Number of errors reported by the parser */
+	int config_parse_errors;
+
+	sensors_bus *config_busses;
+	int config_busses_count;
+	int config_busses_max;
+
+	/* Virtual sensors, which make up the virtual chip */
+	sensors_virtual *config_virtuals;
+	int config_virtuals_count;
+	int config_virtuals_max;
+
+	/* Groups, see sensors_compile_group() */
+	sensors_group *config_groups;
+	int config_groups_count;
+	int config_groups_max;
+
+	/* The detected chips. This is an array of pointers so that the chip
+	   names handed out to applications don't move when chips are added
+	   or removed. */
+	sensors_chip_features **proc_chips;
+	int proc_chips_count;
+	int proc_chips_max;
+
+	/* Chips removed from proc_chips, which readers may still use, see
+	   sensors_sysfs_remove_chip() */
+	sensors_chip_features **removed_chips;
+	int removed_chips_count;
+	int removed_chips_max;
+
+	sensors_bus *proc_bus;
+	int proc_bus_count;
+	int proc_bus_max;
+
+	/* Netlink socket for hotplug events, -1 if not open */
+	int hotplug_fd;
+
+	/* Changes whenever proc_chips changes, see sensors_chips_changed() */
+	unsigned int chips_gen;
+};
+
+/* The initial default context, used by applications which don't create
+   their own until sensors_reload() replaces it */
+extern sensors_context sensors_default_context;
+
+/* The context the library works on in the calling thread. It is set by
+   the sensors_ctx_*() functions while they run, otherwise it is NULL
+   outside of sensors_read_begin()/sensors_read_end(), which pin the
+   current default context. The functions of the public API call these
+   before using any other function of the library. */
+extern __thread sensors_context *sensors_current_context;
+
+/* Make ctx the current context of the calling thread. Returns the
+   previous one, to be given back to sensors_context_leave(). */
+sensors_context *sensors_context_enter(sensors_context *ctx);
+void sensors_context_leave(sensors_context *prev);
+
+/* Make a copy of the default context current, which only has its own
+   list of detected chips and table of names, for changes to that list
+   while other threads read the default context. sensors_update_end()
+   makes the copy the default context if the list changed, and frees the
+   removed chips once no reader can see them any longer. Otherwise the
+   copy is discarded, the default context is left untouched. Updates are
+   serialized with sensors_reload(). */
+void sensors_update_begin(void);
+void sensors_update_end(void);
+
+#define sensors_proc_arena	(sensors_current_context->proc_arena)
+#define sensors_config_arena	(sensors_current_context->config_arena)
+#define sensors_names		(sensors_current_context->names)
+
+#define sensors_intern_name(s) \
+	sensors_strtab_intern(&sensors_names, (s), strlen(s))
+#define sensors_intern_namen(s, n) \
+	sensors_strtab_intern(&sensors_names, (s), (n))
+
+#define sensors_config_files	(sensors_current_context->config_files)
+#define sensors_config_files_count \
+	(sensors_current_context->config_files_count)
+#define sensors_config_files_max \
+	(sensors_current_context->config_files_max)
 
 #define sensors_add_config_files(el) sensors_add_array_el( \
 	(el), &sensors_config_files, &sensors_config_files_count, \
 	&sensors_config_files_max, sizeof(char *))
 
-extern sensors_chip *sensors_config_chips;
-extern int sensors_config_chips_count;
-extern int sensors_config_chips_subst;
-extern int sensors_config_chips_max;
-
-extern sensors_bus *sensors_config_busses;
-extern int sensors_config_busses_count;
-extern int sensors_config_busses_max;
-
-extern sensors_chip_features *sensors_proc_chips;
-extern int sensors_proc_chips_count;
-extern int sensors_proc_chips_max;
+#define sensors_config_chips	(sensors_current_context->config_chips)
+#define sensors_config_chips_count \
+	(sensors_current_context->config_chips_count)
+#define sensors_config_chips_subst \
+	(sensors_current_context->config_chips_subst)
+#define sensors_config_chips_max \
+	(sensors_current_context->config_chips_max)
+#define sensors_config_skip_absent \
+	(sensors_current_context->config_skip_absent)
+#define sensors_config_parse_errors \
+	(sensors_current_context->config_parse_errors)
+
+#define sensors_add_config_chips(el) sensors_add_array_el( \
+	(el), &sensors_config_chips, &sensors_config_chips_count, \
+	&sensors_config_chips_max, sizeof(struct sensors_chip))
+
+#define sensors_config_busses	(sensors_current_context->config_busses)
+#define sensors_config_busses_count \
+	(sensors_current_context->config_busses_count)
+#define sensors_config_busses_max \
+	(sensors_current_context->config_busses_max)
+
+#define sensors_config_virtuals \
+	(sensors_current_context->config_virtuals)
+#define sensors_config_virtuals_count \
+	(sensors_current_context->config_virtuals_count)
+#define sensors_config_virtuals_max \
+	(sensors_current_context->config_virtuals_max)
+
+#define sensors_add_config_virtuals(el) sensors_add_array_el( \
+	(el), &sensors_config_virtuals, &sensors_config_virtuals_count, \
+	&sensors_config_virtuals_max, sizeof(struct sensors_virtual))
+
+#define sensors_config_groups	(sensors_current_context->config_groups)
+#define sensors_config_groups_count \
+	(sensors_current_context->config_groups_count)
+#define sensors_config_groups_max \
+	(sensors_current_context->config_groups_max)
+
+#define sensors_add_config_groups(el) sensors_add_array_el( \
+	(el), &sensors_config_groups, &sensors_config_groups_count, \
+	&sensors_config_groups_max, sizeof(struct sensors_group))
+
+#define sensors_proc_chips	(sensors_current_context->proc_chips)
+#define sensors_proc_chips_count \
+	(sensors_current_context->proc_chips_count)
+#define sensors_proc_chips_max	(sensors_current_context->proc_chips_max)
 
 #define sensors_add_proc_chips(el) sensors_add_array_el( \
 	(el), &sensors_proc_chips, &sensors_proc_chips_count,\
-	&sensors_proc_chips_max, sizeof(struct sensors_chip_features))
+	&sensors_proc_chips_max, sizeof(struct sensors_chip_features *))
 
-extern sensors_bus *sensors_proc_bus;
-extern int sensors_proc_bus_count;
-extern int sensors_proc_bus_max;
+#define sensors_removed_chips	(sensors_current_context->removed_chips)
+#define sensors_removed_chips_count \
+	(sensors_current_context->removed_chips_count)
+#define sensors_removed_chips_max \
+	(sensors_current_context->removed_chips_max)
+
+#define sensors_add_removed_chips(el) sensors_add_array_el( \
+	(el), &sensors_removed_chips, &sensors_removed_chips_count,\
+	&sensors_removed_chips_max, sizeof(struct sensors_chip_features *))
+
+#define sensors_proc_bus	(sensors_current_context->proc_bus)
+#define sensors_proc_bus_count	(sensors_current_context->proc_bus_count)
+#define sensors_proc_bus_max	(sensors_current_context->proc_bus_max)
 
 #define sensors_add_proc_bus(el) sensors_add_array_el( \
 	(el), &sensors_proc_bus, &sensors_proc_bus_count,\
@@ -177,6 +444,11 @@ extern int sensors_proc_bus_max;
 int sensors_substitute_busses(void);
 
 
+/* Same as sensors_parse_chip_name(), but the prefix is allocated from the
+   given arena. */
+int sensors_arena_parse_chip_name(sensors_arena *arena, const char *name,
+				  sensors_chip_name *res);
+
 /* Parse a bus id into its components. Returns 0 on success, a value from
    error.h on failure. */
 int sensors_parse_bus_id(const char *name, sensors_bus_id *bus);
@@ -0,0 +1,250 @@
+/*
+    energy.c - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "sensors.h"
+#include "data.h"
+#include "error.h"
+#include "access.h"
+#include "sysfs.h"
+#include "read.h"
+#include "energy.h"
+
+/*
+ * Energy counters: the energy inputs are cumulative, so the power drawn
+ * is the difference between two samples divided by the time between the
+ * reads. The last sample of each energy input of a chip is kept here,
+ * shared by all the callers, so that the power is computed over the
+ * interval since anybody last asked for it. Callers served by the same
+ * read (a shared read or a burst) get the same power.
+ *
+ * Counters may wrap around or be reset. Drivers report them in uJ, with
+ * 32 or 64-bit counters; a counter which ever went over 32 bits is a
+ * 64-bit one. A counter which went down is considered to have wrapped if
+ * it was in the upper half of its range and is now in the lower half, and
+ * the energy this implies is plausible: at most ENERGY_WRAP_FACTOR times
+ * the previous power over the elapsed time. Otherwise it was reset (the
+ * device was reset or the driver reloaded), and sampling starts over. A
+ * reset 64-bit counter which never went over 32 bits would otherwise pass
+ * for a wrapped 32-bit one, and report a huge power.
+ */
+#define ENERGY_NONE	0	/* No sample yet */
+#define ENERGY_FIRST	1	/* A sample, no power yet */
+#define ENERGY_POWER	2	/* A sample, and the power before it */
+
+#define ENERGY_WRAP_FACTOR	8
+
+struct sensors_energy_sample {
+	int nr;			/* Subfeature number */
+	int state;		/* ENERGY_* */
+	double value;		/* J */
+	double peak;		/* Largest value seen, J */
+	uint64_t at;		/* When it was read, CLOCK_MONOTONIC ns */
+	double power;		/* W, average up to the sample */
+};
+
+struct sensors_energy {
+	pthread_mutex_t mutex;
+	struct sensors_energy_sample *samples;
+	int count;
+};
+
+void sensors_energy_init_chip(sensors_chip_features *chip_features)
+{
+	struct sensors_energy *energy;
+	sensors_arena *arena;
+	int i, count = 0;
+
+	for (i = 0; i < chip_features->subfeature_count; i++)
+		if (chip_features->subfeature[i].type ==
+		    SENSORS_SUBFEATURE_ENERGY_INPUT)
+			count++;
+
+	chip_features->energy = NULL;
+	if (!count)
+		return;
+
+	arena = sensors_chip_arena(chip_features);
+	energy = sensors_arena_calloc(arena, 1, sizeof(*energy));
+	energy->samples = sensors_arena_calloc(arena, count,
+					       sizeof(*energy->samples));
+	pthread_mutex_init(&energy->mutex, NULL);
+
+	for (i = 0; i < chip_features->subfeature_count; i++)
+		if (chip_features->subfeature[i].type ==
+		    SENSORS_SUBFEATURE_ENERGY_INPUT)
+			energy->samples[energy->count++].nr = i;
+	chip_features->energy = energy;
+}
+
+static struct sensors_energy_sample *
+sensors_energy_lookup(const sensors_chip_features *chip_features,
+		      int subfeat_nr)
+{
+	struct sensors_energy *energy = chip_features->energy;
+	int i;
+
+	if (!energy)
+		return NULL;
+	for (i = 0; i < energy->count; i++)
+		if (energy->samples[i].nr == subfeat_nr)
+			return energy->samples + i;
+	return NULL;
+}
+
+/* Energy consumed since a sample, according to a counter value read at
+   at, in J, or <0 if the counter was reset */
+static double sensors_energy_delta(const struct sensors_energy_sample *sample,
+				   double value, uint64_t at)
+{
+	double range, p, v, delta;
+
+	if (value >= sample->value)
+		return value - sample->value;
+
+	p = sample->value * 1000000;
+	v = value * 1000000;
+	range = sample->peak * 1000000 < 4294967296.0 ? 4294967296.0 :
+							18446744073709551616.0;
+	if (p < range / 2 || v >= range / 2)
+		return -1;
+
+	delta = (range - p + v) / 1000000;
+	if (sample->state != ENERGY_POWER ||
+	    delta * 1000000000 / (at - sample->at) >
+	    ENERGY_WRAP_FACTOR * sample->power)
+		return -1;
+	return delta;
+}
+
+static int sensors_energy_power(const sensors_chip_features *chip_features,
+				int subfeat_nr, double *power, uint64_t *when)
+{
+	struct sensors_energy_sample *sample;
+	double value, delta;
+	int err = 0;
+
+	*power = 0;
+	*when = 0;
+	if (!(sample = sensors_energy_lookup(chip_features, subfeat_nr)))
+		return -SENSORS_ERR_NO_ENTRY;
+
+	/* The raw counter: compute statements would defeat wrap detection */
+	err = sensors_read_subfeature(chip_features,
+				      chip_features->subfeature + subfeat_nr,
+				      &value, when);
+	if (err)
+		return err;
+
+	pthread_mutex_lock(&chip_features->energy->mutex);
+	if (*when <= sample->at) {
+		/* The read of the last sample, or an older one which lost
+		   the race */
+		if (sample->state == ENERGY_POWER)
+			*power = sample->power;
+		else
+			err = -SENSORS_ERR_AGAIN;
+	} else {
+		delta = sample->state == ENERGY_NONE ? -1 :
+			sensors_energy_delta(sample, value, *when);
+		if (delta < 0) {
+			sample->state = ENERGY_FIRST;
+			err = -SENSORS_ERR_AGAIN;
+		} else {
+			sample->power = delta * 1000000000 /
+					(*when - sample->at);
+			sample->state = ENERGY_POWER;
+			*power = sample->power;
+		}
+		sample->value = value;
+		if (value > sample->peak)
+			sample->peak = value;
+		sample->at = *when;
+	}
+	pthread_mutex_unlock(&chip_features->energy->mutex);
+	return err;
+}
+
+static int sensors_energy_lookup_chip(const sensors_chip_name *name,
+				      const sensors_chip_features
+				      **chip_features)
+{
+	if (sensors_chip_name_has_wildcards(name))
+		return -SENSORS_ERR_WILDCARDS;
+	if (!(*chip_features = sensors_lookup_chip(name)))
+		return -SENSORS_ERR_NO_ENTRY;
+	return 0;
+}
+
+static int __sensors_get_energy_power(const sensors_chip_name *name,
+				      int subfeat_nr, double *power)
+{
+	const sensors_chip_features *chip_features;
+	uint64_t when;
+	int res;
+
+	if ((res = sensors_energy_lookup_chip(name, &chip_features)))
+		return res;
+	return sensors_energy_power(chip_features, subfeat_nr, power, &when);
+}
+
+int sensors_get_energy_power(const sensors_chip_name *name, int subfeat_nr,
+			     double *power)
+{
+	int res;
+
+	sensors_read_begin();
+	res = __sensors_get_energy_power(name, subfeat_nr, power);
+	sensors_read_end();
+	return res;
+}
+
+static int __sensors_get_energy_powers(const sensors_chip_name *name,
+				       sensors_reading *readings, int count)
+{
+	const sensors_chip_features *chip_features;
+	uint64_t when;
+	int i, res;
+
+	if ((res = sensors_energy_lookup_chip(name, &chip_features)))
+		return res;
+
+	for (i = 0; i < count; i++) {
+		readings[i].err = sensors_energy_power(chip_features,
+						       readings[i].subfeat_nr,
+						       &readings[i].value,
+						       &when);
+		readings[i].timestamp.tv_sec = when / 1000000000;
+		readings[i].timestamp.tv_nsec = when % 1000000000;
+	}
+	return 0;
+}
+
+int sensors_get_energy_powers(const sensors_chip_name *name,
+			      sensors_reading *readings, int count)
+{
+	int res;
+
+	sensors_read_begin();
+	res = __sensors_get_energy_powers(name, readings, count);
+	sensors_read_end();
+	return res;
+}
@@ -1,6 +1,5 @@
 /*
-    init.h - Part of libsensors, a Linux library for reading sensor data.
-    Copyright (C) 2007  Jean Delvare <khali@linux-fr.org>
+    energy.h - Part of libsensors, a Linux library for reading sensor data.
 
     This library is free software; you can redistribute it and/or
     modify it under the terms of the GNU Lesser General Public
@@ -18,11 +17,12 @@
     MA 02110-1301 USA.
 */
 
-#ifndef LIB_SENSORS_INIT_H
-#define LIB_SENSORS_INIT_H
+#ifndef LIB_SENSORS_ENERGY_H
+#define LIB_SENSORS_ENERGY_H
 
 #include "data.h"
 
-void sensors_free_expr(sensors_expr *expr);
+/* Set up the samples of the energy counters of a detected chip */
+void sensors_energy_init_chip(sensors_chip_features *chip_features);
 
-#endif /* def LIB_SENSORS_INIT_H */
+#endif /* def LIB_SENSORS_ENERGY_H */
@@ -49,6 +49,9 @@ static const char *errorlist[] = {
 	/* SENSORS_ERR_ACCESS_W  */ "Can't write",
 	/* SENSORS_ERR_IO        */ "I/O error",
 	/* SENSORS_ERR_RECURSION */ "Evaluation recurses too deep",
+	/* SENSORS_ERR_FAULT     */ "Sensor fault",
+	/* SENSORS_ERR_SUSPENDED */ "Device suspended",
+	/* SENSORS_ERR_AGAIN     */ "Not enough samples yet",
 };
 
 const char *sensors_strerror(int errnum)
@@ -33,6 +33,9 @@
 #define SENSORS_ERR_ACCESS_W	9 /* Can't write */
 #define SENSORS_ERR_IO		10 /* I/O error */
 #define SENSORS_ERR_RECURSION	11 /* Evaluation recurses too deep */
+#define SENSORS_ERR_FAULT	12 /* Sensor fault */
+#define SENSORS_ERR_SUSPENDED	13 /* Device suspended */
+#define SENSORS_ERR_AGAIN	14 /* Not enough samples yet */
 
 #ifdef __cplusplus
 extern "C" {
@@ -83,3 +83,192 @@ void sensors_add_array_els(const void *els, int nr_els, void *list,
 	memcpy(((char *)*my_list) + *num_el * el_size, els, el_size * nr_els);
 	*num_el += nr_els;
 }
+
+/* Arena blocks are page-sized unless a single allocation needs more.
+   Allocations are aligned so that any of our structures can be stored. */
+#define ARENA_BLOCK_SIZE	4096
+#define ARENA_ALIGN		(sizeof(double) > sizeof(void *) ? \
+				 sizeof(double) : sizeof(void *))
+#define ARENA_ROUND(n)	(((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+struct sensors_arena_block {
+	struct sensors_arena_block *prev;
+	size_t size;
+	size_t used;
+};
+
+#define ARENA_HEADER_SIZE	ARENA_ROUND(sizeof(struct sensors_arena_block))
+#define ARENA_BLOCK_DATA(b)	((char *)(b) + ARENA_HEADER_SIZE)
+
+void *sensors_arena_alloc(sensors_arena *arena, size_t size)
+{
+	struct sensors_arena_block *block = arena->block;
+	void *p;
+
+	size = ARENA_ROUND(size ? size : 1);
+	if (!block || block->used + size > block->size) {
+		size_t block_size = size > ARENA_BLOCK_SIZE ?
+				    size : ARENA_BLOCK_SIZE;
+
+		block = malloc(ARENA_HEADER_SIZE + block_size);
+		if (!block)
+			sensors_fatal_error(__func__, "Allocating arena block");
+		block->prev = arena->block;
+		block->size = block_size;
+		block->used = 0;
+		arena->block = block;
+	}
+
+	p = ARENA_BLOCK_DATA(block) + block->used;
+	block->used += size;
+	return p;
+}
+
+void *sensors_arena_calloc(sensors_arena *arena, size_t nmemb, size_t size)
+{
+	void *p;
+
+	p = sensors_arena_alloc(arena, nmemb * size);
+	memset(p, 0, nmemb * size);
+	return p;
+}
+
+char *sensors_arena_strndup(sensors_arena *arena, const char *s, size_t n)
+{
+	char *p;
+
+	n = strnlen(s, n);
+	p = sensors_arena_alloc(arena, n + 1);
+	memcpy(p, s, n);
+	p[n] = '\0';
+	return p;
+}
+
+char *sensors_arena_strdup(sensors_arena *arena, const char *s)
+{
+	return sensors_arena_strndup(arena, s, strlen(s));
+}
+
+void sensors_arena_get_mark(const sensors_arena *arena,
+			    sensors_arena_mark *mark)
+{
+	mark->block = arena->block;
+	mark->used = arena->block ? arena->block->used : 0;
+}
+
+void sensors_arena_rewind(sensors_arena *arena,
+			  const sensors_arena_mark *mark)
+{
+	struct sensors_arena_block *block;
+
+	while (arena->block != mark->block) {
+		block = arena->block;
+		arena->block = block->prev;
+		free(block);
+	}
+	if (arena->block)
+		arena->block->used = mark->used;
+}
+
+void sensors_arena_free(sensors_arena *arena)
+{
+	struct sensors_arena_block *block;
+
+	while ((block = arena->block)) {
+		arena->block = block->prev;
+		free(block);
+	}
+}
+
+void sensors_arena_merge(sensors_arena *dst, sensors_arena *src)
+{
+	struct sensors_arena_block *oldest;
+
+	if (!src->block)
+		return;
+	if (!dst->block) {
+		dst->block = src->block;
+		src->block = NULL;
+		return;
+	}
+
+	/* Slip the blocks of src under the current block of dst, so that
+	   the latter remains the one we allocate from */
+	for (oldest = src->block; oldest->prev; oldest = oldest->prev)
+		;
+	oldest->prev = dst->block->prev;
+	dst->block->prev = src->block;
+	src->block = NULL;
+}
+
+#define STRTAB_MIN_SIZE	256
+
+/* FNV-1a */
+static unsigned int strtab_hash(const char *s, size_t n)
+{
+	unsigned int h = 2166136261U;
+
+	while (n-- && *s) {
+		h ^= (unsigned char)*s++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/* Return the slot where s is, or where it should be inserted */
+static char **strtab_find(const sensors_strtab *tab, const char *s, size_t n)
+{
+	unsigned int i;
+	char **slot;
+
+	i = strtab_hash(s, n) & (tab->size - 1);
+	for (;;) {
+		slot = &tab->slots[i];
+		if (!*slot || (!strncmp(*slot, s, n) && (*slot)[n] == '\0'))
+			return slot;
+		i = (i + 1) & (tab->size - 1);
+	}
+}
+
+static void strtab_grow(sensors_strtab *tab)
+{
+	char **old_slots = tab->slots;
+	unsigned int i, old_size = tab->size;
+
+	tab->size = old_size ? old_size * 2 : STRTAB_MIN_SIZE;
+	tab->slots = calloc(tab->size, sizeof(char *));
+	if (!tab->slots)
+		sensors_fatal_error(__func__, "Allocating string table");
+
+	for (i = 0; i < old_size; i++)
+		if (old_slots[i])
+			*strtab_find(tab, old_slots[i],
+				     strlen(old_slots[i])) = old_slots[i];
+	free(old_slots);
+}
+
+char *sensors_strtab_intern(sensors_strtab *tab, const char *s, size_t n)
+{
+	char **slot;
+
+	n = strnlen(s, n);
+
+	/* Keep the load factor under 1/2 */
+	if ((tab->count + 1) * 2 > tab->size)
+		strtab_grow(tab);
+
+	slot = strtab_find(tab, s, n);
+	if (!*slot) {
+		*slot = sensors_arena_strndup(&tab->arena, s, n);
+		tab->count++;
+	}
+	return *slot;
+}
+
+void sensors_strtab_free(sensors_strtab *tab)
+{
+	free(tab->slots);
+	tab->slots = NULL;
+	tab->size = tab->count = 0;
+	sensors_arena_free(&tab->arena);
+}
@@ -21,6 +21,8 @@
 #ifndef LIB_SENSORS_GENERAL
 #define LIB_SENSORS_GENERAL
 
+#include <stddef.h>
+
 /* These are general purpose functions. They allow you to use variable-
    length arrays, which are extended automatically. A distinction is
    made between the current number of elements and the maximum number.
@@ -34,6 +36,48 @@ void sensors_add_array_el(const void *el, void *list, int *num_el,
 void sensors_add_array_els(const void *els, int nr_els, void *list,
 			   int *num_el, int *max_el, int el_size);
 
+/* A bump-pointer memory arena. Small allocations are carved out of
+   larger blocks, which are all released at once by sensors_arena_free().
+   Individual allocations can't be freed, but the arena can be rewound to
+   a previously taken mark, which releases everything allocated since. */
+struct sensors_arena_block;
+
+typedef struct sensors_arena {
+	struct sensors_arena_block *block;	/* Most recent block */
+} sensors_arena;
+
+typedef struct sensors_arena_mark {
+	struct sensors_arena_block *block;
+	size_t used;
+} sensors_arena_mark;
+
+void *sensors_arena_alloc(sensors_arena *arena, size_t size);
+void *sensors_arena_calloc(sensors_arena *arena, size_t nmemb, size_t size);
+char *sensors_arena_strdup(sensors_arena *arena, const char *s);
+char *sensors_arena_strndup(sensors_arena *arena, const char *s, size_t n);
+void sensors_arena_get_mark(const sensors_arena *arena,
+			    sensors_arena_mark *mark);
+void sensors_arena_rewind(sensors_arena *arena,
+			  const sensors_arena_mark *mark);
+void sensors_arena_free(sensors_arena *arena);
+/* Move all the memory of src to dst, leaving src empty */
+void sensors_arena_merge(sensors_arena *dst, sensors_arena *src);
+
+/* A string table. Each distinct string is stored once, so interned strings
+   can be compared by pointer instead of with strcmp(). The strings are
+   released all at once by sensors_strtab_free(). */
+typedef struct sensors_strtab {
+	char **slots;
+	unsigned int size;	/* Power of 2, or 0 if empty */
+	unsigned int count;
+	sensors_arena arena;
+} sensors_strtab;
+
+/* Return the interned copy of the first n characters of s, adding it to
+   the table if needed */
+char *sensors_strtab_intern(sensors_strtab *tab, const char *s, size_t n);
+void sensors_strtab_free(sensors_strtab *tab);
+
 #define ARRAY_SIZE(arr)	(int)(sizeof(arr) / sizeof((arr)[0]))
 
 #endif /* LIB_SENSORS_GENERAL */
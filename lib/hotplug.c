@@ -0,0 +1,281 @@
+/*
+    hotplug.c - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+/* this define needed for SOCK_NONBLOCK and SOCK_CLOEXEC */
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <dirent.h>
+#include <limits.h>
+#include "sensors.h"
+#include "data.h"
+#include "error.h"
+#include "sysfs.h"
+#include "access.h"
+#include "read.h"
+#include "stats.h"
+#include "energy.h"
+#include "valstats.h"
+
+/* The kernel sends its uevents to this multicast group */
+#define UEVENT_KERNEL_GROUP	1
+#define UEVENT_BUFFER_SIZE	4096
+
+/* Each context listens on its own socket */
+#define hotplug_fd (sensors_current_context->hotplug_fd)
+
+static int __sensors_hotplug_open(void)
+{
+	struct sockaddr_nl addr;
+	int fd;
+
+	if (hotplug_fd >= 0)
+		return hotplug_fd;
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		    NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		return -SENSORS_ERR_KERNEL;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = UEVENT_KERNEL_GROUP;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -SENSORS_ERR_KERNEL;
+	}
+
+	hotplug_fd = fd;
+	return fd;
+}
+
+int sensors_hotplug_open(void)
+{
+	int res;
+
+	sensors_read_begin();
+	res = __sensors_hotplug_open();
+	sensors_read_end();
+	return res;
+}
+
+void sensors_hotplug_close(void)
+{
+	sensors_read_begin();
+	if (hotplug_fd >= 0) {
+		close(hotplug_fd);
+		hotplug_fd = -1;
+	}
+	sensors_read_end();
+}
+
+static int hotplug_add(const char *classdev, sensors_hotplug_callback cb,
+		       void *data)
+{
+	sensors_chip_features *chip;
+
+	/* We may already know it, if it appeared while we were scanning */
+	if (sensors_sysfs_find_hwmon(classdev) >= 0)
+		return 0;
+
+	chip = sensors_sysfs_add_hwmon(classdev);
+	if (!chip)
+		return 0;
+	sensors_resolve_config(chip);
+	sensors_read_init_chip(chip);
+	sensors_stats_init_chip(chip);
+	sensors_energy_init_chip(chip);
+	sensors_valstats_init_chip(chip);
+	sensors_chips_changed();
+
+	if (cb)
+		cb(&chip->chip, SENSORS_HOTPLUG_ADDED, data);
+	return 1;
+}
+
+static void hotplug_remove_chip(int nr, sensors_hotplug_callback cb,
+				void *data)
+{
+	/* Let the application forget about the chip before it goes away */
+	if (cb)
+		cb(&sensors_proc_chips[nr]->chip, SENSORS_HOTPLUG_REMOVED,
+		   data);
+	sensors_sysfs_remove_chip(nr);
+}
+
+static int hotplug_remove(const char *classdev, sensors_hotplug_callback cb,
+			  void *data)
+{
+	int nr;
+
+	nr = sensors_sysfs_find_hwmon(classdev);
+	if (nr < 0)
+		return 0;
+
+	hotplug_remove_chip(nr, cb, data);
+	return 1;
+}
+
+/* Some events were lost, compare our list of chips with sysfs */
+static int hotplug_resync(sensors_hotplug_callback cb, void *data)
+{
+	char path[NAME_MAX];
+	struct stat st;
+	struct dirent *ent;
+	DIR *dir;
+	int i, changes = 0;
+
+	for (i = sensors_proc_chips_count - 1; i >= 0; i--) {
+		/* The virtual chip isn't in sysfs */
+		if (sensors_proc_chips[i]->virt)
+			continue;
+		if (stat(sensors_proc_chips[i]->chip.path, &st) < 0) {
+			hotplug_remove_chip(i, cb, data);
+			changes++;
+		}
+	}
+
+	snprintf(path, NAME_MAX, "%s/class/hwmon", sensors_sysfs_mount);
+	dir = opendir(path);
+	if (!dir)
+		return changes;
+
+	while ((ent = readdir(dir)) != NULL) {
+		if (ent->d_name[0] == '.')
+			continue;
+		changes += hotplug_add(ent->d_name, cb, data);
+	}
+
+	closedir(dir);
+	return changes;
+}
+
+/* Messages look like "add@/devices/.../hwmon/hwmon3\0ACTION=add\0..." */
+static int hotplug_handle_msg(const char *buf, size_t len,
+			      sensors_hotplug_callback cb, void *data)
+{
+	const char *action = NULL, *devpath = NULL, *subsystem = NULL;
+	const char *classdev, *key;
+	size_t offset;
+
+	/* Skip the summary line, then read the KEY=VALUE pairs */
+	offset = strnlen(buf, len) + 1;
+	while (offset < len) {
+		key = buf + offset;
+		offset += strnlen(key, len - offset) + 1;
+		if (offset > len)
+			break;
+
+		if (!strncmp(key, "ACTION=", 7))
+			action = key + 7;
+		else if (!strncmp(key, "DEVPATH=", 8))
+			devpath = key + 8;
+		else if (!strncmp(key, "SUBSYSTEM=", 10))
+			subsystem = key + 10;
+	}
+
+	if (!action || !devpath || !subsystem || strcmp(subsystem, "hwmon"))
+		return 0;
+
+	classdev = strrchr(devpath, '/');
+	if (!classdev || !*++classdev)
+		return 0;
+
+	if (!strcmp(action, "add"))
+		return hotplug_add(classdev, cb, data);
+	if (!strcmp(action, "remove"))
+		return hotplug_remove(classdev, cb, data);
+	return 0;
+}
+
+static int __sensors_hotplug_process(sensors_hotplug_callback cb,
+				     void *data)
+{
+	char buf[UEVENT_BUFFER_SIZE];
+	struct sockaddr_nl addr;
+	struct iovec iov;
+	struct msghdr msg;
+	ssize_t len;
+	int changes = 0, resync = 0;
+
+	if (hotplug_fd < 0)
+		return -SENSORS_ERR_ACCESS_R;
+
+	for (;;) {
+		iov.iov_base = buf;
+		iov.iov_len = sizeof(buf) - 1;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &addr;
+		msg.msg_namelen = sizeof(addr);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+
+		len = recvmsg(hotplug_fd, &msg, MSG_DONTWAIT);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == ENOBUFS) {
+				/* The socket buffer overflowed */
+				resync = 1;
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -SENSORS_ERR_KERNEL;
+		}
+
+		/* Only trust messages coming from the kernel */
+		if (addr.nl_pid != 0 || (msg.msg_flags & MSG_TRUNC))
+			continue;
+
+		buf[len] = '\0';
+		changes += hotplug_handle_msg(buf, len, cb, data);
+	}
+
+	if (resync)
+		changes += hotplug_resync(cb, data);
+
+	return changes;
+}
+
+int sensors_hotplug_process(sensors_hotplug_callback cb, void *data)
+{
+	int res;
+
+	/* A sensors_ctx_*() function is running, the caller has exclusive
+	   access to its context */
+	if (sensors_current_context) {
+		res = __sensors_hotplug_process(cb, data);
+		sensors_sysfs_free_removed_chips();
+		return res;
+	}
+
+	/* Other threads may be reading the default context */
+	sensors_update_begin();
+	res = __sensors_hotplug_process(cb, data);
+	sensors_update_end();
+	return res;
+}
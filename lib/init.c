@@ -38,51 +38,43 @@
 #include "conf.h"
 #include "sysfs.h"
 #include "scanner.h"
-#include "init.h"
+#include "cache.h"
+#include "conf-cache.h"
+#include "read.h"
+#include "stats.h"
+#include "energy.h"
+#include "valstats.h"
+#include "virtual.h"
+#include "probes.h"
 
 #define DEFAULT_CONFIG_FILE	ETCDIR "/sensors3.conf"
 #define ALT_CONFIG_FILE		ETCDIR "/sensors.conf"
 #define DEFAULT_CONFIG_DIR	ETCDIR "/sensors.d"
 
 /* Wrapper around sensors_yyparse(), which clears the locale so that
-   the decimal numbers are always parsed properly. */
-static int sensors_parse(void)
+   the decimal numbers are always parsed properly. Only the locale of the
+   calling thread is changed, so that other threads are not affected. */
+static int sensors_parse(sensors_scanner *scanner)
 {
 	int res;
-	char *locale;
+	locale_t c_locale, locale;
 
-	/* Remember the current locale and clear it */
-	locale = setlocale(LC_ALL, NULL);
-	if (locale) {
-		locale = strdup(locale);
-		if (!locale)
-			sensors_fatal_error(__func__, "Out of memory");
+	c_locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+	if (!c_locale)
+		sensors_fatal_error(__func__, "Out of memory");
+	locale = uselocale(c_locale);
 
-		setlocale(LC_ALL, "C");
-	}
-
-	res = sensors_yyparse();
+	res = sensors_yyparse(scanner);
 
 	/* Restore the old locale */
-	if (locale) {
-		setlocale(LC_ALL, locale);
-		free(locale);
-	}
+	uselocale(locale);
+	freelocale(c_locale);
 
 	return res;
 }
 
-static void free_bus(sensors_bus *bus)
-{
-	free(bus->adapter);
-}
-
 static void free_config_busses(void)
 {
-	int i;
-
-	for (i = 0; i < sensors_config_busses_count; i++)
-		free_bus(&sensors_config_busses[i]);
 	free(sensors_config_busses);
 	sensors_config_busses = NULL;
 	sensors_config_busses_count = sensors_config_busses_max = 0;
@@ -92,22 +84,23 @@ static int parse_config(FILE *input, const char *name)
 {
 	int err;
 	char *name_copy;
+	sensors_scanner scanner;
 
 	if (name) {
 		/* Record configuration file name for error reporting */
-		name_copy = strdup(name);
-		if (!name_copy)
-			sensors_fatal_error(__func__, "Out of memory");
+		name_copy = sensors_arena_strdup(&sensors_config_arena, name);
 		sensors_add_config_files(&name_copy);
 	} else
 		name_copy = NULL;
 
-	if (sensors_scanner_init(input, name_copy)) {
+	if (sensors_scanner_init(&scanner, input, name_copy)) {
 		err = -SENSORS_ERR_PARSE;
 		goto exit_cleanup;
 	}
-	err = sensors_parse();
-	sensors_scanner_exit();
+	SENSORS_PROBE1(config_parse_start, name);
+	err = sensors_parse(&scanner);
+	SENSORS_PROBE2(config_parse_done, name, err);
+	sensors_scanner_exit(&scanner);
 	if (err) {
 		err = -SENSORS_ERR_PARSE;
 		goto exit_cleanup;
@@ -175,133 +168,199 @@ static int add_config_from_dir(const char *dir)
 	return res;
 }
 
-int sensors_init(FILE *input)
+/* Discover busses and chips, from the cache file if there is a valid one */
+static int read_sysfs(void)
 {
+	const char *cache;
+	uint64_t fingerprint = 0;
 	int res;
 
-	if (!sensors_init_sysfs())
-		return -SENSORS_ERR_KERNEL;
-	if ((res = sensors_read_sysfs_bus()) ||
-	    (res = sensors_read_sysfs_chips()))
-		goto exit_cleanup;
+	cache = sensors_cache_file();
+	if (cache) {
+		/* Take the fingerprint before scanning, so that any change
+		   happening while we scan invalidates the saved cache */
+		fingerprint = sensors_sysfs_fingerprint();
+		if (!sensors_cache_load(cache, fingerprint))
+			return 0;
+	}
 
-	if (input) {
-		res = parse_config(input, NULL);
-		if (res)
-			goto exit_cleanup;
-	} else {
-		const char* name;
+	SENSORS_PROBE(bus_scan_start);
+	res = sensors_read_sysfs_bus();
+	SENSORS_PROBE2(bus_scan_done, res, sensors_proc_bus_count);
+	if (res)
+		return res;
 
-		/* No configuration provided, use default */
-		input = fopen(name = DEFAULT_CONFIG_FILE, "r");
-		if (!input && errno == ENOENT)
-			input = fopen(name = ALT_CONFIG_FILE, "r");
-		if (input) {
-			res = parse_config(input, name);
-			fclose(input);
-			if (res)
-				goto exit_cleanup;
+	SENSORS_PROBE(chip_scan_start);
+	res = sensors_read_sysfs_chips();
+	SENSORS_PROBE2(chip_scan_done, res, sensors_proc_chips_count);
+	if (res)
+		return res;
 
-		} else if (errno != ENOENT) {
-			sensors_parse_error_wfn(strerror(errno), name, 0);
-			res = -SENSORS_ERR_PARSE;
-			goto exit_cleanup;
-		}
+	if (cache)
+		sensors_cache_save(cache, fingerprint);
+	return 0;
+}
 
-		/* Also check for files in default directory */
-		res = add_config_from_dir(DEFAULT_CONFIG_DIR);
+static int parse_default_config(void)
+{
+	const char* name;
+	FILE *input;
+	int res;
+
+	input = fopen(name = DEFAULT_CONFIG_FILE, "r");
+	if (!input && errno == ENOENT)
+		input = fopen(name = ALT_CONFIG_FILE, "r");
+	if (input) {
+		res = parse_config(input, name);
+		fclose(input);
 		if (res)
-			goto exit_cleanup;
-	}
+			return res;
 
-	return 0;
+	} else if (errno != ENOENT) {
+		sensors_parse_error_wfn(strerror(errno), name, 0);
+		return -SENSORS_ERR_PARSE;
+	}
 
-exit_cleanup:
-	sensors_cleanup();
-	return res;
+	/* Also check for files in default directory */
+	return add_config_from_dir(DEFAULT_CONFIG_DIR);
 }
 
-static void free_chip_name(sensors_chip_name *name)
+/* Identify everything the parsed default configuration depends on */
+static uint64_t config_fingerprint(void)
 {
-	free(name->prefix);
-	free(name->path);
+	uint64_t fingerprint;
+	struct dirent **namelist;
+	char path[PATH_MAX];
+	int count, i;
+
+	fingerprint = sensors_config_cache_fingerprint();
+	sensors_config_cache_add_file(&fingerprint, DEFAULT_CONFIG_FILE);
+	sensors_config_cache_add_file(&fingerprint, ALT_CONFIG_FILE);
+	sensors_config_cache_add_file(&fingerprint, DEFAULT_CONFIG_DIR);
+
+	count = scandir(DEFAULT_CONFIG_DIR, &namelist, config_file_filter,
+			alphasort);
+	for (i = 0; i < count; i++) {
+		snprintf(path, sizeof(path), "%s/%s", DEFAULT_CONFIG_DIR,
+			 namelist[i]->d_name);
+		sensors_config_cache_add_file(&fingerprint, path);
+		free(namelist[i]);
+	}
+	if (count > 0)
+		free(namelist);
+
+	return fingerprint;
 }
 
-static void free_chip_features(sensors_chip_features *features)
+/* Load the default configuration, from the cache file if there is a valid
+   one */
+static int read_default_config(void)
 {
-	int i;
+	const char *cache;
+	uint64_t fingerprint;
+	int res;
 
-	for (i = 0; i < features->subfeature_count; i++)
-		free(features->subfeature[i].name);
-	free(features->subfeature);
-	for (i = 0; i < features->feature_count; i++)
-		free(features->feature[i].name);
-	free(features->feature);
+	cache = sensors_config_cache_file();
+	if (!cache)
+		return parse_default_config();
+
+	/* Take the fingerprint before parsing, so that any change
+	   happening while we parse invalidates the saved cache */
+	fingerprint = config_fingerprint();
+	if (!sensors_config_cache_load(cache, fingerprint))
+		return 0;
+
+	/* Errors would not be reported again when loading from the cache,
+	   so only save a configuration which parsed cleanly */
+	sensors_config_parse_errors = 0;
+	res = parse_default_config();
+
+	if (!res && !sensors_config_parse_errors)
+		sensors_config_cache_save(cache, fingerprint);
+	return res;
 }
 
-static void free_label(sensors_label *label)
+/* -1 until set by the application, then the environment decides */
+static int skip_absent_chips = -1;
+
+int sensors_set_skip_absent_chips(int skip)
 {
-	free(label->name);
-	free(label->value);
+	skip_absent_chips = !!skip;
+	return 0;
 }
 
-void sensors_free_expr(sensors_expr *expr)
+static int __sensors_init(FILE *input)
 {
-	if (expr->kind == sensors_kind_var)
-		free(expr->data.var);
-	else if (expr->kind == sensors_kind_sub) {
-		if (expr->data.subexpr.sub1)
-			sensors_free_expr(expr->data.subexpr.sub1);
-		if (expr->data.subexpr.sub2)
-			sensors_free_expr(expr->data.subexpr.sub2);
+	const char *env;
+	int res, i;
+
+	sensors_stats_init();
+
+	if (!sensors_init_sysfs())
+		return -SENSORS_ERR_KERNEL;
+	if ((res = read_sysfs()))
+		goto exit_cleanup;
+
+	if (skip_absent_chips < 0) {
+		env = getenv("LIBSENSORS_SKIP_ABSENT_CHIPS");
+		sensors_config_skip_absent = env && atoi(env) > 0;
+	} else
+		sensors_config_skip_absent = skip_absent_chips;
+
+	if (input) {
+		res = parse_config(input, NULL);
+	} else {
+		/* No configuration provided, use default */
+		res = read_default_config();
 	}
-	free(expr);
-}
+	if (res)
+		goto exit_cleanup;
 
-static void free_set(sensors_set *set)
-{
-	free(set->name);
-	sensors_free_expr(set->value);
-}
+	sensors_virtual_add_chip();
+	for (i = 0; i < sensors_proc_chips_count; i++) {
+		sensors_resolve_config(sensors_proc_chips[i]);
+		sensors_read_init_chip(sensors_proc_chips[i]);
+		sensors_stats_init_chip(sensors_proc_chips[i]);
+		sensors_energy_init_chip(sensors_proc_chips[i]);
+		sensors_valstats_init_chip(sensors_proc_chips[i]);
+	}
+	sensors_chips_changed();
 
-static void free_compute(sensors_compute *compute)
-{
-	free(compute->name);
-	sensors_free_expr(compute->from_proc);
-	sensors_free_expr(compute->to_proc);
+	return 0;
+
+exit_cleanup:
+	sensors_cleanup();
+	return res;
 }
 
-static void free_ignore(sensors_ignore *ignore)
+int sensors_init(FILE *input)
 {
-	free(ignore->name);
+	int res;
+
+	sensors_read_begin();
+	SENSORS_PROBE(init_start);
+	res = __sensors_init(input);
+	SENSORS_PROBE1(init_done, res);
+	sensors_read_end();
+	return res;
 }
 
+/* Strings, expressions and feature tables live in the arenas, only the
+   arrays themselves need to be freed here */
 static void free_chip(sensors_chip *chip)
 {
-	int i;
-
-	for (i = 0; i < chip->chips.fits_count; i++)
-		free_chip_name(&chip->chips.fits[i]);
 	free(chip->chips.fits);
 	chip->chips.fits_count = chip->chips.fits_max = 0;
 
-	for (i = 0; i < chip->labels_count; i++)
-		free_label(&chip->labels[i]);
 	free(chip->labels);
 	chip->labels_count = chip->labels_max = 0;
 
-	for (i = 0; i < chip->sets_count; i++)
-		free_set(&chip->sets[i]);
 	free(chip->sets);
 	chip->sets_count = chip->sets_max = 0;
 
-	for (i = 0; i < chip->computes_count; i++)
-		free_compute(&chip->computes[i]);
 	free(chip->computes);
 	chip->computes_count = chip->computes_max = 0;
 
-	for (i = 0; i < chip->ignores_count; i++)
-		free_ignore(&chip->ignores[i]);
 	free(chip->ignores);
 	chip->ignores_count = chip->ignores_max = 0;
 }
@@ -310,10 +369,15 @@ void sensors_cleanup(void)
 {
 	int i;
 
-	for (i = 0; i < sensors_proc_chips_count; i++) {
-		free_chip_name(&sensors_proc_chips[i].chip);
-		free_chip_features(&sensors_proc_chips[i]);
+	sensors_read_begin();
+	sensors_hotplug_close();
+
+	/* Chips which were hotplugged have their own memory */
+	for (i = sensors_proc_chips_count - 1; i >= 0; i--) {
+		sensors_virtual_free_chip(sensors_proc_chips[i]);
+		sensors_sysfs_remove_chip(i);
 	}
+	sensors_sysfs_free_removed_chips();
 	free(sensors_proc_chips);
 	sensors_proc_chips = NULL;
 	sensors_proc_chips_count = sensors_proc_chips_max = 0;
@@ -325,15 +389,26 @@ void sensors_cleanup(void)
 	sensors_config_chips_count = sensors_config_chips_max = 0;
 	sensors_config_chips_subst = 0;
 
-	for (i = 0; i < sensors_proc_bus_count; i++)
-		free_bus(&sensors_proc_bus[i]);
+	free(sensors_config_virtuals);
+	sensors_config_virtuals = NULL;
+	sensors_config_virtuals_count = sensors_config_virtuals_max = 0;
+
+	for (i = 0; i < sensors_config_groups_count; i++)
+		free(sensors_config_groups[i].specs);
+	free(sensors_config_groups);
+	sensors_config_groups = NULL;
+	sensors_config_groups_count = sensors_config_groups_max = 0;
+
 	free(sensors_proc_bus);
 	sensors_proc_bus = NULL;
 	sensors_proc_bus_count = sensors_proc_bus_max = 0;
 
-	for (i = 0; i < sensors_config_files_count; i++)
-		free(sensors_config_files[i]);
 	free(sensors_config_files);
 	sensors_config_files = NULL;
 	sensors_config_files_count = sensors_config_files_max = 0;
+
+	sensors_arena_free(&sensors_proc_arena);
+	sensors_arena_free(&sensors_config_arena);
+	sensors_strtab_free(&sensors_names);
+	sensors_read_end();
 }
@@ -0,0 +1,51 @@
+/*
+    probes.h - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#ifndef LIB_SENSORS_PROBES_H
+#define LIB_SENSORS_PROBES_H
+
+/* Static probes for tracers such as perf, bpftrace and systemtap, under
+   the "libsensors" provider. They cost a single nop when no tracer is
+   attached. They are only built in if <sys/sdt.h> (from systemtap) is
+   available, and SENSORS_NO_PROBES isn't defined. The probes are listed
+   in libsensors(3). */
+#if !defined(SENSORS_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SENSORS_HAVE_PROBES
+#endif
+#endif
+
+#ifdef SENSORS_HAVE_PROBES
+#define SENSORS_PROBE(name)		STAP_PROBE(libsensors, name)
+#define SENSORS_PROBE1(name, a)		STAP_PROBE1(libsensors, name, a)
+#define SENSORS_PROBE2(name, a, b)	STAP_PROBE2(libsensors, name, a, b)
+#define SENSORS_PROBE3(name, a, b, c) \
+	STAP_PROBE3(libsensors, name, a, b, c)
+#define SENSORS_PROBE4(name, a, b, c, d) \
+	STAP_PROBE4(libsensors, name, a, b, c, d)
+#else
+#define SENSORS_PROBE(name)			do { } while (0)
+#define SENSORS_PROBE1(name, a)			do { } while (0)
+#define SENSORS_PROBE2(name, a, b)		do { } while (0)
+#define SENSORS_PROBE3(name, a, b, c)		do { } while (0)
+#define SENSORS_PROBE4(name, a, b, c, d)	do { } while (0)
+#endif
+
+#endif /* def LIB_SENSORS_PROBES_H */
@@ -0,0 +1,900 @@
+/*
+    read.c - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include "sensors.h"
+#include "data.h"
+#include "error.h"
+#include "access.h"
+#include "sysfs.h"
+#include "read.h"
+#include "stats.h"
+#include "virtual.h"
+
+/*
+ * Single-flight reads: the first thread asking for a subfeature reads it
+ * from sysfs, and the threads which ask for the same subfeature in the
+ * meantime wait for it to finish and take its result, instead of hitting
+ * the bus again. The result is published in the read slot of the
+ * subfeature under a sequence lock, so that waiters can pick it up
+ * without holding any lock, even if another read has started since.
+ *
+ * The in-flight state of the slots is protected by a small set of locks,
+ * shared by all slots, to keep the slots small.
+ */
+#define READ_LOCKS	32
+
+static struct sensors_read_lock {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} read_locks[READ_LOCKS];
+
+static pthread_once_t read_locks_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Failure tracking, if enabled: a subfeature which fails to read isn't
+ * read again before a delay, which doubles with every consecutive
+ * failure, from BACKOFF_MIN_MS up to the configured maximum. The last
+ * error is returned meanwhile. An input whose matching fault subfeature is set isn't read
+ * at all, the fault subfeature is checked again every FAULT_RECHECK_MS
+ * (or the maximum backoff delay if shorter) instead.
+ */
+#define BACKOFF_MIN_MS		1000
+#define FAULT_RECHECK_MS	10000
+
+/*
+ * Chip bursts: most drivers refresh all their registers when any
+ * attribute is read after their update interval, so reading the inputs of
+ * a chip one by one, with other work in between, may trigger several
+ * refreshes and mix values from different ones. In burst mode, the first
+ * read of an input reads all the inputs of the chip which were asked for
+ * so far, back to back, and the other inputs are served from that burst
+ * until the burst window is over. Inputs asked for the first time during
+ * the window are read alone, and join the next burst.
+ */
+struct sensors_read_burst {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int window;		/* ms */
+	int inflight;
+	unsigned int gen;	/* Number of bursts done */
+	uint64_t until;		/* End of the window, CLOCK_MONOTONIC ns */
+};
+
+/*
+ * Limit cache, if enabled: limits (and the other settings of a chip)
+ * hardly ever change, but applications read them along with the inputs on
+ * every cycle. Their values are cached, and read again every refresh
+ * period. Writing any subfeature of a chip drops all its cached limits at
+ * once, as a write may change other limits too (a fan divisor changes the
+ * fan minimum for example). Writes made by other processes, or by the
+ * driver itself, are only seen after the refresh period, so the cache is
+ * off by default.
+ */
+
+struct sensors_limit_cache {
+	int refresh;		/* ms */
+	unsigned int gen;	/* Bumped when the cached limits are dropped */
+};
+
+/* -1 until set by the application, then the environment decides */
+static int read_coalescing = -1;
+static int read_backoff = -1;
+static int read_burst = -1;
+static int limit_cache = -1;
+
+int sensors_set_read_coalescing(int enable)
+{
+	read_coalescing = !!enable;
+	return 0;
+}
+
+int sensors_set_read_backoff(int max_ms)
+{
+	if (max_ms < 0)
+		return -SENSORS_ERR_PARSE;
+	read_backoff = max_ms;
+	return 0;
+}
+
+int sensors_set_read_burst(int window_ms)
+{
+	if (window_ms < 0)
+		return -SENSORS_ERR_PARSE;
+	read_burst = window_ms;
+	return 0;
+}
+
+int sensors_set_limit_cache(int refresh_ms)
+{
+	if (refresh_ms < 0)
+		return -SENSORS_ERR_PARSE;
+	limit_cache = refresh_ms;
+	return 0;
+}
+
+static void sensors_init_read_locks(void)
+{
+	int i;
+
+	for (i = 0; i < READ_LOCKS; i++) {
+		pthread_mutex_init(&read_locks[i].mutex, NULL);
+		pthread_cond_init(&read_locks[i].cond, NULL);
+	}
+}
+
+/* Link the inputs with their fault subfeature, if any */
+static void sensors_read_link_faults(sensors_chip_features *chip_features)
+{
+	const sensors_subfeature *fault, *input;
+	int i, j;
+
+	for (i = 0; i < chip_features->subfeature_count; i++) {
+		chip_features->read_slots[i].fault_nr = -1;
+		chip_features->read_slots[i].input_nr = -1;
+	}
+
+	for (i = 0; i < chip_features->subfeature_count; i++) {
+		fault = chip_features->subfeature + i;
+		if (fault->type != SENSORS_SUBFEATURE_TEMP_FAULT &&
+		    fault->type != SENSORS_SUBFEATURE_FAN_FAULT)
+			continue;
+
+		for (j = 0; j < chip_features->subfeature_count; j++) {
+			input = chip_features->subfeature + j;
+			if (input->mapping == fault->mapping &&
+			    input->type == (fault->type & ~0xff)) {
+				chip_features->read_slots[i].input_nr = j;
+				chip_features->read_slots[j].fault_nr = i;
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Runtime power management: reading a device which is runtime-suspended
+ * wakes it up, which is unwelcome for disks (drivetemp) for example. For
+ * the chips configured with "suspended skip", the power/runtime_status
+ * file of the device is checked before every read, and while it says
+ * that the device is suspended, the last value read is returned along
+ * with SENSORS_ERR_SUSPENDED instead.
+ */
+static int sensors_read_suspended_mode(const sensors_chip_features
+				       *chip_features)
+{
+	const sensors_chip *chip;
+	int i;
+
+	/* The latest statement wins */
+	for (i = 0; i < chip_features->config_chips_count; i++) {
+		chip = sensors_config_chips + chip_features->config_chips[i];
+		if (chip->suspended >= 0)
+			return chip->suspended;
+	}
+	return SENSORS_SUSPENDED_WAKE;
+}
+
+static const char *
+sensors_read_find_runtime_status(const sensors_chip_features *chip_features,
+				 sensors_arena *arena)
+{
+	char path[NAME_MAX];
+
+	/* The device of a hwmon class device, or the device itself for
+	   the drivers which don't register one */
+	snprintf(path, NAME_MAX, "%s/device/power/runtime_status",
+		 chip_features->chip.path);
+	if (access(path, R_OK)) {
+		snprintf(path, NAME_MAX, "%s/power/runtime_status",
+			 chip_features->chip.path);
+		if (access(path, R_OK))
+			return NULL;
+	}
+	return sensors_arena_strdup(arena, path);
+}
+
+static int sensors_read_device_suspended(const sensors_chip_features
+					 *chip_features)
+{
+	char buf[16];
+	FILE *f;
+	int suspended = 0;
+
+	if (!(f = fopen(chip_features->runtime_status, "r")))
+		return 0;
+	/* "suspended" or "suspending" */
+	if (fgets(buf, sizeof(buf), f))
+		suspended = !strncmp(buf, "suspend", 7);
+	fclose(f);
+	return suspended;
+}
+
+static void sensors_read_init_burst(sensors_chip_features *chip_features,
+				    sensors_arena *arena)
+{
+	struct sensors_read_burst *burst;
+	const char *env;
+	int window;
+
+	if (read_burst < 0) {
+		env = getenv("LIBSENSORS_READ_BURST");
+		window = env ? atoi(env) : 0;
+	} else
+		window = read_burst;
+
+	chip_features->burst = NULL;
+	if (window <= 0)
+		return;
+
+	burst = sensors_arena_calloc(arena, 1, sizeof(*burst));
+	pthread_mutex_init(&burst->mutex, NULL);
+	pthread_cond_init(&burst->cond, NULL);
+	burst->window = window;
+	chip_features->burst = burst;
+}
+
+static void sensors_read_init_limits(sensors_chip_features *chip_features,
+				     sensors_arena *arena)
+{
+	const char *env;
+	int refresh;
+
+	if (limit_cache < 0) {
+		env = getenv("LIBSENSORS_LIMIT_CACHE");
+		refresh = env ? atoi(env) : 0;
+	} else
+		refresh = limit_cache;
+
+	chip_features->limits = NULL;
+	if (refresh <= 0)
+		return;
+
+	chip_features->limits = sensors_arena_calloc(arena, 1,
+					sizeof(*chip_features->limits));
+	chip_features->limits->refresh = refresh;
+}
+
+void sensors_read_init_chip(sensors_chip_features *chip_features)
+{
+	sensors_arena *arena;
+	const char *env;
+
+	if (read_coalescing < 0) {
+		env = getenv("LIBSENSORS_COALESCE_READS");
+		chip_features->read_coalesce = !env || atoi(env) > 0;
+	} else
+		chip_features->read_coalesce = read_coalescing;
+
+	if (read_backoff < 0) {
+		env = getenv("LIBSENSORS_READ_BACKOFF");
+		chip_features->read_backoff = env ? atoi(env) : 0;
+		if (chip_features->read_backoff < 0)
+			chip_features->read_backoff = 0;
+	} else
+		chip_features->read_backoff = read_backoff;
+
+	pthread_once(&read_locks_once, sensors_init_read_locks);
+
+	arena = sensors_chip_arena(chip_features);
+	chip_features->label_absent = chip_features->feature_count ?
+		sensors_arena_calloc(arena, chip_features->feature_count, 1) :
+		NULL;
+
+	chip_features->runtime_status =
+		sensors_read_suspended_mode(chip_features) ==
+		SENSORS_SUSPENDED_SKIP ?
+		sensors_read_find_runtime_status(chip_features, arena) : NULL;
+
+	if (!chip_features->subfeature_count) {
+		chip_features->read_slots = NULL;
+		chip_features->burst = NULL;
+		chip_features->limits = NULL;
+		return;
+	}
+	chip_features->read_slots = sensors_arena_calloc(arena,
+					chip_features->subfeature_count,
+					sizeof(sensors_read_slot));
+	sensors_read_link_faults(chip_features);
+	sensors_read_init_burst(chip_features, arena);
+	sensors_read_init_limits(chip_features, arena);
+}
+
+static struct sensors_read_lock *
+sensors_read_slot_lock(const sensors_read_slot *slot)
+{
+	return &read_locks[((uintptr_t)slot / sizeof(*slot)) % READ_LOCKS];
+}
+
+static uint64_t sensors_read_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Only called by the thread which has the read in flight */
+static void sensors_read_slot_store(sensors_read_slot *slot, double value,
+				    int err, uint64_t at)
+{
+	unsigned int seq = slot->seq;
+
+	__atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store(&slot->value, &value, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->err, err, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->at, at, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static int sensors_read_slot_load(const sensors_read_slot *slot,
+				  double *value, uint64_t *when)
+{
+	unsigned int seq;
+	int err;
+
+	for (;;) {
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		__atomic_load(&slot->value, value, __ATOMIC_RELAXED);
+		err = __atomic_load_n(&slot->err, __ATOMIC_RELAXED);
+		*when = __atomic_load_n(&slot->at, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq)
+			return err;
+	}
+}
+
+static uint64_t sensors_read_fault_recheck(const sensors_chip_features
+					   *chip_features)
+{
+	int ms = FAULT_RECHECK_MS;
+
+	if (chip_features->read_backoff < ms)
+		ms = chip_features->read_backoff;
+	return (uint64_t)ms * 1000000;
+}
+
+/* Record the outcome of a read from sysfs */
+static void sensors_read_track(const sensors_chip_features *chip_features,
+			       sensors_read_slot *slot, int err, double value)
+{
+	struct sensors_read_lock *lock = sensors_read_slot_lock(slot);
+	sensors_read_slot *input;
+	uint64_t now, delay;
+
+	now = sensors_read_now();
+
+	pthread_mutex_lock(&lock->mutex);
+	slot->suppressed = 0;
+	slot->last_err = err;
+	if (err) {
+		if (slot->failures < 16)
+			slot->failures++;
+		delay = (uint64_t)BACKOFF_MIN_MS << (slot->failures - 1);
+		if (delay > (uint64_t)chip_features->read_backoff)
+			delay = chip_features->read_backoff;
+		slot->retry_at = now + delay * 1000000;
+	} else {
+		slot->failures = 0;
+		slot->retry_at = 0;
+	}
+	pthread_mutex_unlock(&lock->mutex);
+
+	/* A fault subfeature tells whether its input can be read */
+	if (err || slot->input_nr < 0)
+		return;
+	input = chip_features->read_slots + slot->input_nr;
+	lock = sensors_read_slot_lock(input);
+	pthread_mutex_lock(&lock->mutex);
+	input->fault = value != 0;
+	input->fault_check_at = now + sensors_read_fault_recheck(chip_features);
+	pthread_mutex_unlock(&lock->mutex);
+}
+
+/* Read a subfeature from sysfs, and account for it. when is set to the
+   time the read completed. */
+static int sensors_read_attr(const sensors_chip_features *chip_features,
+			     const sensors_subfeature *subfeature,
+			     sensors_read_slot *slot, double *value,
+			     uint64_t *when)
+{
+	uint64_t start;
+	int err;
+
+	start = sensors_stats_start();
+	err = sensors_read_sysfs_attr(&chip_features->chip, subfeature,
+				      value);
+	*when = sensors_read_now();
+	sensors_stats_attr(chip_features, subfeature, SENSORS_STATS_READ,
+			   start, err);
+	if (slot && chip_features->runtime_status && !err) {
+		__atomic_store(&slot->last_value, value, __ATOMIC_RELAXED);
+		__atomic_store_n(&slot->last_at, *when, __ATOMIC_RELAXED);
+	}
+	if (slot && chip_features->read_backoff)
+		sensors_read_track(chip_features, slot, err, err ? 0 : *value);
+	return err;
+}
+
+/* Read a subfeature, sharing the result with the concurrent readers */
+static int sensors_read_shared(const sensors_chip_features *chip_features,
+			       const sensors_subfeature *subfeature,
+			       sensors_read_slot *slot, double *value,
+			       uint64_t *when)
+{
+	struct sensors_read_lock *lock;
+	unsigned int done;
+	int err;
+
+	lock = sensors_read_slot_lock(slot);
+
+	pthread_mutex_lock(&lock->mutex);
+	if (slot->inflight) {
+		/* Somebody is reading it already, wait for the result */
+		done = slot->done;
+		while (slot->done == done)
+			pthread_cond_wait(&lock->cond, &lock->mutex);
+		pthread_mutex_unlock(&lock->mutex);
+		sensors_stats_attr(chip_features, subfeature,
+				   SENSORS_STATS_HIT, 0, 0);
+		return sensors_read_slot_load(slot, value, when);
+	}
+	slot->inflight = 1;
+	pthread_mutex_unlock(&lock->mutex);
+
+	err = sensors_read_attr(chip_features, subfeature, slot, value, when);
+	sensors_read_slot_store(slot, err ? 0 : *value, err, *when);
+
+	pthread_mutex_lock(&lock->mutex);
+	slot->inflight = 0;
+	slot->done++;
+	pthread_cond_broadcast(&lock->cond);
+	pthread_mutex_unlock(&lock->mutex);
+
+	return err;
+}
+
+/* The subfeatures read in bursts */
+static int sensors_read_is_input(int type)
+{
+	switch (type) {
+	case SENSORS_SUBFEATURE_IN_INPUT:
+	case SENSORS_SUBFEATURE_FAN_INPUT:
+	case SENSORS_SUBFEATURE_TEMP_INPUT:
+	case SENSORS_SUBFEATURE_POWER_AVERAGE:
+	case SENSORS_SUBFEATURE_POWER_INPUT:
+	case SENSORS_SUBFEATURE_ENERGY_INPUT:
+	case SENSORS_SUBFEATURE_CURR_INPUT:
+	case SENSORS_SUBFEATURE_HUMIDITY_INPUT:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* Whether a failing or faulty input is left out of bursts for now */
+static int sensors_read_blocked(const sensors_chip_features *chip_features,
+				sensors_read_slot *slot, uint64_t now)
+{
+	struct sensors_read_lock *lock = sensors_read_slot_lock(slot);
+	int blocked;
+
+	if (!chip_features->read_backoff)
+		return 0;
+
+	pthread_mutex_lock(&lock->mutex);
+	blocked = slot->fault || slot->retry_at > now;
+	pthread_mutex_unlock(&lock->mutex);
+	return blocked;
+}
+
+/* Read an input, as part of a burst of all the wanted inputs of the chip */
+static int sensors_read_burst(const sensors_chip_features *chip_features,
+			      const sensors_subfeature *subfeature,
+			      sensors_read_slot *slot, double *value,
+			      uint64_t *when)
+{
+	struct sensors_read_burst *burst = chip_features->burst;
+	sensors_read_slot *other;
+	unsigned int gen;
+	uint64_t now, at;
+	double val;
+	int i, err = 0, res;
+
+	pthread_mutex_lock(&burst->mutex);
+	slot->wanted = 1;
+	while (burst->inflight)
+		pthread_cond_wait(&burst->cond, &burst->mutex);
+
+	now = sensors_read_now();
+	if (now < burst->until) {
+		gen = burst->gen;
+		if (slot->burst_gen == gen) {
+			*value = slot->burst_value;
+			err = slot->burst_err;
+			*when = slot->burst_at;
+			pthread_mutex_unlock(&burst->mutex);
+			sensors_stats_attr(chip_features, subfeature,
+					   SENSORS_STATS_HIT, 0, 0);
+			return err;
+		}
+		pthread_mutex_unlock(&burst->mutex);
+
+		/* Not wanted yet when the burst was done */
+		err = sensors_read_attr(chip_features, subfeature, slot,
+					value, when);
+
+		pthread_mutex_lock(&burst->mutex);
+		if (!burst->inflight && burst->gen == gen) {
+			slot->burst_value = err ? 0 : *value;
+			slot->burst_err = err;
+			slot->burst_at = *when;
+			slot->burst_gen = gen;
+		}
+		pthread_mutex_unlock(&burst->mutex);
+		return err;
+	}
+
+	/* Start a new burst */
+	burst->inflight = 1;
+	gen = burst->gen + 1;
+	pthread_mutex_unlock(&burst->mutex);
+
+	for (i = 0; i < chip_features->subfeature_count; i++) {
+		other = chip_features->read_slots + i;
+		if (other != slot) {
+			if (!sensors_read_is_input(
+					chip_features->subfeature[i].type))
+				continue;
+			pthread_mutex_lock(&burst->mutex);
+			res = other->wanted;
+			pthread_mutex_unlock(&burst->mutex);
+			if (!res ||
+			    sensors_read_blocked(chip_features, other, now))
+				continue;
+		}
+
+		res = sensors_read_attr(chip_features,
+					chip_features->subfeature + i, other,
+					&val, &at);
+
+		pthread_mutex_lock(&burst->mutex);
+		other->burst_value = res ? 0 : val;
+		other->burst_err = res;
+		other->burst_at = at;
+		other->burst_gen = gen;
+		pthread_mutex_unlock(&burst->mutex);
+
+		if (other == slot) {
+			*value = res ? 0 : val;
+			err = res;
+			*when = at;
+		}
+	}
+
+	pthread_mutex_lock(&burst->mutex);
+	burst->gen = gen;
+	burst->until = now + (uint64_t)burst->window * 1000000;
+	burst->inflight = 0;
+	pthread_cond_broadcast(&burst->cond);
+	pthread_mutex_unlock(&burst->mutex);
+
+	return err;
+}
+
+/* Check whether a subfeature must not be read now. Returns the error to
+   report instead, 0 if it can be read. */
+static int sensors_read_suppressed(const sensors_chip_features *chip_features,
+				   sensors_read_slot *slot)
+{
+	struct sensors_read_lock *lock = sensors_read_slot_lock(slot);
+	uint64_t now = sensors_read_now();
+	int err = 0, recheck = 0;
+	double value;
+
+	pthread_mutex_lock(&lock->mutex);
+	if (slot->fault) {
+		if (slot->fault_check_at > now)
+			err = -SENSORS_ERR_FAULT;
+		else
+			recheck = 1;
+	} else if (slot->retry_at > now)
+		err = slot->last_err;
+	if (err)
+		slot->suppressed++;
+	pthread_mutex_unlock(&lock->mutex);
+
+	if (!recheck)
+		return err;
+
+	/* This updates the fault state of the input */
+	sensors_read_subfeature(chip_features, chip_features->subfeature +
+				slot->fault_nr, &value, NULL);
+
+	pthread_mutex_lock(&lock->mutex);
+	if (slot->fault) {
+		if (slot->fault_check_at <= now)
+			slot->fault_check_at = now +
+				sensors_read_fault_recheck(chip_features);
+		slot->suppressed++;
+		err = -SENSORS_ERR_FAULT;
+	}
+	pthread_mutex_unlock(&lock->mutex);
+	return err;
+}
+
+static int sensors_read_uncached(const sensors_chip_features *chip_features,
+				 const sensors_subfeature *subfeature,
+				 sensors_read_slot *slot, double *value,
+				 uint64_t *when)
+{
+	double fault;
+	int err;
+
+	if (chip_features->runtime_status &&
+	    sensors_read_device_suspended(chip_features)) {
+		__atomic_load(&slot->last_value, value, __ATOMIC_RELAXED);
+		*when = __atomic_load_n(&slot->last_at, __ATOMIC_RELAXED);
+		sensors_stats_attr(chip_features, subfeature,
+				   SENSORS_STATS_SUPPRESSED, 0,
+				   -SENSORS_ERR_SUSPENDED);
+		return -SENSORS_ERR_SUSPENDED;
+	}
+
+	if (chip_features->read_backoff &&
+	    (err = sensors_read_suppressed(chip_features, slot))) {
+		sensors_stats_attr(chip_features, subfeature,
+				   SENSORS_STATS_SUPPRESSED, 0, err);
+		return err;
+	}
+
+	if (chip_features->burst && sensors_read_is_input(subfeature->type))
+		err = sensors_read_burst(chip_features, subfeature, slot,
+					 value, when);
+	else if (chip_features->read_coalesce)
+		err = sensors_read_shared(chip_features, subfeature, slot,
+					  value, when);
+	else
+		err = sensors_read_attr(chip_features, subfeature, slot,
+					value, when);
+
+	/* A failing input may be explained by its fault subfeature */
+	if (err && chip_features->read_backoff && slot->fault_nr >= 0 &&
+	    !sensors_read_subfeature(chip_features, chip_features->subfeature +
+				     slot->fault_nr, &fault, NULL) &&
+	    fault != 0)
+		err = -SENSORS_ERR_FAULT;
+
+	return err;
+}
+
+/* The subfeatures whose value is cached */
+static int sensors_read_is_limit(int type)
+{
+	switch (type) {
+	case SENSORS_SUBFEATURE_IN_MIN:
+	case SENSORS_SUBFEATURE_IN_MAX:
+	case SENSORS_SUBFEATURE_IN_LCRIT:
+	case SENSORS_SUBFEATURE_IN_CRIT:
+	case SENSORS_SUBFEATURE_IN_BEEP:
+	case SENSORS_SUBFEATURE_FAN_MIN:
+	case SENSORS_SUBFEATURE_FAN_MAX:
+	case SENSORS_SUBFEATURE_FAN_DIV:
+	case SENSORS_SUBFEATURE_FAN_BEEP:
+	case SENSORS_SUBFEATURE_FAN_PULSES:
+	case SENSORS_SUBFEATURE_TEMP_MAX:
+	case SENSORS_SUBFEATURE_TEMP_MAX_HYST:
+	case SENSORS_SUBFEATURE_TEMP_MIN:
+	case SENSORS_SUBFEATURE_TEMP_CRIT:
+	case SENSORS_SUBFEATURE_TEMP_CRIT_HYST:
+	case SENSORS_SUBFEATURE_TEMP_LCRIT:
+	case SENSORS_SUBFEATURE_TEMP_EMERGENCY:
+	case SENSORS_SUBFEATURE_TEMP_EMERGENCY_HYST:
+	case SENSORS_SUBFEATURE_TEMP_TYPE:
+	case SENSORS_SUBFEATURE_TEMP_OFFSET:
+	case SENSORS_SUBFEATURE_TEMP_BEEP:
+	case SENSORS_SUBFEATURE_POWER_CAP:
+	case SENSORS_SUBFEATURE_POWER_CAP_HYST:
+	case SENSORS_SUBFEATURE_POWER_MAX:
+	case SENSORS_SUBFEATURE_POWER_CRIT:
+	case SENSORS_SUBFEATURE_POWER_AVERAGE_INTERVAL:
+	case SENSORS_SUBFEATURE_CURR_MIN:
+	case SENSORS_SUBFEATURE_CURR_MAX:
+	case SENSORS_SUBFEATURE_CURR_LCRIT:
+	case SENSORS_SUBFEATURE_CURR_CRIT:
+	case SENSORS_SUBFEATURE_CURR_BEEP:
+	case SENSORS_SUBFEATURE_BEEP_ENABLE:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* Read a limit, from the cache if it was read recently enough and the
+   limits of the chip weren't written since */
+static int sensors_read_limit(const sensors_chip_features *chip_features,
+			      const sensors_subfeature *subfeature,
+			      sensors_read_slot *slot, double *value,
+			      uint64_t *when)
+{
+	struct sensors_limit_cache *limits = chip_features->limits;
+	struct sensors_read_lock *lock = sensors_read_slot_lock(slot);
+	unsigned int gen;
+	uint64_t now;
+	int err, hit;
+
+	gen = __atomic_load_n(&limits->gen, __ATOMIC_ACQUIRE);
+	now = sensors_read_now();
+
+	pthread_mutex_lock(&lock->mutex);
+	hit = slot->limit_gen == gen && slot->limit_until > now;
+	if (hit) {
+		*value = slot->limit_value;
+		*when = slot->limit_at;
+	}
+	pthread_mutex_unlock(&lock->mutex);
+
+	if (hit) {
+		sensors_stats_attr(chip_features, subfeature,
+				   SENSORS_STATS_HIT, 0, 0);
+		return 0;
+	}
+
+	err = sensors_read_uncached(chip_features, subfeature, slot, value,
+				    when);
+	if (err)
+		return err;
+
+	/* If the limits were written meanwhile, the value is already
+	   stale, as gen doesn't match anymore */
+	pthread_mutex_lock(&lock->mutex);
+	slot->limit_gen = gen;
+	slot->limit_value = *value;
+	slot->limit_at = *when;
+	slot->limit_until = now + (uint64_t)limits->refresh * 1000000;
+	pthread_mutex_unlock(&lock->mutex);
+	return 0;
+}
+
+int sensors_read_subfeature(const sensors_chip_features *chip_features,
+			    const sensors_subfeature *subfeature,
+			    double *value, uint64_t *when)
+{
+	sensors_read_slot *slot;
+	uint64_t at = 0;
+	int err;
+
+	if (chip_features->virt)
+		err = sensors_virtual_read(chip_features, subfeature, value,
+					   &at);
+	else if (!chip_features->read_slots)
+		err = sensors_read_attr(chip_features, subfeature, NULL,
+					value, &at);
+	else {
+		slot = chip_features->read_slots +
+		       (subfeature - chip_features->subfeature);
+		if (chip_features->limits &&
+		    sensors_read_is_limit(subfeature->type))
+			err = sensors_read_limit(chip_features, subfeature,
+						 slot, value, &at);
+		else
+			err = sensors_read_uncached(chip_features, subfeature,
+						    slot, value, &at);
+	}
+
+	if (when)
+		*when = at;
+	return err;
+}
+
+void sensors_read_invalidate_limits(const sensors_chip_features
+				    *chip_features)
+{
+	if (chip_features->limits)
+		__atomic_add_fetch(&chip_features->limits->gen, 1,
+				   __ATOMIC_RELEASE);
+}
+
+int sensors_read_label_absent(const sensors_chip_features *chip_features,
+			      const sensors_feature *feature)
+{
+	if (!chip_features->label_absent ||
+	    feature->number >= chip_features->feature_count)
+		return 0;
+	return __atomic_load_n(&chip_features->label_absent[feature->number],
+			       __ATOMIC_RELAXED);
+}
+
+void sensors_read_set_label_absent(const sensors_chip_features *chip_features,
+				   const sensors_feature *feature)
+{
+	if (!chip_features->label_absent ||
+	    feature->number >= chip_features->feature_count)
+		return;
+	__atomic_store_n(&chip_features->label_absent[feature->number], 1,
+			 __ATOMIC_RELAXED);
+}
+
+static int __sensors_get_read_state(const sensors_chip_name *name,
+				    int subfeat_nr, sensors_read_state *state)
+{
+	const sensors_chip_features *chip_features;
+	struct sensors_read_lock *lock;
+	sensors_read_slot *slot;
+	uint64_t now, until = 0;
+
+	memset(state, 0, sizeof(*state));
+
+	if (sensors_chip_name_has_wildcards(name))
+		return -SENSORS_ERR_WILDCARDS;
+	if (!(chip_features = sensors_lookup_chip(name)))
+		return -SENSORS_ERR_NO_ENTRY;
+	if (subfeat_nr < 0 || subfeat_nr >= chip_features->subfeature_count)
+		return -SENSORS_ERR_NO_ENTRY;
+	if (chip_features->runtime_status &&
+	    sensors_read_device_suspended(chip_features)) {
+		state->state = SENSORS_READ_SUSPENDED;
+		state->last_error = -SENSORS_ERR_SUSPENDED;
+		return 0;
+	}
+	if (!chip_features->read_backoff)
+		return 0;
+
+	slot = chip_features->read_slots + subfeat_nr;
+	lock = sensors_read_slot_lock(slot);
+	now = sensors_read_now();
+
+	pthread_mutex_lock(&lock->mutex);
+	state->failures = slot->failures;
+	state->last_error = slot->last_err;
+	state->suppressed = slot->suppressed;
+	if (slot->fault) {
+		state->state = SENSORS_READ_FAULT;
+		until = slot->fault_check_at;
+	} else if (slot->retry_at > now) {
+		state->state = SENSORS_READ_BACKOFF;
+		until = slot->retry_at;
+	}
+	pthread_mutex_unlock(&lock->mutex);
+
+	if (until > now)
+		state->retry_ms = (until - now + 999999) / 1000000;
+	return 0;
+}
+
+int sensors_get_read_state(const sensors_chip_name *name, int subfeat_nr,
+			   sensors_read_state *state)
+{
+	int res;
+
+	sensors_read_begin();
+	res = __sensors_get_read_state(name, subfeat_nr, state);
+	sensors_read_end();
+	return res;
+}
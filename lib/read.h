@@ -0,0 +1,47 @@
+/*
+    read.h - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#ifndef LIB_SENSORS_READ_H
+#define LIB_SENSORS_READ_H
+
+#include "data.h"
+
+/* Set up the read slots of a detected chip. Must be done before the chip
+   is read from. */
+void sensors_read_init_chip(sensors_chip_features *chip_features);
+
+/* Read the raw value of a subfeature from sysfs. Threads asking for the
+   same subfeature at the same time share the result of a single read.
+   If when isn't NULL, it is set to the time the underlying read completed,
+   in CLOCK_MONOTONIC ns, or 0 if the subfeature wasn't read. */
+int sensors_read_subfeature(const sensors_chip_features *chip_features,
+			    const sensors_subfeature *subfeature,
+			    double *value, uint64_t *when);
+
+/* Drop the cached limits of a chip, after a write */
+void sensors_read_invalidate_limits(const sensors_chip_features
+				    *chip_features);
+
+/* Whether a feature is known to have no _label file */
+int sensors_read_label_absent(const sensors_chip_features *chip_features,
+			      const sensors_feature *feature);
+void sensors_read_set_label_absent(const sensors_chip_features *chip_features,
+				   const sensors_feature *feature);
+
+#endif /* def LIB_SENSORS_READ_H */
@@ -21,8 +21,31 @@
 #ifndef LIB_SENSORS_SCANNER_H
 #define LIB_SENSORS_SCANNER_H
 
-int sensors_scanner_init(FILE *input, const char *filename);
-void sensors_scanner_exit(void);
+struct sensors_chip;
+
+/* The state of the scanner and the parser while reading one configuration
+   file. Each parse has its own, so several files can be parsed at the same
+   time by different threads. */
+typedef struct sensors_scanner {
+	void *yyscanner;		/* The reentrant flex scanner */
+	const char *filename;
+	int lineno;
+	char lex_error[100];
+
+	/* Quoted string being scanned */
+	char *buffer;
+	int buffer_count;
+	int buffer_max;
+
+	/* The chip block the parser is in */
+	struct sensors_chip *current_chip;
+	/* Set while in a chip block which was skipped */
+	int current_chip_skipped;
+} sensors_scanner;
+
+int sensors_scanner_init(sensors_scanner *scanner, FILE *input,
+			 const char *filename);
+void sensors_scanner_exit(sensors_scanner *scanner);
 
 #endif
 
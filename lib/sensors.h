@@ -24,6 +24,7 @@
 
 #include <stdio.h>
 #include <limits.h>
+#include <time.h>
 
 /* Publicly accessible library functions */
 
@@ -31,7 +32,7 @@
    when the API + ABI breaks), the third digit is incremented to track small
    API additions like new flags / enum values. The second digit is for tracking
    larger additions like new methods. */
-#define SENSORS_API_VERSION		0x432
+#define SENSORS_API_VERSION		0x440
 
 #define SENSORS_CHIP_NAME_PREFIX_ANY	NULL
 #define SENSORS_CHIP_NAME_ADDR_ANY	(-1)
@@ -70,13 +71,149 @@ typedef struct sensors_chip_name {
    returns a value unequal to zero, you are in trouble; you can not
    assume anything will be initialized properly. If you want to
    reload the configuration file, call sensors_cleanup() below before
-   calling sensors_init() again. */
+   calling sensors_init() again, or use sensors_reload(). */
 int sensors_init(FILE *input);
 
 /* Clean-up function: You can't access anything after
    this, until the next sensors_init() call! */
 void sensors_cleanup(void);
 
+/* Load the configuration file and the detected chips list again, like
+   sensors_init() does, into a new state which replaces the current one
+   only once it is complete. Other threads may keep reading meanwhile,
+   they are never blocked and see either the old or the new state. The
+   old state is freed before this function returns, once no thread uses
+   it any longer, so chip names, features and subfeatures obtained before
+   must be looked up again, unless they are only used between
+   sensors_read_begin() and sensors_read_end(). On error, the current
+   state is kept. Returns 0 on success, <0 on error. */
+int sensors_reload(FILE *input);
+
+/* All the chip names, features, subfeatures and strings returned by the
+   library between these two calls belong to the same state, and stay
+   valid until sensors_read_end(), even if another thread calls
+   sensors_reload(). Calls can be nested. They never block, but should
+   not last long, as sensors_reload() waits for them. Don't call
+   sensors_reload() or sensors_cleanup() in between. */
+void sensors_read_begin(void);
+void sensors_read_end(void);
+
+/* Cache the list of detected chips in the given file, and use it in
+   subsequent sensors_init() calls as long as the hwmon devices don't
+   change. Pass NULL to disable the cache. If this function isn't called,
+   the LIBSENSORS_CACHE environment variable is used. Must be called
+   before sensors_init(). Returns 0 on success, <0 on error. */
+int sensors_set_cache_file(const char *path);
+
+/* Scan the hwmon devices with up to the given number of threads in
+   sensors_init(). 0 or 1 means a serial scan, which is the default. If
+   this function isn't called, the LIBSENSORS_DISCOVERY_THREADS environment
+   variable is used. The chips are listed in the same order either way.
+   Returns 0 on success, <0 on error. */
+int sensors_set_discovery_threads(int threads);
+
+/* Cache the parsed default configuration in the given file, and use it in
+   subsequent sensors_init() calls as long as the configuration files and
+   the detected busses don't change. Pass NULL to disable the cache. If
+   this function isn't called, the LIBSENSORS_CONFIG_CACHE environment
+   variable is used. Must be called before sensors_init(). Returns 0 on
+   success, <0 on error. */
+int sensors_set_config_cache_file(const char *path);
+
+/* If skip is non-zero, chip blocks of the configuration files which can't
+   apply to any detected chip are skipped while parsing, which saves memory
+   and speeds up lookups. Chips which appear later (see hotplug support
+   below) won't get their configuration then. If this function isn't
+   called, the LIBSENSORS_SKIP_ABSENT_CHIPS environment variable is used.
+   Must be called before sensors_init(). Returns 0 on success, <0 on
+   error. */
+int sensors_set_skip_absent_chips(int skip);
+
+/* If enable is non-zero, which is the default, threads reading the same
+   subfeature at the same time share the result of a single read, instead
+   of each reading it from the device. If this function isn't called, the
+   LIBSENSORS_COALESCE_READS environment variable is used. Must be called
+   before sensors_init(). Returns 0 on success, <0 on error. */
+int sensors_set_read_coalescing(int enable);
+
+/* If enable is non-zero, sensors_init() starts collecting the statistics
+   returned by sensors_get_stats(). If this function isn't called, the
+   LIBSENSORS_STATS environment variable is used. Returns 0 on success, <0
+   on error. */
+int sensors_set_stats(int enable);
+
+/* Don't read again a subfeature which failed to read before a delay, which
+   doubles with every consecutive failure, up to max_ms milliseconds.
+   Inputs whose fault subfeature is set aren't read either. 0, the
+   default, disables this. If this function isn't called, the
+   LIBSENSORS_READ_BACKOFF environment variable is used. Must be called
+   before sensors_init(). Returns 0 on success, <0 on error. */
+int sensors_set_read_backoff(int max_ms);
+
+/* If window_ms is non-zero, the first read of an input of a chip reads all
+   the inputs of this chip which were read before, back to back, and the
+   following reads of these inputs return the values of this burst for
+   window_ms milliseconds. This gives consistent values, and avoids
+   triggering several register refreshes of the chip per cycle. 0, the
+   default, disables this. If this function isn't called, the
+   LIBSENSORS_READ_BURST environment variable is used. Must be called
+   before sensors_init(). Returns 0 on success, <0 on error. */
+int sensors_set_read_burst(int window_ms);
+
+/* Cache the limits and other settings of the chips (the subfeatures which
+   are neither inputs nor alarms), and read them again every refresh_ms
+   milliseconds. Writing a subfeature of a chip, with sensors_set_value()
+   or sensors_do_chip_sets(), drops the cached limits of this chip, but
+   changes made by other processes or by the driver (fan minimum adjusted
+   with the divisor) are only seen after refresh_ms. 0, the default,
+   disables the cache. If this function isn't called, the
+   LIBSENSORS_LIMIT_CACHE environment variable is used. Must be called
+   before sensors_init(). Returns 0 on success, <0 on error. */
+int sensors_set_limit_cache(int refresh_ms);
+
+/* If alpha is non-zero, keep statistics of the values read from each
+   subfeature, returned by sensors_get_value_stats(). alpha is the weight
+   of a new value in the exponentially weighted moving average, between 0
+   and 1. 0, the default, disables this. If this function isn't called,
+   the LIBSENSORS_VALUE_STATS environment variable is used. Must be called
+   before sensors_init(). Returns 0 on success, <0 on error. */
+int sensors_set_value_stats(double alpha);
+
+/* Hotplug events, passed to the sensors_hotplug_process() callback */
+#define SENSORS_HOTPLUG_ADDED		1
+#define SENSORS_HOTPLUG_REMOVED		2
+
+typedef void (*sensors_hotplug_callback)(const sensors_chip_name *chip,
+					 int event, void *data);
+
+/* Start listening for hwmon devices being added or removed. Returns a
+   file descriptor which becomes readable when events are pending, <0 on
+   error. The descriptor belongs to the library, don't close it. */
+int sensors_hotplug_open(void);
+
+/* Process the pending hotplug events, and update the list of detected
+   chips accordingly. New chips are appended to the list; chip names
+   returned earlier for other chips stay valid. The callback (if not NULL)
+   is called for every chip added, and for every chip removed before it
+   goes away. Other threads may keep reading meanwhile, as with
+   sensors_reload(); removed chips are freed once no thread uses them.
+   Don't call it between sensors_read_begin() and sensors_read_end().
+   The callback must not call sensors_reload() nor
+   sensors_hotplug_process(), which would deadlock.
+   sensors_ctx_hotplug_process() needs exclusive access to its context.
+   Returns the number of chips added or removed, <0 on error. */
+int sensors_hotplug_process(sensors_hotplug_callback cb, void *data);
+
+/* Stop listening for hotplug events. This is also done by
+   sensors_cleanup(). */
+void sensors_hotplug_close(void);
+
+/* Print, for every detected chip matching the given name (all chips if
+   NULL), the configuration file chip blocks which apply to it, in the
+   order they are searched (latest first), and then the groups if match is
+   NULL. This is meant for debugging configuration files. */
+void sensors_dump_config(FILE *out, const sensors_chip_name *match);
+
 /* Parse a chip name to the internal representation. Return 0 on success, <0
    on error. */
 int sensors_parse_chip_name(const char *orig_name, sensors_chip_name *res);
@@ -106,10 +243,60 @@ char *sensors_get_label(const sensors_chip_name *name,
 
 /* Read the value of a subfeature of a certain chip. Note that chip should not
    contain wildcard values! This function will return 0 on success, and <0
-   on failure.  */
+   on failure. It may be called by several threads at once. If the chip is
+   configured with "suspended skip" and its device is runtime-suspended,
+   SENSORS_ERR_SUSPENDED is returned, and value is set to the last value
+   read (0 if none). */
 int sensors_get_value(const sensors_chip_name *name, int subfeat_nr,
 		      double *value);
 
+/* Same as sensors_get_value(), and also return in timestamp the time at
+   which the value was read from the device, on the CLOCK_MONOTONIC clock.
+   A value taken from a read shared with other threads, from a burst or
+   from the limit cache carries the time of that read, so that the
+   difference between two timestamps is the actual interval between the
+   samples. The timestamp is zero if the device wasn't read. */
+int sensors_get_value_timed(const sensors_chip_name *name, int subfeat_nr,
+			    double *value, struct timespec *timestamp);
+
+/* A timestamped value, as returned by sensors_get_values_timed() and
+   sensors_get_snapshot() */
+typedef struct sensors_reading {
+	int subfeat_nr;
+	double value;
+	int err;		/* As returned by sensors_get_value() */
+	struct timespec timestamp;
+} sensors_reading;
+
+/* Read the subfeatures given by the subfeat_nr fields of readings, count
+   of them, from the same chip, and store their values, errors and
+   timestamps as sensors_get_value_timed() would. Returns 0 on success, <0
+   if the chip can't be read at all. */
+int sensors_get_values_timed(const sensors_chip_name *name,
+			     sensors_reading *readings, int count);
+
+/* Read all the readable subfeatures of the features of a chip which
+   aren't ignored, in order, and store up to max of them in readings.
+   Returns the number of subfeatures, which may be more than max, or <0
+   on error. */
+int sensors_get_snapshot(const sensors_chip_name *name,
+			 sensors_reading *readings, int max);
+
+/* Read an energy input (SENSORS_SUBFEATURE_ENERGY_INPUT) of a chip, and
+   store in power the average power in W since the previous sample, which
+   the library keeps for each energy input, shared by all its callers.
+   Counter wraps are accounted for. SENSORS_ERR_AGAIN is returned on the
+   first sample, and when the counter was reset. The raw counter is used,
+   compute statements are not applied. */
+int sensors_get_energy_power(const sensors_chip_name *name, int subfeat_nr,
+			     double *power);
+
+/* Batch form of sensors_get_energy_power(): the value of each reading is
+   the power, and its timestamp the time of the sample. Returns 0 on
+   success, <0 if the chip can't be read at all. */
+int sensors_get_energy_powers(const sensors_chip_name *name,
+			      sensors_reading *readings, int count);
+
 /* Set the value of a subfeature of a certain chip. Note that chip should not
    contain wildcard values! This function will return 0 on success, and <0
    on failure. */
@@ -300,6 +487,245 @@ sensors_get_subfeature(const sensors_chip_name *name,
 		       const sensors_feature *feature,
 		       sensors_subfeature_type type);
 
+/* This returns all the main features of a given chip which aren't
+   ignored at once, as an array of *count pointers, or NULL if there are
+   none. The same pointers are returned by sensors_get_features().
+   Do not try to change the returned array; you will corrupt internal
+   data structures. */
+const sensors_feature * const *
+sensors_get_feature_array(const sensors_chip_name *name, int *count);
+
+/* This returns all subfeatures of a given main feature at once, as an
+   array of *count elements, or NULL if there are none.
+   Do not try to change the returned array; you will corrupt internal
+   data structures. */
+const sensors_subfeature *
+sensors_get_subfeature_array(const sensors_chip_name *name,
+			     const sensors_feature *feature, int *count);
+
+/* A subfeature in alarm, as returned by sensors_get_alarm_summary() */
+typedef struct sensors_alarm {
+	const sensors_chip_name *chip;
+	const sensors_subfeature *subfeature;
+} sensors_alarm;
+
+/* Read all the alarm and fault subfeatures (*_alarm, *_fault,
+   intrusion*_alarm) of the detected chips matching match (all chips if
+   match is NULL), and store the ones which are set in alarms, up to max
+   of them. Alarms which can't be read are skipped. Returns the number of
+   subfeatures in alarm, which may be more than max. With max = 0, only
+   check whether anything is alarming: stop at the first alarm which is
+   set, and return 1. */
+int sensors_get_alarm_summary(const sensors_chip_name *match,
+			      sensors_alarm *alarms, int max);
+
+/* Selectors: a set of subfeatures, read together. A selector is written
+   "chip/pattern", where chip is a chip name as accepted by
+   sensors_parse_chip_name(), or "*" for all chips, and pattern a shell
+   wildcard pattern matched against the subfeature names, for example
+   "coretemp-isa-0000/temp*_input". Without a chip part, all chips are
+   selected: "power*_input" selects all the power inputs. The readable
+   subfeatures of the features which aren't ignored are matched once, and
+   again only when the list of detected chips changes. A selector must not
+   be used by several threads at once. */
+typedef struct sensors_selector sensors_selector;
+
+typedef struct sensors_selection {
+	const sensors_chip_name *chip;
+	const sensors_subfeature *subfeature;
+	double value;
+	int err;		/* As returned by sensors_get_value() */
+	struct timespec timestamp; /* As sensors_get_value_timed() */
+} sensors_selection;
+
+/* Create a selector. Returns 0 on success, <0 on error. */
+int sensors_compile_selector(const char *spec, sensors_selector **selector);
+
+/* Create a selector from the group statements of the configuration files
+   with the given name, which select the subfeatures of all their
+   selectors. The group is looked up once: the selector isn't affected by
+   a later sensors_reload(). Returns 0 on success, -SENSORS_ERR_NO_ENTRY
+   if there is no such group, <0 on other errors. */
+int sensors_compile_group(const char *name, sensors_selector **selector);
+
+void sensors_free_selector(sensors_selector *selector);
+
+/* Read the values of the subfeatures of a selector, and store up to max
+   of them in values. Returns the number of subfeatures selected, which
+   may be more than max. The chip names and subfeatures stored in values
+   are valid until the list of detected chips changes. */
+int sensors_read_selector(sensors_selector *selector,
+			  sensors_selection *values, int max);
+
+/* Statistics, collected if enabled by sensors_set_stats(). Each subfeature
+   access opens one file. latency[i] counts the reads and writes which
+   took less than 2^i microseconds (and at least 2^(i-1) if i > 0); the
+   last bucket counts the slower ones too. errors[] is indexed by the
+   SENSORS_ERR_* values of error.h. cache_hits counts the values taken
+   from another read of the same subfeature, which was in flight.
+   suppressed counts the reads of failing subfeatures which weren't
+   attempted, see sensors_get_read_state(). */
+#define SENSORS_STATS_ERRORS		16
+#define SENSORS_STATS_LATENCY_BUCKETS	24
+
+typedef struct sensors_stats {
+	unsigned long sysfs_opens;
+	unsigned long sysfs_reads;
+	unsigned long sysfs_writes;
+	unsigned long bytes_read;
+	unsigned long errors[SENSORS_STATS_ERRORS];
+	unsigned long cache_hits;
+	unsigned long suppressed;
+	unsigned long config_lookups;
+	unsigned long expr_evals;
+	unsigned long latency[SENSORS_STATS_LATENCY_BUCKETS];
+} sensors_stats;
+
+/* Get the statistics of the whole library if name is NULL, otherwise of
+   the given chip if subfeat_nr is -1, otherwise of the given subfeature.
+   Only the subfeature accesses are accounted to chips and subfeatures,
+   the files opened for the detection of chips, bytes_read, config_lookups
+   and expr_evals are only counted for the whole library. Note that chip
+   should not contain wildcard values! Returns 0 on success, <0 on
+   error. */
+int sensors_get_stats(const sensors_chip_name *name, int subfeat_nr,
+		      sensors_stats *stats);
+
+/* Statistics of the values of a subfeature, kept if enabled by
+   sensors_set_value_stats(). Every read of the device is accounted for
+   once, whoever asked for it, with the value returned by
+   sensors_get_value(); failed reads are not. variance is the sample
+   variance, 0 until two values were read. */
+typedef struct sensors_value_stats {
+	unsigned long count;
+	double min;
+	double max;
+	double ewma;		/* Exponentially weighted moving average */
+	double mean;
+	double variance;
+} sensors_value_stats;
+
+/* Get the value statistics of a subfeature. They are all 0 if the
+   statistics are disabled. Note that chip should not contain wildcard
+   values! Returns 0 on success, <0 on error. */
+int sensors_get_value_stats(const sensors_chip_name *name, int subfeat_nr,
+			    sensors_value_stats *stats);
+
+/* Read state of a subfeature, see sensors_set_read_backoff() */
+#define SENSORS_READ_OK		0	/* Read normally */
+#define SENSORS_READ_BACKOFF	1	/* Failed, not read again for now */
+#define SENSORS_READ_FAULT	2	/* Not read, the fault flag is set */
+#define SENSORS_READ_SUSPENDED	3	/* Not read, the device is suspended */
+
+typedef struct sensors_read_state {
+	int state;
+	int failures;		/* Number of consecutive failed reads */
+	int last_error;		/* Error of the last read, 0 if none */
+	unsigned int suppressed; /* Reads not attempted since the last one */
+	unsigned int retry_ms;	/* Time before the next read attempt */
+} sensors_read_state;
+
+/* Get the read state of a subfeature. Reads which aren't attempted return
+   the error of the last read, SENSORS_ERR_FAULT or SENSORS_ERR_SUSPENDED.
+   Note that chip should not contain wildcard values! Returns 0 on
+   success, <0 on error. */
+int sensors_get_read_state(const sensors_chip_name *name, int subfeat_nr,
+			   sensors_read_state *state);
+
+/* Contexts: each context has its own list of detected chips and its own
+   configuration, so several configurations can be used in the same
+   process, and different threads can work on different contexts at the
+   same time. A given context must not be used by several threads at once,
+   except for the sensors_ctx_get_value*() functions,
+   sensors_ctx_get_snapshot(), sensors_ctx_get_energy_power*(),
+   sensors_ctx_get_value_stats() and the lookup functions, and never
+   while sensors_ctx_hotplug_process() runs.
+   The functions above work on a default context. The error handlers and
+   the settings made by the sensors_set_*() functions are shared by all
+   contexts. */
+typedef struct sensors_context sensors_context;
+
+/* Create a new, empty context. Call sensors_ctx_init() to load it. */
+sensors_context *sensors_context_new(void);
+
+/* Clean up and free a context. ctx may be NULL. */
+void sensors_context_free(sensors_context *ctx);
+
+/* The following functions behave like the functions above without the
+   ctx_ part in their name, except that they work on the given context. */
+int sensors_ctx_init(sensors_context *ctx, FILE *input);
+void sensors_ctx_cleanup(sensors_context *ctx);
+const char *sensors_ctx_get_adapter_name(sensors_context *ctx,
+					 const sensors_bus_id *bus);
+char *sensors_ctx_get_label(sensors_context *ctx,
+			    const sensors_chip_name *name,
+			    const sensors_feature *feature);
+int sensors_ctx_get_value(sensors_context *ctx, const sensors_chip_name *name,
+			  int subfeat_nr, double *value);
+int sensors_ctx_get_value_timed(sensors_context *ctx,
+				const sensors_chip_name *name, int subfeat_nr,
+				double *value, struct timespec *timestamp);
+int sensors_ctx_get_values_timed(sensors_context *ctx,
+				 const sensors_chip_name *name,
+				 sensors_reading *readings, int count);
+int sensors_ctx_get_snapshot(sensors_context *ctx,
+			     const sensors_chip_name *name,
+			     sensors_reading *readings, int max);
+int sensors_ctx_get_energy_power(sensors_context *ctx,
+				 const sensors_chip_name *name, int subfeat_nr,
+				 double *power);
+int sensors_ctx_get_energy_powers(sensors_context *ctx,
+				  const sensors_chip_name *name,
+				  sensors_reading *readings, int count);
+int sensors_ctx_set_value(sensors_context *ctx, const sensors_chip_name *name,
+			  int subfeat_nr, double value);
+int sensors_ctx_do_chip_sets(sensors_context *ctx,
+			     const sensors_chip_name *name);
+const sensors_chip_name *
+sensors_ctx_get_detected_chips(sensors_context *ctx,
+			       const sensors_chip_name *match, int *nr);
+const sensors_feature *
+sensors_ctx_get_features(sensors_context *ctx, const sensors_chip_name *name,
+			 int *nr);
+const sensors_subfeature *
+sensors_ctx_get_all_subfeatures(sensors_context *ctx,
+				const sensors_chip_name *name,
+				const sensors_feature *feature, int *nr);
+const sensors_subfeature *
+sensors_ctx_get_subfeature(sensors_context *ctx,
+			   const sensors_chip_name *name,
+			   const sensors_feature *feature,
+			   sensors_subfeature_type type);
+const sensors_feature * const *
+sensors_ctx_get_feature_array(sensors_context *ctx,
+			      const sensors_chip_name *name, int *count);
+const sensors_subfeature *
+sensors_ctx_get_subfeature_array(sensors_context *ctx,
+				 const sensors_chip_name *name,
+				 const sensors_feature *feature, int *count);
+int sensors_ctx_hotplug_open(sensors_context *ctx);
+int sensors_ctx_hotplug_process(sensors_context *ctx,
+				sensors_hotplug_callback cb, void *data);
+void sensors_ctx_hotplug_close(sensors_context *ctx);
+void sensors_ctx_dump_config(sensors_context *ctx, FILE *out,
+			     const sensors_chip_name *match);
+int sensors_ctx_get_stats(sensors_context *ctx, const sensors_chip_name *name,
+			  int subfeat_nr, sensors_stats *stats);
+int sensors_ctx_get_value_stats(sensors_context *ctx,
+				const sensors_chip_name *name, int subfeat_nr,
+				sensors_value_stats *stats);
+int sensors_ctx_get_read_state(sensors_context *ctx,
+			       const sensors_chip_name *name, int subfeat_nr,
+			       sensors_read_state *state);
+int sensors_ctx_get_alarm_summary(sensors_context *ctx,
+				  const sensors_chip_name *match,
+				  sensors_alarm *alarms, int max);
+int sensors_ctx_compile_group(sensors_context *ctx, const char *name,
+			      sensors_selector **selector);
+int sensors_ctx_read_selector(sensors_context *ctx,
+			      sensors_selector *selector,
+			      sensors_selection *values, int max);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,275 @@
+/*
+    stats.c - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "sensors.h"
+#include "data.h"
+#include "error.h"
+#include "access.h"
+#include "sysfs.h"
+#include "stats.h"
+
+/*
+ * Each thread counts in its own sensors_stats, so that the counters don't
+ * bounce between CPUs. The blocks of all threads are summed up when the
+ * application asks for the statistics. Those of threads which exit are
+ * added to exited_stats first.
+ *
+ * The statistics of the subfeatures are shared by all threads, and
+ * updated atomically. They are only touched when sysfs is accessed, which
+ * is much more expensive anyway.
+ */
+struct sensors_thread_stats {
+	sensors_stats stats;
+	struct sensors_thread_stats *next;
+	struct sensors_thread_stats *prev;
+};
+
+int sensors_stats_enabled;
+
+/* -1 until set by the application, then the environment decides */
+static int stats_setting = -1;
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct sensors_thread_stats *stats_threads;
+static sensors_stats exited_stats;
+
+static pthread_once_t stats_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t stats_key;
+static __thread struct sensors_thread_stats *thread_stats;
+
+#define STATS_COUNTERS	(sizeof(sensors_stats) / sizeof(unsigned long))
+
+int sensors_set_stats(int enable)
+{
+	stats_setting = !!enable;
+	return 0;
+}
+
+void sensors_stats_init(void)
+{
+	const char *env;
+	int enable;
+
+	if (stats_setting < 0) {
+		env = getenv("LIBSENSORS_STATS");
+		enable = env && atoi(env) > 0;
+	} else
+		enable = stats_setting;
+
+	__atomic_store_n(&sensors_stats_enabled, enable, __ATOMIC_RELAXED);
+}
+
+void sensors_stats_init_chip(sensors_chip_features *chip_features)
+{
+	sensors_arena *arena;
+
+	if (!__atomic_load_n(&sensors_stats_enabled, __ATOMIC_RELAXED) ||
+	    !chip_features->subfeature_count) {
+		chip_features->stats = NULL;
+		return;
+	}
+
+	arena = sensors_chip_arena(chip_features);
+	chip_features->stats = sensors_arena_calloc(arena,
+					chip_features->subfeature_count,
+					sizeof(sensors_stats));
+}
+
+/* Add the counters of src to dst */
+static void sensors_stats_merge(sensors_stats *dst, const sensors_stats *src)
+{
+	unsigned long *d = (unsigned long *)dst;
+	const unsigned long *s = (const unsigned long *)src;
+	size_t i;
+
+	for (i = 0; i < STATS_COUNTERS; i++)
+		d[i] += __atomic_load_n(&s[i], __ATOMIC_RELAXED);
+}
+
+static void sensors_stats_thread_exit(void *arg)
+{
+	struct sensors_thread_stats *ts = arg;
+
+	pthread_mutex_lock(&stats_lock);
+	sensors_stats_merge(&exited_stats, &ts->stats);
+	if (ts->prev)
+		ts->prev->next = ts->next;
+	else
+		stats_threads = ts->next;
+	if (ts->next)
+		ts->next->prev = ts->prev;
+	pthread_mutex_unlock(&stats_lock);
+	free(ts);
+}
+
+static void sensors_stats_create_key(void)
+{
+	pthread_key_create(&stats_key, sensors_stats_thread_exit);
+}
+
+sensors_stats *sensors_stats_thread(void)
+{
+	struct sensors_thread_stats *ts = thread_stats;
+
+	if (ts)
+		return &ts->stats;
+
+	ts = calloc(1, sizeof(*ts));
+	if (!ts)
+		sensors_fatal_error(__func__, "Out of memory");
+
+	pthread_once(&stats_key_once, sensors_stats_create_key);
+	pthread_setspecific(stats_key, ts);
+
+	pthread_mutex_lock(&stats_lock);
+	ts->next = stats_threads;
+	if (stats_threads)
+		stats_threads->prev = ts;
+	stats_threads = ts;
+	pthread_mutex_unlock(&stats_lock);
+
+	thread_stats = ts;
+	return &ts->stats;
+}
+
+uint64_t sensors_stats_start(void)
+{
+	struct timespec ts;
+
+	if (!__atomic_load_n(&sensors_stats_enabled, __ATOMIC_RELAXED))
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Bucket i counts the accesses which took less than 2^i microseconds */
+static int sensors_stats_bucket(uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	int bucket;
+
+	if (!us)
+		return 0;
+	bucket = 64 - __builtin_clzll(us);
+	if (bucket >= SENSORS_STATS_LATENCY_BUCKETS)
+		bucket = SENSORS_STATS_LATENCY_BUCKETS - 1;
+	return bucket;
+}
+
+/* Counters of the subfeatures are shared, those of a thread aren't */
+static void sensors_stats_inc(unsigned long *counter, int shared)
+{
+	if (shared)
+		__atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+	else
+		__atomic_store_n(counter, *counter + 1, __ATOMIC_RELAXED);
+}
+
+static void sensors_stats_account(sensors_stats *stats, int shared, int kind,
+				  int bucket, int err)
+{
+	if (kind == SENSORS_STATS_HIT) {
+		sensors_stats_inc(&stats->cache_hits, shared);
+		return;
+	}
+	if (kind == SENSORS_STATS_SUPPRESSED) {
+		sensors_stats_inc(&stats->suppressed, shared);
+		return;
+	}
+
+	sensors_stats_inc(&stats->sysfs_opens, shared);
+	if (kind == SENSORS_STATS_READ)
+		sensors_stats_inc(&stats->sysfs_reads, shared);
+	else
+		sensors_stats_inc(&stats->sysfs_writes, shared);
+	if (err && -err < SENSORS_STATS_ERRORS)
+		sensors_stats_inc(&stats->errors[-err], shared);
+	sensors_stats_inc(&stats->latency[bucket], shared);
+}
+
+void sensors_stats_attr(const sensors_chip_features *chip_features,
+			const sensors_subfeature *subfeature, int kind,
+			uint64_t start, int err)
+{
+	int bucket = 0;
+
+	if (!__atomic_load_n(&sensors_stats_enabled, __ATOMIC_RELAXED))
+		return;
+
+	if (kind == SENSORS_STATS_READ || kind == SENSORS_STATS_WRITE)
+		bucket = sensors_stats_bucket(sensors_stats_start() - start);
+
+	sensors_stats_account(sensors_stats_thread(), 0, kind, bucket, err);
+	/* The chip may predate the statistics being enabled */
+	if (chip_features->stats)
+		sensors_stats_account(chip_features->stats +
+				      (subfeature - chip_features->subfeature),
+				      1, kind, bucket, err);
+}
+
+static int __sensors_get_stats(const sensors_chip_name *name, int subfeat_nr,
+			       sensors_stats *stats)
+{
+	const sensors_chip_features *chip_features;
+	struct sensors_thread_stats *ts;
+	int i;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (!name) {
+		pthread_mutex_lock(&stats_lock);
+		sensors_stats_merge(stats, &exited_stats);
+		for (ts = stats_threads; ts; ts = ts->next)
+			sensors_stats_merge(stats, &ts->stats);
+		pthread_mutex_unlock(&stats_lock);
+		return 0;
+	}
+
+	if (sensors_chip_name_has_wildcards(name))
+		return -SENSORS_ERR_WILDCARDS;
+	if (!(chip_features = sensors_lookup_chip(name)))
+		return -SENSORS_ERR_NO_ENTRY;
+	if (subfeat_nr >= chip_features->subfeature_count)
+		return -SENSORS_ERR_NO_ENTRY;
+	if (!chip_features->stats)
+		return 0;
+
+	if (subfeat_nr >= 0) {
+		sensors_stats_merge(stats, chip_features->stats + subfeat_nr);
+		return 0;
+	}
+	for (i = 0; i < chip_features->subfeature_count; i++)
+		sensors_stats_merge(stats, chip_features->stats + i);
+	return 0;
+}
+
+int sensors_get_stats(const sensors_chip_name *name, int subfeat_nr,
+		      sensors_stats *stats)
+{
+	int res;
+
+	sensors_read_begin();
+	res = __sensors_get_stats(name, subfeat_nr, stats);
+	sensors_read_end();
+	return res;
+}
@@ -0,0 +1,65 @@
+/*
+    stats.h - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#ifndef LIB_SENSORS_STATS_H
+#define LIB_SENSORS_STATS_H
+
+#include <stdint.h>
+#include "sensors.h"
+#include "data.h"
+
+/* Non-zero if statistics are collected */
+extern int sensors_stats_enabled;
+
+/* Kinds of subfeature accesses */
+#define SENSORS_STATS_READ	0
+#define SENSORS_STATS_WRITE	1
+#define SENSORS_STATS_HIT	2	/* Value shared by another read */
+#define SENSORS_STATS_SUPPRESSED 3	/* Read of a failing subfeature */
+
+/* Decide whether statistics are collected, from the application setting
+   or the environment. Called by sensors_init(). */
+void sensors_stats_init(void);
+
+/* Set up the statistics of the subfeatures of a detected chip */
+void sensors_stats_init_chip(sensors_chip_features *chip_features);
+
+/* The statistics of the calling thread. Only this thread updates them. */
+sensors_stats *sensors_stats_thread(void);
+
+/* Add n to a counter of the calling thread */
+#define sensors_stats_add(counter, n) do { \
+	if (__atomic_load_n(&sensors_stats_enabled, __ATOMIC_RELAXED)) { \
+		sensors_stats *stats__ = sensors_stats_thread(); \
+		__atomic_store_n(&stats__->counter, stats__->counter + (n), \
+				 __ATOMIC_RELAXED); \
+	} \
+} while (0)
+
+/* Start time of an access, in nanoseconds, 0 if statistics are not
+   collected */
+uint64_t sensors_stats_start(void);
+
+/* Account for an access to a subfeature, which started at start and
+   returned err */
+void sensors_stats_attr(const sensors_chip_features *chip_features,
+			const sensors_subfeature *subfeature, int kind,
+			uint64_t start, int err);
+
+#endif /* def LIB_SENSORS_STATS_H */
@@ -26,29 +26,55 @@
 #include <sys/stat.h>
 #include <sys/vfs.h>
 #include <unistd.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
 #include <errno.h>
 #include <dirent.h>
+#include <pthread.h>
 #include "data.h"
 #include "error.h"
 #include "access.h"
 #include "general.h"
 #include "sysfs.h"
+#include "stats.h"
+#include "probes.h"
 
 
 /****************************************************************************/
 
 #define ATTR_MAX	128
 #define SYSFS_MAGIC	0x62656572
+#define SYSFS_MAX_THREADS	16
+
+/* Number of threads used to scan the hwmon devices, 0 for none, -1 until
+   set by the application, then the environment decides */
+static int sysfs_threads = -1;
+
+/* The discovery threads share the table of interned names */
+static pthread_mutex_t sysfs_names_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char *sysfs_intern_namen(const char *s, size_t n)
+{
+	char *name;
+
+	pthread_mutex_lock(&sysfs_names_lock);
+	name = sensors_intern_namen(s, n);
+	pthread_mutex_unlock(&sysfs_names_lock);
+	return name;
+}
+
+#define sysfs_intern_name(s)	sysfs_intern_namen((s), strlen(s))
 
 /*
  * Read an attribute from sysfs
- * Returns a pointer to a freshly allocated string; free it yourself.
+ * Returns a pointer to a freshly allocated string, from the given arena if
+ * not NULL, otherwise from the heap (free it yourself in that case).
  * If the file doesn't exist or can't be read, NULL is returned.
  */
-static char *sysfs_read_attr(const char *device, const char *attr)
+static char *sysfs_read_attr(sensors_arena *arena, const char *device,
+			     const char *attr)
 {
 	char path[NAME_MAX];
 	char buf[ATTR_MAX], *p;
@@ -56,14 +82,18 @@ static char *sysfs_read_attr(const char *device, const char *attr)
 
 	snprintf(path, NAME_MAX, "%s/%s", device, attr);
 
+	sensors_stats_add(sysfs_opens, 1);
 	if (!(f = fopen(path, "r")))
 		return NULL;
 	p = fgets(buf, ATTR_MAX, f);
 	fclose(f);
 	if (!p)
 		return NULL;
+	sensors_stats_add(bytes_read, strlen(buf));
 
 	/* Last byte is a '\n'; chop that off */
+	if (arena)
+		return sensors_arena_strndup(arena, buf, strlen(buf) - 1);
 	p = strndup(buf, strlen(buf) - 1);
 	if (!p)
 		sensors_fatal_error(__func__, "Out of memory");
@@ -134,10 +164,90 @@ static int sysfs_foreach_busdev(const char *bus_type,
 	return ret;
 }
 
+/*
+ * Mix the identity of a sysfs entry into a fingerprint. The entries are
+ * combined by addition so that the result doesn't depend on the order in
+ * which readdir() returns them.
+ */
+static uint64_t sysfs_stat_hash(const char *name, const struct stat *st)
+{
+	uint64_t h = 14695981039346656037ULL;	/* FNV-1a */
+	const unsigned char *p;
+	uint64_t v[4];
+	size_t i;
+
+	for (p = (const unsigned char *)name; *p; p++) {
+		h ^= *p;
+		h *= 1099511628211ULL;
+	}
+
+	v[0] = st->st_ino;
+	v[1] = st->st_dev;
+	v[2] = st->st_mtim.tv_sec;
+	v[3] = st->st_mtim.tv_nsec;
+	for (p = (const unsigned char *)v, i = 0; i < sizeof(v); i++) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+static uint64_t sysfs_class_fingerprint(const char *class_name)
+{
+	char path[NAME_MAX];
+	int path_off;
+	DIR *dir;
+	struct dirent *ent;
+	struct stat st;
+	uint64_t fp;
+
+	path_off = snprintf(path, NAME_MAX, "%s/class/%s",
+			    sensors_sysfs_mount, class_name);
+	if (stat(path, &st) < 0)
+		return 0;
+	fp = sysfs_stat_hash(path, &st);
+
+	if (!(dir = opendir(path)))
+		return fp;
+
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')	/* skip hidden entries */
+			continue;
+
+		/* The class device link itself, which is recreated when
+		   the device goes away and comes back */
+		snprintf(path + path_off, NAME_MAX - path_off, "/%s",
+			 ent->d_name);
+		if (lstat(path, &st) == 0)
+			fp += sysfs_stat_hash(ent->d_name, &st);
+
+		/* The device it points to */
+		snprintf(path + path_off, NAME_MAX - path_off, "/%s/device",
+			 ent->d_name);
+		if (stat(path, &st) == 0)
+			fp += sysfs_stat_hash(ent->d_name, &st);
+	}
+	closedir(dir);
+
+	return fp;
+}
+
 /****************************************************************************/
 
 char sensors_sysfs_mount[NAME_MAX];
 
+/* Compute a cheap fingerprint of the hwmon and i2c-adapter class
+   directories. It changes whenever a device is added or removed, so it
+   can be used to validate a cache of the discovery results. */
+uint64_t sensors_sysfs_fingerprint(void)
+{
+	uint64_t fp;
+
+	fp = sysfs_class_fingerprint("hwmon");
+	fp = fp * 1099511628211ULL + sysfs_class_fingerprint("i2c-adapter");
+	return fp;
+}
+
 #define MAX_MAIN_SENSOR_TYPES	(SENSORS_FEATURE_MAX_MAIN - SENSORS_FEATURE_IN)
 #define MAX_OTHER_SENSOR_TYPES	(SENSORS_FEATURE_MAX_OTHER - SENSORS_FEATURE_VID)
 #define MAX_SENSORS_PER_TYPE	24
@@ -183,6 +293,8 @@ int get_type_scaling(sensors_subfeature_type type)
 	}
 }
 
+/* Return the interned name of the feature a subfeature belongs to.
+   sfname must be interned already. */
 static
 char *get_feature_name(sensors_feature_type ftype, char *sfname)
 {
@@ -198,15 +310,10 @@ char *get_feature_name(sensors_feature_type ftype, char *sfname)
 	case SENSORS_FEATURE_HUMIDITY:
 	case SENSORS_FEATURE_INTRUSION:
 		underscore = strchr(sfname, '_');
-		name = strndup(sfname, underscore - sfname);
-		if (!name)
-			sensors_fatal_error(__func__, "Out of memory");
-
+		name = sysfs_intern_namen(sfname, underscore - sfname);
 		break;
 	default:
-		name = strdup(sfname);
-		if (!name)
-			sensors_fatal_error(__func__, "Out of memory");
+		name = sfname;
 	}
 
 	return name;
@@ -353,7 +460,6 @@ static struct feature_type_match matches[] = {
 
 /* Return the subfeature type and channel number based on the subfeature
    name */
-static
 sensors_subfeature_type sensors_subfeature_get_type(const char *name, int *nr)
 {
 	char c;
@@ -425,11 +531,20 @@ static int sensors_get_attr_mode(const char *device, const char *attr)
 	return mode;
 }
 
+/* Computed once, before any discovery thread is started */
+static int max_subfeatures;
+static pthread_once_t max_subfeatures_once = PTHREAD_ONCE_INIT;
+
+static void sensors_init_max_subfeatures(void)
+{
+	max_subfeatures = sensors_compute_max();
+}
+
 static int sensors_read_dynamic_chip(sensors_chip_features *chip,
-				     const char *dev_path)
+				     const char *dev_path,
+				     sensors_arena *arena)
 {
 	int i, fnum = 0, sfnum = 0, prev_slot;
-	static int max_subfeatures;
 	DIR *dir;
 	struct dirent *ent;
 	sensors_subfeature *all_subfeatures;
@@ -442,8 +557,7 @@ static int sensors_read_dynamic_chip(sensors_chip_features *chip,
 		return -errno;
 
 	/* Dynamically figure out the max number of subfeatures */
-	if (!max_subfeatures)
-		max_subfeatures = sensors_compute_max();
+	pthread_once(&max_subfeatures_once, sensors_init_max_subfeatures);
 
 	/* We use a large sparse table at first to store all found
 	   subfeatures, so that we can store them sorted at type and index
@@ -521,9 +635,7 @@ static int sensors_read_dynamic_chip(sensors_chip_features *chip,
 
 		/* fill in the subfeature members */
 		all_subfeatures[i].type = sftype;
-		all_subfeatures[i].name = strdup(name);
-		if (!all_subfeatures[i].name)
-			sensors_fatal_error(__func__, "Out of memory");
+		all_subfeatures[i].name = sysfs_intern_name(name);
 
 		/* Other and misc subfeatures are never scaled */
 		if (sftype < SENSORS_SUBFEATURE_VID && !(sftype & 0x80))
@@ -551,10 +663,10 @@ static int sensors_read_dynamic_chip(sensors_chip_features *chip,
 		}
 	}
 
-	dyn_subfeatures = calloc(sfnum, sizeof(sensors_subfeature));
-	dyn_features = calloc(fnum, sizeof(sensors_feature));
-	if (!dyn_subfeatures || !dyn_features)
-		sensors_fatal_error(__func__, "Out of memory");
+	dyn_subfeatures = sensors_arena_calloc(arena, sfnum,
+					       sizeof(sensors_subfeature));
+	dyn_features = sensors_arena_calloc(arena, fnum,
+					    sizeof(sensors_feature));
 
 	/* Copy from the sparse array to the compact array */
 	sfnum = 0;
@@ -595,12 +707,20 @@ exit_free:
 	return 0;
 }
 
+static pthread_once_t sysfs_mount_once = PTHREAD_ONCE_INIT;
+
+static void sensors_set_sysfs_mount(void)
+{
+	snprintf(sensors_sysfs_mount, NAME_MAX, "%s", "/sys");
+}
+
 /* returns !0 if sysfs filesystem was found, 0 otherwise */
 int sensors_init_sysfs(void)
 {
 	struct statfs statfsbuf;
 
-	snprintf(sensors_sysfs_mount, NAME_MAX, "%s", "/sys");
+	/* Other contexts may be using it already */
+	pthread_once(&sysfs_mount_once, sensors_set_sysfs_mount);
 	if (statfs(sensors_sysfs_mount, &statfsbuf) < 0
 	 || statfsbuf.f_type != SYSFS_MAGIC)
 		return 0;
@@ -608,10 +728,13 @@ int sensors_init_sysfs(void)
 	return 1;
 }
 
-/* returns: number of devices added (0 or 1) if successful, <0 otherwise */
+/* returns: number of devices found (0 or 1) if successful, <0 otherwise.
+   The chip found, if any, is allocated from arena and returned in *res. */
 static int sensors_read_one_sysfs_chip(const char *dev_path,
 				       const char *dev_name,
-				       const char *hwmon_path)
+				       const char *hwmon_path,
+				       sensors_arena *arena,
+				       sensors_chip_features **res)
 {
 	int domain, bus, slot, fn, vendor, product, id;
 	int err = -SENSORS_ERR_KERNEL;
@@ -620,15 +743,22 @@ static int sensors_read_one_sysfs_chip(const char *dev_path,
 	char linkpath[NAME_MAX];
 	char subsys_path[NAME_MAX], *subsys;
 	int sub_len;
+	char *name;
 	sensors_chip_features entry;
+	sensors_arena_mark mark;
 
 	/* ignore any device without name attribute */
-	if (!(entry.chip.prefix = sysfs_read_attr(hwmon_path, "name")))
+	if (!(name = sysfs_read_attr(NULL, hwmon_path, "name")))
 		return 0;
+	memset(&entry, 0, sizeof(entry));
+	entry.chip.prefix = sysfs_intern_name(name);
+	free(name);
 
-	entry.chip.path = strdup(hwmon_path);
-	if (!entry.chip.path)
-		sensors_fatal_error(__func__, "Out of memory");
+	/* Everything allocated for a chip we end up discarding is given
+	   back to the arena */
+	sensors_arena_get_mark(arena, &mark);
+
+	entry.chip.path = sensors_arena_strdup(arena, hwmon_path);
 
 	if (dev_path == NULL) {
 		/* Virtual device */
@@ -672,7 +802,8 @@ static int sensors_read_one_sysfs_chip(const char *dev_path,
 				"%s/class/i2c-adapter/i2c-%d/device",
 				sensors_sysfs_mount, entry.chip.bus.nr);
 
-			if ((bus_attr = sysfs_read_attr(bus_path, "name"))) {
+			if ((bus_attr = sysfs_read_attr(NULL, bus_path,
+							"name"))) {
 				if (!strncmp(bus_attr, "ISA ", 4)) {
 					entry.chip.bus.type = SENSORS_BUS_TYPE_ISA;
 					entry.chip.bus.nr = 0;
@@ -721,30 +852,34 @@ static int sensors_read_one_sysfs_chip(const char *dev_path,
 	}
 
 done:
-	if (sensors_read_dynamic_chip(&entry, hwmon_path) < 0)
+	if (sensors_read_dynamic_chip(&entry, hwmon_path, arena) < 0)
 		goto exit_free;
 	if (!entry.subfeature) { /* No subfeature, discard chip */
 		err = 0;
 		goto exit_free;
 	}
-	sensors_add_proc_chips(&entry);
+	*res = sensors_arena_alloc(arena, sizeof(**res));
+	**res = entry;
 
 	return 1;
 
 exit_free:
-	free(entry.chip.prefix);
-	free(entry.chip.path);
+	sensors_arena_rewind(arena, &mark);
 	return err;
 }
 
 static int sensors_add_hwmon_device_compat(const char *path,
 					   const char *dev_name)
 {
+	sensors_chip_features *chip;
 	int err;
 
-	err = sensors_read_one_sysfs_chip(path, dev_name, path);
+	err = sensors_read_one_sysfs_chip(path, dev_name, path,
+					  &sensors_proc_arena, &chip);
 	if (err < 0)
 		return err;
+	if (err)
+		sensors_add_proc_chips(&chip);
 	return 0;
 }
 
@@ -760,40 +895,289 @@ static int sensors_read_sysfs_chips_compat(void)
 	return 0;
 }
 
-static int sensors_add_hwmon_device(const char *path, const char *classdev)
+/* returns: number of devices found (0 or 1) if successful, <0 otherwise.
+   The chip found, if any, is allocated from arena and returned in *res. */
+static int sensors_read_hwmon_device(const char *path, sensors_arena *arena,
+				     sensors_chip_features **res)
 {
 	char linkpath[NAME_MAX];
 	char device[NAME_MAX], *device_p;
 	int dev_len, err;
-	(void)classdev; /* hide warning */
 
 	snprintf(linkpath, NAME_MAX, "%s/device", path);
 	dev_len = readlink(linkpath, device, NAME_MAX - 1);
 	if (dev_len < 0) {
 		/* No device link? Treat as virtual */
-		err = sensors_read_one_sysfs_chip(NULL, NULL, path);
+		err = sensors_read_one_sysfs_chip(NULL, NULL, path, arena,
+						  res);
 	} else {
 		device[dev_len] = '\0';
 		device_p = strrchr(device, '/') + 1;
 
 		/* The attributes we want might be those of the hwmon class
 		   device, or those of the device itself. */
-		err = sensors_read_one_sysfs_chip(linkpath, device_p, path);
+		err = sensors_read_one_sysfs_chip(linkpath, device_p, path,
+						  arena, res);
 		if (err == 0)
 			err = sensors_read_one_sysfs_chip(linkpath, device_p,
-							  linkpath);
+							  linkpath, arena, res);
 	}
+	return err;
+}
+
+static int sensors_add_hwmon_device(const char *path, const char *classdev)
+{
+	sensors_chip_features *chip;
+	int err;
+	(void)classdev; /* hide warning */
+
+	err = sensors_read_hwmon_device(path, &sensors_proc_arena, &chip);
 	if (err < 0)
 		return err;
+	if (err)
+		sensors_add_proc_chips(&chip);
+	return 0;
+}
+
+/* Add the chip of a hwmon class device which appeared after
+   sensors_init(). It gets its own arena so that it can be freed by
+   sensors_sysfs_remove_hwmon() later. Returns the new chip, or NULL if
+   the device has no usable chip. */
+sensors_chip_features *sensors_sysfs_add_hwmon(const char *classdev)
+{
+	char path[NAME_MAX];
+	sensors_arena arena;
+	sensors_chip_features *chip;
+
+	snprintf(path, NAME_MAX, "%s/class/hwmon/%s", sensors_sysfs_mount,
+		 classdev);
+
+	memset(&arena, 0, sizeof(arena));
+	if (sensors_read_hwmon_device(path, &arena, &chip) <= 0) {
+		sensors_arena_free(&arena);
+		return NULL;
+	}
+
+	chip->arena = arena;
+	sensors_add_proc_chips(&chip);
+	return chip;
+}
+
+/* Return the arena to allocate the data set up for a chip after its
+   detection from. Chips added by sensors_sysfs_add_hwmon() have their
+   own, so that this data goes away with them; the others share the arena
+   of the detected chips. */
+sensors_arena *sensors_chip_arena(sensors_chip_features *chip_features)
+{
+	return chip_features->arena.block ? &chip_features->arena :
+					    &sensors_proc_arena;
+}
+
+/* Find the chip of a hwmon class device, or return -1 */
+int sensors_sysfs_find_hwmon(const char *classdev)
+{
+	char path[NAME_MAX];
+	int i, len;
+
+	len = snprintf(path, NAME_MAX, "%s/class/hwmon/%s",
+		       sensors_sysfs_mount, classdev);
+
+	/* The chip path is either the class device or its device link */
+	for (i = 0; i < sensors_proc_chips_count; i++) {
+		const char *chip_path = sensors_proc_chips[i]->chip.path;
+
+		if (!strncmp(chip_path, path, len) &&
+		    (chip_path[len] == '\0' ||
+		     !strcmp(chip_path + len, "/device")))
+			return i;
+	}
+	return -1;
+}
+
+/* Remove a chip from the list of detected chips. Readers may still use
+   it, so its memory is only released by
+   sensors_sysfs_free_removed_chips(). */
+void sensors_sysfs_remove_chip(int nr)
+{
+	sensors_chip_features *chip = sensors_proc_chips[nr];
+
+	memmove(sensors_proc_chips + nr, sensors_proc_chips + nr + 1,
+		(sensors_proc_chips_count - nr - 1) * sizeof(*sensors_proc_chips));
+	sensors_proc_chips_count--;
+	sensors_chips_changed();
+	sensors_add_removed_chips(&chip);
+}
+
+/* Release the memory of the removed chips, if they have their own */
+void sensors_sysfs_free_removed_chips(void)
+{
+	sensors_arena arena;
+	int i;
+
+	for (i = 0; i < sensors_removed_chips_count; i++) {
+		arena = sensors_removed_chips[i]->arena;
+		sensors_arena_free(&arena);
+	}
+	free(sensors_removed_chips);
+	sensors_removed_chips = NULL;
+	sensors_removed_chips_count = sensors_removed_chips_max = 0;
+}
+
+/*
+ * Parallel discovery: the hwmon class devices are listed first, then
+ * scanned by a pool of threads, each allocating from its own arena. The
+ * chips found are added in the order of the list, so the result is the
+ * same as that of a serial scan.
+ */
+struct sysfs_scan_job {
+	char path[NAME_MAX];
+	sensors_chip_features *chip;
+	int err;
+};
+
+struct sysfs_scan_pool {
+	sensors_context *ctx;	/* The context the chips are found for */
+	struct sysfs_scan_job *jobs;
+	int jobs_count;
+	int jobs_max;
+	int next;		/* Next job to run, protected by lock */
+	pthread_mutex_t lock;
+};
+
+struct sysfs_scan_worker {
+	pthread_t thread;
+	struct sysfs_scan_pool *pool;
+	sensors_arena arena;
+};
+
+static void *sysfs_scan_worker(void *arg)
+{
+	struct sysfs_scan_worker *worker = arg;
+	struct sysfs_scan_pool *pool = worker->pool;
+	struct sysfs_scan_job *job;
+	sensors_context *prev;
+	int i;
+
+	/* Names are interned in the table of the calling context */
+	prev = sensors_context_enter(pool->ctx);
+	for (;;) {
+		pthread_mutex_lock(&pool->lock);
+		i = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+		if (i >= pool->jobs_count)
+			break;
+
+		job = &pool->jobs[i];
+		job->err = sensors_read_hwmon_device(job->path, &worker->arena,
+						     &job->chip);
+	}
+	sensors_context_leave(prev);
+
+	return NULL;
+}
+
+static __thread struct sysfs_scan_pool *sysfs_scan_pool_cur;
+
+static int sysfs_scan_add_job(const char *path, const char *classdev)
+{
+	struct sysfs_scan_job job;
+	(void)classdev; /* hide warning */
+
+	snprintf(job.path, NAME_MAX, "%s", path);
+	job.chip = NULL;
+	job.err = 0;
+	sensors_add_array_el(&job, &sysfs_scan_pool_cur->jobs,
+			     &sysfs_scan_pool_cur->jobs_count,
+			     &sysfs_scan_pool_cur->jobs_max, sizeof(job));
+	return 0;
+}
+
+static int sensors_read_sysfs_chips_parallel(int threads)
+{
+	struct sysfs_scan_pool pool;
+	struct sysfs_scan_worker *workers;
+	int i, started, ret;
+
+	memset(&pool, 0, sizeof(pool));
+	pool.ctx = sensors_current_context;
+	sysfs_scan_pool_cur = &pool;
+	ret = sysfs_foreach_classdev("hwmon", sysfs_scan_add_job);
+	sysfs_scan_pool_cur = NULL;
+	if (ret) {
+		free(pool.jobs);
+		return ret;
+	}
+
+	if (threads > pool.jobs_count)
+		threads = pool.jobs_count;
+	workers = calloc(threads ? threads : 1, sizeof(*workers));
+	if (!workers)
+		sensors_fatal_error(__func__, "Out of memory");
+
+	/* Must be done before any thread uses it */
+	pthread_once(&max_subfeatures_once, sensors_init_max_subfeatures);
+
+	pthread_mutex_init(&pool.lock, NULL);
+	for (i = 0; i < threads; i++)
+		workers[i].pool = &pool;
+
+	/* The calling thread is worker 0 */
+	for (started = 1; started < threads; started++) {
+		if (pthread_create(&workers[started].thread, NULL,
+				   sysfs_scan_worker, &workers[started]))
+			break;
+	}
+	if (threads)
+		sysfs_scan_worker(&workers[0]);
+	for (i = 1; i < started; i++)
+		pthread_join(workers[i].thread, NULL);
+	pthread_mutex_destroy(&pool.lock);
+
+	for (i = 0; i < threads; i++)
+		sensors_arena_merge(&sensors_proc_arena, &workers[i].arena);
+	free(workers);
+
+	for (i = 0; i < pool.jobs_count; i++) {
+		if (pool.jobs[i].err < 0) {
+			ret = pool.jobs[i].err;
+			break;
+		}
+		if (pool.jobs[i].chip)
+			sensors_add_proc_chips(&pool.jobs[i].chip);
+	}
+
+	free(pool.jobs);
+	return ret;
+}
+
+int sensors_set_discovery_threads(int threads)
+{
+	if (threads < 0)
+		return -SENSORS_ERR_PARSE;
+	if (threads > SYSFS_MAX_THREADS)
+		threads = SYSFS_MAX_THREADS;
+	sysfs_threads = threads;
 	return 0;
 }
 
 /* returns 0 if successful, !0 otherwise */
 int sensors_read_sysfs_chips(void)
 {
-	int ret;
+	const char *env;
+	int threads, ret;
+
+	threads = sysfs_threads;
+	if (threads < 0) {
+		env = getenv("LIBSENSORS_DISCOVERY_THREADS");
+		threads = env ? atoi(env) : 0;
+		if (threads > SYSFS_MAX_THREADS)
+			threads = SYSFS_MAX_THREADS;
+	}
 
-	ret = sysfs_foreach_classdev("hwmon", sensors_add_hwmon_device);
+	if (threads > 1)
+		ret = sensors_read_sysfs_chips_parallel(threads);
+	else
+		ret = sysfs_foreach_classdev("hwmon", sensors_add_hwmon_device);
 	if (ret == ENOENT) {
 		/* compatibility function for kernel 2.6.n where n <= 13 */
 		return sensors_read_sysfs_chips_compat();
@@ -817,9 +1201,10 @@ static int sensors_add_i2c_bus(const char *path, const char *classdev)
 	/* Get the adapter name from the classdev "name" attribute
 	 * (Linux 2.6.20 and later). If it fails, fall back to
 	 * the device "name" attribute (for older kernels). */
-	entry.adapter = sysfs_read_attr(path, "name");
+	entry.adapter = sysfs_read_attr(&sensors_proc_arena, path, "name");
 	if (!entry.adapter)
-		entry.adapter = sysfs_read_attr(path, "device/name");
+		entry.adapter = sysfs_read_attr(&sensors_proc_arena, path,
+						"device/name");
 	if (entry.adapter)
 		sensors_add_proc_bus(&entry);
 
@@ -840,9 +1225,9 @@ int sensors_read_sysfs_bus(void)
 	return 0;
 }
 
-int sensors_read_sysfs_attr(const sensors_chip_name *name,
-			    const sensors_subfeature *subfeature,
-			    double *value)
+static int __sensors_read_sysfs_attr(const sensors_chip_name *name,
+				     const sensors_subfeature *subfeature,
+				     double *value)
 {
 	char n[NAME_MAX];
 	FILE *f;
@@ -857,6 +1242,8 @@ int sensors_read_sysfs_attr(const sensors_chip_name *name,
 			err = -SENSORS_ERR_IO;
 		else if (res != 1)
 			err = -SENSORS_ERR_ACCESS_R;
+		else
+			sensors_stats_add(bytes_read, ftell(f));
 		res = fclose(f);
 		if (err)
 			return err;
@@ -874,9 +1261,21 @@ int sensors_read_sysfs_attr(const sensors_chip_name *name,
 	return 0;
 }
 
-int sensors_write_sysfs_attr(const sensors_chip_name *name,
-			     const sensors_subfeature *subfeature,
-			     double value)
+int sensors_read_sysfs_attr(const sensors_chip_name *name,
+			    const sensors_subfeature *subfeature,
+			    double *value)
+{
+	int err;
+
+	SENSORS_PROBE2(read_attr_start, name->path, subfeature->name);
+	err = __sensors_read_sysfs_attr(name, subfeature, value);
+	SENSORS_PROBE3(read_attr_done, name->path, subfeature->name, err);
+	return err;
+}
+
+static int __sensors_write_sysfs_attr(const sensors_chip_name *name,
+				      const sensors_subfeature *subfeature,
+				      double value)
 {
 	char n[NAME_MAX];
 	FILE *f;
@@ -906,3 +1305,15 @@ int sensors_write_sysfs_attr(const sensors_chip_name *name,
 
 	return 0;
 }
+
+int sensors_write_sysfs_attr(const sensors_chip_name *name,
+			     const sensors_subfeature *subfeature,
+			     double value)
+{
+	int err;
+
+	SENSORS_PROBE2(write_attr_start, name->path, subfeature->name);
+	err = __sensors_write_sysfs_attr(name, subfeature, value);
+	SENSORS_PROBE3(write_attr_done, name->path, subfeature->name, err);
+	return err;
+}
@@ -22,14 +22,40 @@
 #ifndef SENSORS_LIB_SYSFS_H
 #define SENSORS_LIB_SYSFS_H
 
+#include <stdint.h>
+
 extern char sensors_sysfs_mount[];
 
 int sensors_init_sysfs(void);
 
+/* Fingerprint of the hwmon and i2c-adapter class devices, to validate
+   cached discovery results */
+uint64_t sensors_sysfs_fingerprint(void);
+
 int sensors_read_sysfs_chips(void);
 
+/* Add the chip of a new hwmon class device (e.g. "hwmon3") */
+sensors_chip_features *sensors_sysfs_add_hwmon(const char *classdev);
+
+/* The arena the data set up for a chip after its detection belongs to */
+sensors_arena *sensors_chip_arena(sensors_chip_features *chip_features);
+
+/* Find the chip of a hwmon class device, returns its index in
+   sensors_proc_chips or -1 */
+int sensors_sysfs_find_hwmon(const char *classdev);
+
+/* Remove a chip from the list of detected chips. It is freed by
+   sensors_sysfs_free_removed_chips(), once no reader uses it. */
+void sensors_sysfs_remove_chip(int nr);
+void sensors_sysfs_free_removed_chips(void);
+
 int sensors_read_sysfs_bus(void);
 
+/* Return the subfeature type and channel number based on the subfeature
+   name, SENSORS_SUBFEATURE_UNKNOWN if it isn't known */
+sensors_subfeature_type sensors_subfeature_get_type(const char *name,
+						    int *nr);
+
 /* Read a value out of a sysfs attribute file */
 int sensors_read_sysfs_attr(const sensors_chip_name *name,
 			    const sensors_subfeature *subfeature,
@@ -1,8 +1,8 @@
 LIB_DIR		:= lib
 LIB_TEST_DIR	:= lib/test
 
-LIB_TEST_TARGETS := $(LIB_TEST_DIR)/test-scanner
-LIB_TEST_SOURCES := $(LIB_TEST_DIR)/test-scanner.c
+LIB_TEST_TARGETS := $(LIB_TEST_DIR)/test-scanner $(LIB_TEST_DIR)/bench-reads
+LIB_TEST_SOURCES := $(LIB_TEST_DIR)/test-scanner.c $(LIB_TEST_DIR)/bench-reads.c
 
 LIB_TEST_SCANNER_OBJS := \
 	$(LIB_TEST_DIR)/test-scanner.ro \
@@ -13,6 +13,10 @@ LIB_TEST_SCANNER_OBJS := \
 $(LIB_TEST_DIR)/test-scanner: $(LIB_TEST_SCANNER_OBJS)
 	$(CC) $(EXLDFLAGS) -o $@ $(LIB_TEST_SCANNER_OBJS) -Llib
 
+# Run with LD_LIBRARY_PATH=lib to benchmark the library of the tree
+$(LIB_TEST_DIR)/bench-reads: $(LIB_TEST_DIR)/bench-reads.ro $(LIB_DIR)/$(LIBSHBASENAME)
+	$(CC) $(EXLDFLAGS) -o $@ $(LIB_TEST_DIR)/bench-reads.ro -Llib -lsensors -lpthread -ldl
+
 all-lib-test: $(LIB_TEST_TARGETS)
 user :: all-lib-test
 
@@ -0,0 +1,190 @@
+/*
+    bench-reads.c - Stress benchmark for concurrent reads in libsensors.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2 of the License.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+/*
+ * Several threads read all the subfeatures of all the detected chips in
+ * lockstep, as monitoring agents polling the same sensors would, first
+ * with read coalescing disabled, then enabled. The sysfs attribute files
+ * opened by the library are counted by wrapping fopen(), each of them
+ * being one transaction on the bus of the chip. A delay can be added to
+ * every file opened, to simulate a slow bus (SMBus reads typically take
+ * hundreds of microseconds) where sysfs is fast, such as a test tree.
+ *
+ * Usage: bench-reads [threads [rounds [delay_us]]]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <pthread.h>
+
+#include "../sensors.h"
+#include "../error.h"
+
+struct bench_item {
+	const sensors_chip_name *chip;
+	int nr;
+};
+
+static struct bench_item *items;
+static int items_count;
+static int rounds = 100;
+static pthread_barrier_t barrier;
+
+static long opens;
+static int counting;
+static int delay_us;
+
+FILE *fopen(const char *path, const char *mode)
+{
+	static FILE *(*real_fopen)(const char *, const char *);
+
+	if (!real_fopen)
+		real_fopen = (FILE *(*)(const char *, const char *))
+			     dlsym(RTLD_NEXT, "fopen");
+	if (__atomic_load_n(&counting, __ATOMIC_RELAXED)) {
+		__atomic_fetch_add(&opens, 1, __ATOMIC_RELAXED);
+		if (delay_us)
+			usleep(delay_us);
+	}
+	return real_fopen(path, mode);
+}
+
+static int collect_items(void)
+{
+	const sensors_chip_name *chip;
+	const sensors_feature *feature;
+	const sensors_subfeature *sub;
+	int c = 0, f, s, max = 0;
+
+	items_count = 0;
+	while ((chip = sensors_get_detected_chips(NULL, &c))) {
+		f = 0;
+		while ((feature = sensors_get_features(chip, &f))) {
+			s = 0;
+			while ((sub = sensors_get_all_subfeatures(chip, feature,
+								  &s))) {
+				if (!(sub->flags & SENSORS_MODE_R))
+					continue;
+				if (items_count == max) {
+					max = max ? max * 2 : 64;
+					items = realloc(items,
+							max * sizeof(*items));
+					if (!items)
+						return -1;
+				}
+				items[items_count].chip = chip;
+				items[items_count].nr = sub->number;
+				items_count++;
+			}
+		}
+	}
+	return items_count;
+}
+
+static void *reader(void *arg)
+{
+	double value;
+	int r, i;
+
+	(void)arg;
+	for (r = 0; r < rounds; r++) {
+		pthread_barrier_wait(&barrier);
+		for (i = 0; i < items_count; i++)
+			sensors_get_value(items[i].chip, items[i].nr, &value);
+	}
+	return NULL;
+}
+
+static int run(int coalesce, int threads)
+{
+	struct timespec start, end;
+	pthread_t *tids;
+	double elapsed;
+	long requests;
+	int i, err;
+
+	sensors_set_read_coalescing(coalesce);
+	err = sensors_init(NULL);
+	if (err) {
+		fprintf(stderr, "sensors_init: %s\n",
+			sensors_strerror(err));
+		return 1;
+	}
+	if (collect_items() <= 0) {
+		fprintf(stderr, "No readable subfeatures found\n");
+		sensors_cleanup();
+		return 1;
+	}
+
+	tids = malloc(threads * sizeof(*tids));
+	if (!tids)
+		return 1;
+	pthread_barrier_init(&barrier, NULL, threads);
+	opens = 0;
+	__atomic_store_n(&counting, 1, __ATOMIC_SEQ_CST);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < threads; i++)
+		pthread_create(&tids[i], NULL, reader, NULL);
+	for (i = 0; i < threads; i++)
+		pthread_join(tids[i], NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	__atomic_store_n(&counting, 0, __ATOMIC_SEQ_CST);
+	pthread_barrier_destroy(&barrier);
+	free(tids);
+
+	elapsed = (end.tv_sec - start.tv_sec) +
+		  (end.tv_nsec - start.tv_nsec) / 1e9;
+	requests = (long)threads * rounds * items_count;
+	printf("%-13s %10ld requests %10ld sysfs reads (%5.1f%%) %8.3f s\n",
+	       coalesce ? "coalesced:" : "uncoalesced:", requests, opens,
+	       100.0 * opens / requests, elapsed);
+
+	sensors_cleanup();
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int threads = 8;
+
+	if (argc > 1)
+		threads = atoi(argv[1]);
+	if (argc > 2)
+		rounds = atoi(argv[2]);
+	if (argc > 3)
+		delay_us = atoi(argv[3]);
+	if (threads < 1 || rounds < 1 || delay_us < 0) {
+		fprintf(stderr, "Usage: %s [threads [rounds [delay_us]]]\n",
+			argv[0]);
+		return 1;
+	}
+
+	printf("%d threads, %d rounds, %d us delay\n", threads, rounds,
+	       delay_us);
+	if (run(0, threads) || run(1, threads))
+		return 1;
+
+	free(items);
+	return 0;
+}
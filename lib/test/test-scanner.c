@@ -21,24 +21,27 @@
 #include <stdlib.h>
 
 #include "../data.h"
-#include "../conf.h"
-#include "../conf-parse.h"
 #include "../scanner.h"
+#include "../conf-parse.h"
+#include "../conf.h"
 
-YYSTYPE sensors_yylval;
+static sensors_context context;
+__thread sensors_context *sensors_current_context = &context;
 
 int main(void)
 {
 	int result;
+	sensors_scanner scanner;
+	YYSTYPE lval;
 
 	/* init the scanner */
-	if ((result = sensors_scanner_init(stdin, NULL)))
+	if ((result = sensors_scanner_init(&scanner, stdin, NULL)))
 		return result;
 
 	do {
-		result = sensors_yylex();
+		result = sensors_yylex(&lval, &scanner);
 
-		printf("%d: ", sensors_yylineno);
+		printf("%d: ", scanner.lineno);
 
 		switch (result) {
 
@@ -78,13 +81,24 @@ int main(void)
 				printf("IGNORE\n");
 				break;
 	
+			case SUSPENDED:
+				printf("SUSPENDED\n");
+				break;
+	
+			case VIRTUAL:
+				printf("VIRTUAL\n");
+				break;
+	
+			case GROUP:
+				printf("GROUP\n");
+				break;
+	
 			case FLOAT:
-				printf("FLOAT: %f\n", sensors_yylval.value);
+				printf("FLOAT: %f\n", lval.value);
 				break;
 	
 			case NAME:
-				printf("NAME: %s\n", sensors_yylval.name);
-				free(sensors_yylval.name);
+				printf("NAME: %s\n", lval.name);
 				break;
 	
 			case ERROR:
@@ -99,7 +113,8 @@ int main(void)
 	} while (result);
 
 	/* clean up the scanner */
-	sensors_scanner_exit();
+	sensors_scanner_exit(&scanner);
+	sensors_arena_free(&sensors_config_arena);
 
 	return 0;
 }
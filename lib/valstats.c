@@ -0,0 +1,177 @@
+/*
+    valstats.c - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "sensors.h"
+#include "data.h"
+#include "error.h"
+#include "access.h"
+#include "sysfs.h"
+#include "valstats.h"
+
+/*
+ * Value statistics: the values returned to the application (after
+ * compute statements) are accumulated per subfeature, so that
+ * applications can compare smoothed values against thresholds without
+ * keeping their own history. Each read of the device is accounted once,
+ * however many callers it was shared with (see the timestamps of
+ * sensors_read_subfeature()). The variance is computed with Welford's
+ * algorithm, which stays accurate over long runs.
+ *
+ * The accumulators of a chip are stored as one array per field, so that
+ * the chip needs a single allocation, and a query or update only touches
+ * a few cache lines.
+ */
+struct sensors_valstats {
+	pthread_mutex_t mutex;
+	double alpha;		/* EWMA weight of a new value */
+	unsigned long *count;
+	double *min;
+	double *max;
+	double *ewma;
+	double *mean;
+	double *m2;		/* Sum of the squared deviations */
+	uint64_t *at;		/* Read of the last value accounted for */
+};
+
+/* -1 until set by the application, then the environment decides */
+static double valstats_alpha = -1;
+
+int sensors_set_value_stats(double alpha)
+{
+	if (alpha < 0 || alpha > 1)
+		return -SENSORS_ERR_PARSE;
+	valstats_alpha = alpha;
+	return 0;
+}
+
+void sensors_valstats_init_chip(sensors_chip_features *chip_features)
+{
+	struct sensors_valstats *vs;
+	sensors_arena *arena;
+	const char *env;
+	double alpha;
+	int n = chip_features->subfeature_count;
+
+	if (valstats_alpha < 0) {
+		env = getenv("LIBSENSORS_VALUE_STATS");
+		alpha = env ? atof(env) : 0;
+	} else
+		alpha = valstats_alpha;
+
+	chip_features->valstats = NULL;
+	if (alpha <= 0 || alpha > 1 || !n)
+		return;
+
+	arena = sensors_chip_arena(chip_features);
+	vs = sensors_arena_calloc(arena, 1, sizeof(*vs));
+	pthread_mutex_init(&vs->mutex, NULL);
+	vs->alpha = alpha;
+	vs->count = sensors_arena_calloc(arena, n, sizeof(*vs->count));
+	vs->min = sensors_arena_calloc(arena, n, sizeof(*vs->min));
+	vs->max = sensors_arena_calloc(arena, n, sizeof(*vs->max));
+	vs->ewma = sensors_arena_calloc(arena, n, sizeof(*vs->ewma));
+	vs->mean = sensors_arena_calloc(arena, n, sizeof(*vs->mean));
+	vs->m2 = sensors_arena_calloc(arena, n, sizeof(*vs->m2));
+	vs->at = sensors_arena_calloc(arena, n, sizeof(*vs->at));
+	chip_features->valstats = vs;
+}
+
+void sensors_valstats_update(const sensors_chip_features *chip_features,
+			     const sensors_subfeature *subfeature,
+			     double value, uint64_t at)
+{
+	struct sensors_valstats *vs = chip_features->valstats;
+	double delta;
+	int i;
+
+	if (!vs)
+		return;
+	i = subfeature - chip_features->subfeature;
+
+	pthread_mutex_lock(&vs->mutex);
+	if (at <= vs->at[i]) {
+		pthread_mutex_unlock(&vs->mutex);
+		return;
+	}
+	vs->at[i] = at;
+
+	if (!vs->count[i]++) {
+		vs->min[i] = vs->max[i] = value;
+		vs->ewma[i] = vs->mean[i] = value;
+		vs->m2[i] = 0;
+	} else {
+		if (value < vs->min[i])
+			vs->min[i] = value;
+		if (value > vs->max[i])
+			vs->max[i] = value;
+		vs->ewma[i] += vs->alpha * (value - vs->ewma[i]);
+		delta = value - vs->mean[i];
+		vs->mean[i] += delta / vs->count[i];
+		vs->m2[i] += delta * (value - vs->mean[i]);
+	}
+	pthread_mutex_unlock(&vs->mutex);
+}
+
+static int __sensors_get_value_stats(const sensors_chip_name *name,
+				     int subfeat_nr,
+				     sensors_value_stats *stats)
+{
+	const sensors_chip_features *chip_features;
+	struct sensors_valstats *vs;
+	int i = subfeat_nr;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (sensors_chip_name_has_wildcards(name))
+		return -SENSORS_ERR_WILDCARDS;
+	if (!(chip_features = sensors_lookup_chip(name)))
+		return -SENSORS_ERR_NO_ENTRY;
+	if (i < 0 || i >= chip_features->subfeature_count)
+		return -SENSORS_ERR_NO_ENTRY;
+	if (!(vs = chip_features->valstats))
+		return 0;
+
+	pthread_mutex_lock(&vs->mutex);
+	stats->count = vs->count[i];
+	if (stats->count) {
+		stats->min = vs->min[i];
+		stats->max = vs->max[i];
+		stats->ewma = vs->ewma[i];
+		stats->mean = vs->mean[i];
+		if (stats->count > 1)
+			stats->variance = vs->m2[i] / (stats->count - 1);
+	}
+	pthread_mutex_unlock(&vs->mutex);
+	return 0;
+}
+
+int sensors_get_value_stats(const sensors_chip_name *name, int subfeat_nr,
+			    sensors_value_stats *stats)
+{
+	int res;
+
+	sensors_read_begin();
+	res = __sensors_get_value_stats(name, subfeat_nr, stats);
+	sensors_read_end();
+	return res;
+}
@@ -0,0 +1,456 @@
+/*
+    virtual.c - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include "sensors.h"
+#include "data.h"
+#include "error.h"
+#include "general.h"
+#include "access.h"
+#include "sysfs.h"
+#include "virtual.h"
+
+/*
+ * Virtual sensors: the virtual statements of the configuration define
+ * sensors computed from the subfeatures of other chips. They make up a
+ * chip of their own, virtual-virtual-0, with one feature per virtual
+ * sensor, so that labels, ignores and compute statements apply to them
+ * like to any other chip.
+ *
+ * The subfeatures the expressions refer to are resolved against the
+ * detected chips when first needed, and again whenever the detected chips
+ * change. Each computation of the virtual chip is a pass: a subfeature is
+ * read at most once per pass, however many expressions use it, and a
+ * virtual sensor is computed at most once per pass, however many others
+ * refer to it. A snapshot of the virtual chip is a single pass, see
+ * sensors_virtual_begin(). A virtual sensor which ends up referring to
+ * itself fails with SENSORS_ERR_RECURSION.
+ */
+
+/* A subfeature of another chip */
+struct sensors_virtual_dep {
+	const sensors_chip_features *chip_features;
+	const sensors_subfeature *subfeature;
+	unsigned int pass;	/* Pass in which it was last read */
+	int err;
+	double value;
+	uint64_t at;
+};
+
+/* What a variable or an aggregate of an expression refers to */
+struct sensors_virtual_ref {
+	const sensors_expr *expr;
+	int sensor;		/* Virtual sensor, or -1 */
+	int first;		/* First of its subfeatures in dep_list */
+	int count;
+};
+
+struct sensors_virtual_sensor {
+	const sensors_expr *expr;
+	unsigned int pass;	/* Pass in which it was last computed */
+	int busy;		/* Being computed */
+	int err;
+	double value;
+	uint64_t at;
+};
+
+struct sensors_virtual_chip {
+	pthread_mutex_t mutex;
+	struct sensors_virtual_sensor *sensors;	/* One per subfeature */
+	unsigned int pass;
+	unsigned int chips_gen;	/* Generation the references are for */
+	/* The resolved references */
+	struct sensors_virtual_dep *deps;
+	int deps_count;
+	int deps_max;
+	struct sensors_virtual_ref *refs;
+	int refs_count;
+	int refs_max;
+	int *dep_list;		/* Indexes in deps */
+	int dep_list_count;
+	int dep_list_max;
+};
+
+/* The virtual chip of the pass started by sensors_virtual_begin(), if
+   any */
+static __thread struct sensors_virtual_chip *virtual_batch;
+
+int sensors_virtual_name_valid(const char *name)
+{
+	char buf[NAME_MAX];
+	sensors_subfeature_type type;
+	int nr;
+
+	if (snprintf(buf, sizeof(buf), "%s_input", name) >= (int)sizeof(buf))
+		return 0;
+	type = sensors_subfeature_get_type(buf, &nr);
+	return type != SENSORS_SUBFEATURE_UNKNOWN &&
+	       (type >> 8) < SENSORS_FEATURE_VID;
+}
+
+void sensors_virtual_add_chip(void)
+{
+	sensors_chip_features *chip;
+	struct sensors_virtual_chip *vc;
+	const sensors_virtual *v;
+	sensors_subfeature_type type;
+	char buf[NAME_MAX];
+	int i, j, n, nr;
+
+	n = sensors_config_virtuals_count;
+	if (!n)
+		return;
+
+	chip = sensors_arena_calloc(&sensors_proc_arena, 1, sizeof(*chip));
+	chip->chip.prefix = sensors_intern_name("virtual");
+	chip->chip.bus.type = SENSORS_BUS_TYPE_VIRTUAL;
+	chip->chip.bus.nr = 0;
+	chip->chip.addr = 0;
+	chip->chip.path = sensors_arena_strdup(&sensors_proc_arena, "");
+	chip->feature = sensors_arena_calloc(&sensors_proc_arena, n,
+					     sizeof(sensors_feature));
+	chip->subfeature = sensors_arena_calloc(&sensors_proc_arena, n,
+						sizeof(sensors_subfeature));
+
+	vc = sensors_arena_calloc(&sensors_proc_arena, 1, sizeof(*vc));
+	vc->sensors = sensors_arena_calloc(&sensors_proc_arena, n,
+					   sizeof(*vc->sensors));
+	pthread_mutex_init(&vc->mutex, NULL);
+
+	/* One feature per name, the latest statement wins */
+	for (i = 0; i < n; i++) {
+		v = &sensors_config_virtuals[i];
+		for (j = 0; j < chip->feature_count; j++)
+			if (chip->feature[j].name == v->name)
+				break;
+		vc->sensors[j].expr = v->value;
+		if (j < chip->feature_count)
+			continue;
+
+		snprintf(buf, sizeof(buf), "%s_input", v->name);
+		type = sensors_subfeature_get_type(buf, &nr);
+
+		chip->feature[j].name = v->name;
+		chip->feature[j].number = j;
+		chip->feature[j].first_subfeature = j;
+		chip->feature[j].type = type >> 8;
+		chip->subfeature[j].name = sensors_intern_name(buf);
+		chip->subfeature[j].number = j;
+		chip->subfeature[j].type = type;
+		chip->subfeature[j].mapping = j;
+		chip->subfeature[j].flags = SENSORS_MODE_R |
+					    SENSORS_COMPUTE_MAPPING;
+		chip->feature_count++;
+		chip->subfeature_count++;
+	}
+
+	chip->virt = vc;
+	sensors_add_proc_chips(&chip);
+}
+
+void sensors_virtual_free_chip(sensors_chip_features *chip_features)
+{
+	struct sensors_virtual_chip *vc = chip_features->virt;
+
+	if (!vc)
+		return;
+	free(vc->deps);
+	free(vc->refs);
+	free(vc->dep_list);
+	chip_features->virt = NULL;
+}
+
+/* Selector callback: add a subfeature to the latest reference */
+static void sensors_virtual_add_dep(const sensors_chip_features
+				    *chip_features,
+				    const sensors_subfeature *subfeature,
+				    void *data)
+{
+	struct sensors_virtual_chip *vc = data;
+	struct sensors_virtual_ref *ref = vc->refs + vc->refs_count - 1;
+	struct sensors_virtual_dep dep;
+	int i;
+
+	/* Virtual sensors refer to each other by name only, and a variable
+	   refers to a single subfeature */
+	if (chip_features->virt ||
+	    (ref->expr->kind == sensors_kind_var && ref->count))
+		return;
+
+	for (i = 0; i < vc->deps_count; i++)
+		if (vc->deps[i].subfeature == subfeature)
+			break;
+	if (i == vc->deps_count) {
+		memset(&dep, 0, sizeof(dep));
+		dep.chip_features = chip_features;
+		dep.subfeature = subfeature;
+		dep.pass = vc->pass;
+		sensors_add_array_el(&dep, &vc->deps, &vc->deps_count,
+				     &vc->deps_max, sizeof(dep));
+	}
+	sensors_add_array_el(&i, &vc->dep_list, &vc->dep_list_count,
+			     &vc->dep_list_max, sizeof(int));
+	ref->count++;
+}
+
+static void sensors_virtual_resolve_expr(const sensors_chip_features
+					 *chip_features,
+					 const sensors_expr *expr)
+{
+	struct sensors_virtual_chip *vc = chip_features->virt;
+	struct sensors_virtual_ref ref;
+	sensors_selector *selector;
+	const char *spec;
+	int i;
+
+	switch (expr->kind) {
+	case sensors_kind_sub:
+		sensors_virtual_resolve_expr(chip_features,
+					     expr->data.subexpr.sub1);
+		if (expr->data.subexpr.sub2)
+			sensors_virtual_resolve_expr(chip_features,
+						     expr->data.subexpr.sub2);
+		return;
+	case sensors_kind_var:
+		spec = expr->data.var;
+		break;
+	case sensors_kind_aggr:
+		spec = expr->data.aggr.spec;
+		break;
+	default:
+		return;
+	}
+
+	ref.expr = expr;
+	ref.sensor = -1;
+	ref.first = vc->dep_list_count;
+	ref.count = 0;
+
+	/* Names without a chip are those of other virtual sensors */
+	if (expr->kind == sensors_kind_var && !strchr(spec, '/')) {
+		for (i = 0; i < chip_features->subfeature_count; i++)
+			if (chip_features->subfeature[i].name == spec)
+				ref.sensor = i;
+		sensors_add_array_el(&ref, &vc->refs, &vc->refs_count,
+				     &vc->refs_max, sizeof(ref));
+		return;
+	}
+
+	sensors_add_array_el(&ref, &vc->refs, &vc->refs_count, &vc->refs_max,
+			     sizeof(ref));
+	if (!sensors_compile_selector(spec, &selector)) {
+		sensors_walk_selector(selector, sensors_virtual_add_dep, vc);
+		sensors_free_selector(selector);
+	}
+}
+
+static void sensors_virtual_resolve(const sensors_chip_features
+				    *chip_features)
+{
+	struct sensors_virtual_chip *vc = chip_features->virt;
+	int i;
+
+	vc->deps_count = vc->refs_count = vc->dep_list_count = 0;
+	for (i = 0; i < chip_features->subfeature_count; i++)
+		sensors_virtual_resolve_expr(chip_features,
+					     vc->sensors[i].expr);
+	vc->chips_gen = sensors_current_context->chips_gen;
+}
+
+static int sensors_virtual_eval(const sensors_chip_features *chip_features,
+				const sensors_expr *expr, double *result,
+				uint64_t *at);
+
+/* Compute a virtual sensor, once per pass */
+static int sensors_virtual_sensor(const sensors_chip_features
+				  *chip_features, int nr, double *result,
+				  uint64_t *at)
+{
+	struct sensors_virtual_sensor *sensor =
+		chip_features->virt->sensors + nr;
+
+	if (sensor->pass == chip_features->virt->pass) {
+		if (sensor->busy)
+			return -SENSORS_ERR_RECURSION;
+	} else {
+		sensor->pass = chip_features->virt->pass;
+		sensor->busy = 1;
+		sensor->value = 0;
+		sensor->at = 0;
+		sensor->err = sensors_virtual_eval(chip_features, sensor->expr,
+						   &sensor->value,
+						   &sensor->at);
+		sensor->busy = 0;
+	}
+
+	*result = sensor->value;
+	if (sensor->at > *at)
+		*at = sensor->at;
+	return sensor->err;
+}
+
+/* Read a subfeature of another chip, once per pass */
+static int sensors_virtual_dep(struct sensors_virtual_chip *vc,
+			       struct sensors_virtual_dep *dep)
+{
+	if (dep->pass != vc->pass) {
+		dep->pass = vc->pass;
+		dep->at = 0;
+		dep->err = sensors_get_chip_value(dep->chip_features,
+						  dep->subfeature, 0,
+						  &dep->value, &dep->at);
+	}
+	return dep->err;
+}
+
+/* A variable is the value of its subfeature. An aggregate is computed
+   from the subfeatures which could be read, and fails only if none
+   could. */
+static int sensors_virtual_ref(const sensors_chip_features *chip_features,
+			       const struct sensors_virtual_ref *ref,
+			       double *result, uint64_t *at)
+{
+	struct sensors_virtual_chip *vc = chip_features->virt;
+	struct sensors_virtual_dep *dep;
+	sensors_aggregate op;
+	double acc = 0;
+	int i, res, n = 0, err = -SENSORS_ERR_NO_ENTRY;
+
+	if (ref->sensor >= 0)
+		return sensors_virtual_sensor(chip_features, ref->sensor,
+					      result, at);
+
+	op = ref->expr->kind == sensors_kind_aggr ? ref->expr->data.aggr.op :
+						    sensors_sum;
+	for (i = 0; i < ref->count; i++) {
+		dep = vc->deps + vc->dep_list[ref->first + i];
+		if ((res = sensors_virtual_dep(vc, dep))) {
+			err = res;
+			continue;
+		}
+
+		switch (op) {
+		case sensors_max:
+			if (!n || dep->value > acc)
+				acc = dep->value;
+			break;
+		case sensors_min:
+			if (!n || dep->value < acc)
+				acc = dep->value;
+			break;
+		default:
+			acc += dep->value;
+		}
+		n++;
+		if (dep->at > *at)
+			*at = dep->at;
+	}
+
+	if (!n)
+		return err;
+	*result = op == sensors_avg ? acc / n : acc;
+	return 0;
+}
+
+static int sensors_virtual_eval(const sensors_chip_features *chip_features,
+				const sensors_expr *expr, double *result,
+				uint64_t *at)
+{
+	struct sensors_virtual_chip *vc = chip_features->virt;
+	double res1, res2 = 0;
+	int i, res;
+
+	switch (expr->kind) {
+	case sensors_kind_val:
+		*result = expr->data.val;
+		return 0;
+	case sensors_kind_var:
+	case sensors_kind_aggr:
+		for (i = 0; i < vc->refs_count; i++)
+			if (vc->refs[i].expr == expr)
+				return sensors_virtual_ref(chip_features,
+							   vc->refs + i,
+							   result, at);
+		return -SENSORS_ERR_NO_ENTRY;
+	case sensors_kind_sub:
+		if ((res = sensors_virtual_eval(chip_features,
+						expr->data.subexpr.sub1,
+						&res1, at)))
+			return res;
+		if (expr->data.subexpr.sub2 &&
+		    (res = sensors_virtual_eval(chip_features,
+						expr->data.subexpr.sub2,
+						&res2, at)))
+			return res;
+		return sensors_eval_op(expr->data.subexpr.op, res1, res2,
+				       result);
+	default:
+		return -SENSORS_ERR_NO_ENTRY;
+	}
+}
+
+/* Start a pass, with the lock of the chip held */
+static void sensors_virtual_start(const sensors_chip_features *chip_features)
+{
+	struct sensors_virtual_chip *vc = chip_features->virt;
+
+	pthread_mutex_lock(&vc->mutex);
+	if (vc->chips_gen != sensors_current_context->chips_gen)
+		sensors_virtual_resolve(chip_features);
+	vc->pass++;
+}
+
+int sensors_virtual_read(const sensors_chip_features *chip_features,
+			 const sensors_subfeature *subfeature,
+			 double *value, uint64_t *when)
+{
+	struct sensors_virtual_chip *vc = chip_features->virt;
+	int err;
+
+	*when = 0;
+	if (virtual_batch != vc)
+		sensors_virtual_start(chip_features);
+	err = sensors_virtual_sensor(chip_features,
+				     subfeature - chip_features->subfeature,
+				     value, when);
+	if (virtual_batch != vc)
+		pthread_mutex_unlock(&vc->mutex);
+	return err;
+}
+
+void sensors_virtual_begin(const sensors_chip_features *chip_features)
+{
+	if (!chip_features->virt || virtual_batch)
+		return;
+	sensors_virtual_start(chip_features);
+	virtual_batch = chip_features->virt;
+}
+
+void sensors_virtual_end(const sensors_chip_features *chip_features)
+{
+	if (!chip_features->virt || virtual_batch != chip_features->virt)
+		return;
+	virtual_batch = NULL;
+	pthread_mutex_unlock(&chip_features->virt->mutex);
+}
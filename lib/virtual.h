@@ -0,0 +1,50 @@
+/*
+    virtual.h - Part of libsensors, a Linux library for reading sensor data.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#ifndef LIB_SENSORS_VIRTUAL_H
+#define LIB_SENSORS_VIRTUAL_H
+
+#include <stdint.h>
+#include "data.h"
+
+/* Check whether a virtual sensor name is that of an input feature, such
+   as temp1. Returns 1 if it is, 0 if not. */
+int sensors_virtual_name_valid(const char *name);
+
+/* Add the virtual chip made of the virtual statements of the
+   configuration, if any, to the detected chips. It must then be set up
+   like the other chips. */
+void sensors_virtual_add_chip(void);
+
+/* Release the memory of the virtual chip which isn't in its arena. Does
+   nothing for the other chips. */
+void sensors_virtual_free_chip(sensors_chip_features *chip_features);
+
+/* Compute a virtual sensor. Sets when like sensors_read_subfeature(), to
+   the time of the latest read it depends on. */
+int sensors_virtual_read(const sensors_chip_features *chip_features,
+			 const sensors_subfeature *subfeature,
+			 double *value, uint64_t *when);
+
+/* Compute the virtual sensors read between these calls from the same
+   reads of the other chips. Do nothing for the other chips. */
+void sensors_virtual_begin(const sensors_chip_features *chip_features);
+void sensors_virtual_end(const sensors_chip_features *chip_features);
+
+#endif /* def LIB_SENSORS_VIRTUAL_H */
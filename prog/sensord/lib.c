@@ -42,10 +42,9 @@ static int loadConfig(const char *cfgPath, int reload)
  	if (!cfgPath) {
  		if (reload) {
 			sensorLog(LOG_INFO, "configuration reloading");
-			sensors_cleanup();
-		}
-
- 		ret = sensors_init(NULL);
+			ret = sensors_reload(NULL);
+		} else
+			ret = sensors_init(NULL);
  		if (ret) {
  			sensorLog(LOG_ERR, "Error loading default"
  				  " configuration file: %s",
@@ -64,9 +63,9 @@ static int loadConfig(const char *cfgPath, int reload)
 
 	if (reload) {
 		sensorLog(LOG_INFO, "configuration reloading");
-		sensors_cleanup();
-	}
- 	ret = sensors_init(fp);
+		ret = sensors_reload(fp);
+	} else
+		ret = sensors_init(fp);
  	if (ret) {
  		sensorLog(LOG_ERR, "Error loading sensors configuration file"
 			  " %s: %s", cfgPath, sensors_strerror(ret));
@@ -78,22 +77,32 @@ static int loadConfig(const char *cfgPath, int reload)
  	return 0;
 }
 
+/* Longest delay before failing subfeatures are read again, in ms */
+#define READ_BACKOFF_MS	60000
+
 int loadLib(const char *cfgPath)
 {
 	int ret;
+
+	/* Don't read (and log) failing subfeatures on every cycle */
+	sensors_set_read_backoff(READ_BACKOFF_MS);
+
 	ret = loadConfig(cfgPath, 0);
 	if (!ret)
 		ret = initKnownChips();
 	return ret;
 }
 
+/* The old configuration stays in use until the new one is fully loaded,
+   and is kept if loading fails */
 int reloadLib(const char *cfgPath)
 {
 	int ret;
-	freeKnownChips();
 	ret = loadConfig(cfgPath, 1);
-	if (!ret)
+	if (!ret) {
+		freeKnownChips();
 		ret = initKnownChips();
+	}
 	return ret;
 }
 
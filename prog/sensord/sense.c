@@ -64,6 +64,23 @@ static int idChip(const sensors_chip_name *chip)
 	return 0;
 }
 
+/* The library doesn't read subfeatures which keep failing for a while,
+   only report the first failure */
+static void logReadError(const sensors_chip_name *chip, int num, int ret)
+{
+	sensors_read_state state;
+
+	/* Not an error, the device is sleeping on purpose */
+	if (ret == -SENSORS_ERR_SUSPENDED)
+		return;
+	if (!sensors_get_read_state(chip, num, &state) &&
+	    (state.failures > 1 || state.suppressed))
+		return;
+
+	sensorLog(LOG_ERR, "Error getting sensor data: %s/#%d: %s",
+		  chip->prefix, num, sensors_strerror(ret));
+}
+
 static int get_flag(const sensors_chip_name *chip, int num)
 {
 	double val;
@@ -74,8 +91,7 @@ static int get_flag(const sensors_chip_name *chip, int num)
 
 	ret = sensors_get_value(chip, num, &val);
 	if (ret) {
-		sensorLog(LOG_ERR, "Error getting sensor data: %s/#%d: %s",
-			  chip->prefix, num, sensors_strerror(ret));
+		logReadError(chip, num, ret);
 		return -1;
 	}
 
@@ -101,10 +117,7 @@ static int do_features(const sensors_chip_name *chip,
 		ret = sensors_get_value(chip, feature->dataNumbers[i],
 					val + i);
 		if (ret) {
-			sensorLog(LOG_ERR,
-				  "Error getting sensor data: %s/#%d: %s",
-				  chip->prefix, feature->dataNumbers[i],
-				  sensors_strerror(ret));
+			logReadError(chip, feature->dataNumbers[i], ret);
 			return -1;
 		}
 	}
@@ -246,12 +259,26 @@ int readChips(void)
 	return ret;
 }
 
+/* Check the chips we monitor for alarms, stopping at the first one */
+static int alarmingChips(void)
+{
+	int j;
+
+	for (j = 0; j < sensord_args.numChipNames; j++)
+		if (sensors_get_alarm_summary(&sensord_args.chipNames[j],
+					      NULL, 0))
+			return 1;
+	return 0;
+}
+
 int scanChips(void)
 {
 	int ret = 0;
 
 	sensorLog(LOG_DEBUG, "sensor sweep started");
-	ret = doChips(DO_SCAN);
+	/* Only go through the features if something is alarming */
+	if (alarmingChips())
+		ret = doChips(DO_SCAN);
 	sensorLog(LOG_DEBUG, "sensor sweep finished");
 
 	return ret;
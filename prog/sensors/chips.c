@@ -34,14 +34,16 @@
 
 void print_chip_raw(const sensors_chip_name *name)
 {
-	int a, b, err;
+	int a, b, err, features_count, subs_count;
+	const sensors_feature * const *features;
 	const sensors_feature *feature;
-	const sensors_subfeature *sub;
+	const sensors_subfeature *subs, *sub;
 	char *label;
 	double val;
 
-	a = 0;
-	while ((feature = sensors_get_features(name, &a))) {
+	features = sensors_get_feature_array(name, &features_count);
+	for (a = 0; a < features_count; a++) {
+		feature = features[a];
 		if (!(label = sensors_get_label(name, feature))) {
 			fprintf(stderr, "ERROR: Can't get label of feature "
 				"%s!\n", feature->name);
@@ -50,8 +52,9 @@ void print_chip_raw(const sensors_chip_name *name)
 		printf("%s:\n", label);
 		free(label);
 
-		b = 0;
-		while ((sub = sensors_get_all_subfeatures(name, feature, &b))) {
+		subs = sensors_get_subfeature_array(name, feature, &subs_count);
+		for (b = 0; b < subs_count; b++) {
+			sub = subs + b;
 			if (sub->flags & SENSORS_MODE_R) {
 				if ((err = sensors_get_value(name, sub->number,
 							     &val)))
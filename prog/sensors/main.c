@@ -60,6 +60,7 @@ static void print_long_help(void)
 	     "  -f, --fahrenheit      Show temperatures in degrees fahrenheit\n"
 	     "  -A, --no-adapter      Do not show adapter for each chip\n"
 	     "      --bus-list        Generate bus statements for sensors.conf\n"
+	     "      --config-dump     Show which config chip blocks apply\n"
 	     "  -u                    Raw output\n"
 	     "  -v, --version         Display the program version\n"
 	     "\n"
@@ -158,6 +159,8 @@ static const char *sprintf_chip_name(const sensors_chip_name *name)
 
 static void do_a_print(const sensors_chip_name *name)
 {
+	sensors_read_state state;
+
 	printf("%s\n", sprintf_chip_name(name));
 	if (!hide_adapter) {
 		const char *adap = sensors_get_adapter_name(&name->bus);
@@ -166,7 +169,11 @@ static void do_a_print(const sensors_chip_name *name)
 		else
 			fprintf(stderr, "Can't get adapter name\n");
 	}
-	if (do_raw)
+	/* Don't wake up devices configured not to be woken up */
+	if (!sensors_get_read_state(name, 0, &state) &&
+	    state.state == SENSORS_READ_SUSPENDED)
+		printf("Device suspended\n");
+	else if (do_raw)
 		print_chip_raw(name);
 	else
 		print_chip(name);
@@ -244,7 +251,7 @@ static void print_bus_list(void)
 
 int main(int argc, char *argv[])
 {
-	int c, i, err, do_bus_list;
+	int c, i, err, do_bus_list, do_config_dump;
 	const char *config_file_name = NULL;
 
 	struct option long_opts[] =  {
@@ -255,6 +262,7 @@ int main(int argc, char *argv[])
 		{ "no-adapter", no_argument, NULL, 'A' },
 		{ "config-file", required_argument, NULL, 'c' },
 		{ "bus-list", no_argument, NULL, 'B' },
+		{ "config-dump", no_argument, NULL, 'D' },
 		{ 0, 0, 0, 0 }
 	};
 
@@ -263,6 +271,7 @@ int main(int argc, char *argv[])
 	do_raw = 0;
 	do_sets = 0;
 	do_bus_list = 0;
+	do_config_dump = 0;
 	hide_adapter = 0;
 	while (1) {
 		c = getopt_long(argc, argv, "hsvfAc:u", long_opts, NULL);
@@ -297,6 +306,9 @@ int main(int argc, char *argv[])
 		case 'B':
 			do_bus_list = 1;
 			break;
+		case 'D':
+			do_config_dump = 1;
+			break;
 		default:
 			fprintf(stderr,
 				"Internal error while parsing options!\n");
@@ -313,6 +325,8 @@ int main(int argc, char *argv[])
 
 	if (do_bus_list) {
 		print_bus_list();
+	} else if (do_config_dump && optind == argc) {
+		sensors_dump_config(stdout, NULL);
 	} else if (optind == argc) { /* No chip name on command line */
 		if (!do_the_real_work(NULL, &err)) {
 			fprintf(stderr,
@@ -334,7 +348,11 @@ int main(int argc, char *argv[])
 				err = 1;
 				goto exit;
 			}
-			cnt += do_the_real_work(&chip, &err);
+			if (do_config_dump) {
+				sensors_dump_config(stdout, &chip);
+				cnt++;
+			} else
+				cnt += do_the_real_work(&chip, &err);
 			sensors_free_chip_name(&chip);
 		}
 